@@ -0,0 +1,190 @@
+// FbxBench: text FBX load benchmark of openFBX (tokenizer, number parsing and the array jobs).
+//
+//  FbxBench generate <grid side> <output fbx>
+//  FbxBench <fbx> [thread count] [runs]
+//
+// generate writes an ASCII FBX holding one side x side vertex grid: jittered positions, by-vertex normals and quads,
+// the way DCC text exports lay them out. A side of 1449 gives the 268MB, 2.1M vertex and 8.4M index file.
+// The benchmark maps the file once, then times ofbx::load on the job system and prints the median of the runs.
+
+// stl
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Common.h"
+#include "FileHelper.h"
+#include "JobSystem.h"
+#include "ofbx.h"
+
+namespace
+{
+    // ofbx::JobProcessor adapter, _user is the JobSystem (FBXHelper uses the same one)
+    void ofbxJobProcessor(ofbx::JobFunction _fn, void* _user, void* _data, u32 _size, u32 _count)
+    {
+        JobSystem* jobSystem = (JobSystem*)_user;
+        ofbx::u8* data = (ofbx::u8*)_data;
+        jobSystem->parallelFor(_count, [&](u32 _index) {
+            _fn(data + (size_t)_index * _size);
+        });
+    }
+
+    // Comma separated values of one array property, written as they are built: the big arrays never sit in memory whole
+    struct ArrayWriter
+    {
+        std::ofstream& m_file;
+        bool m_first = true;
+        char m_number[32] = {};
+
+        void begin(const char* _indent, const char* _name, u64 _count)
+        {
+            m_file << _indent << _name << ": *" << _count << " {\n" << _indent << "\ta: ";
+            m_first = true;
+        }
+        void value(const char* _format, double _value)
+        {
+            int length = snprintf(m_number, sizeof(m_number), _format, _value);
+            append(length);
+        }
+        void value(i64 _value)
+        {
+            int length = snprintf(m_number, sizeof(m_number), "%lld", (long long)_value);
+            append(length);
+        }
+        void end(const char* _indent)
+        {
+            m_file << "\n" << _indent << "} \n";
+        }
+
+    private:
+        void append(int _length)
+        {
+            if (!m_first)
+                m_file.put(',');
+            m_file.write(m_number, _length);
+            m_first = false;
+        }
+    };
+
+    bool generateGrid(u32 _side, const std::string& _path)
+    {
+        std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        // fixed seed, every run writes the same file
+        std::mt19937 random(1);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::uniform_real_distribution<double> signedUnit(-1.0, 1.0);
+        u64 vertexCount = (u64)_side * _side;
+        u64 quadCount = (u64)(_side - 1) * (_side - 1);
+
+        file << "; FBX 7.4.0 project file\nFBXHeaderExtension:  {\n\tFBXHeaderVersion: 1003\n\tFBXVersion: 7400\n}\nObjects:  {\n";
+        file << "\tGeometry: 1000, \"Geometry::Grid\", \"Mesh\" {\n";
+
+        ArrayWriter array{ file };
+        array.begin("\t\t", "Vertices", vertexCount * 3);
+        for (u32 y = 0; y < _side; ++y)
+        {
+            for (u32 x = 0; x < _side; ++x)
+            {
+                array.value("%.13g", x + unit(random) * 0.5);
+                array.value("%.13g", signedUnit(random) * 14.27603530883);
+                array.value("%.13g", y * 1.000173);
+            }
+        }
+        array.end("\t\t");
+
+        // quads, the last index of a polygon is stored as -index - 1
+        array.begin("\t\t", "PolygonVertexIndex", quadCount * 4);
+        for (u32 y = 0; y + 1 < _side; ++y)
+        {
+            for (u32 x = 0; x + 1 < _side; ++x)
+            {
+                i64 corner = (i64)y * _side + x;
+                array.value(corner);
+                array.value(corner + 1);
+                array.value(corner + _side + 1);
+                array.value(-(corner + _side) - 1);
+            }
+        }
+        array.end("\t\t");
+        file << "\t\tGeometryVersion: 124\n";
+
+        file << "\t\tLayerElementNormal: 0 {\n\t\t\tVersion: 102\n\t\t\tName: \"\"\n\t\t\tMappingInformationType: \"ByVertice\"\n\t\t\tReferenceInformationType: \"Direct\"\n";
+        array.begin("\t\t\t", "Normals", vertexCount * 3);
+        for (u64 v = 0; v < vertexCount * 3; ++v)
+            array.value("%.15g", signedUnit(random));
+        array.end("\t\t\t");
+        file << "\t\t}\n";
+        file << "\t\tLayer: 0 {\n\t\t\tVersion: 100\n\t\t\tLayerElement:  {\n\t\t\t\tType: \"LayerElementNormal\"\n\t\t\t\tTypedIndex: 0\n\t\t\t}\n\t\t}\n\t}\n";
+        file << "\tModel: 2000, \"Model::Grid\", \"Mesh\" {\n\t\tVersion: 232\n\t}\n}\n";
+        file << "Connections:  {\n\tC: \"OO\",2000,0\n\tC: \"OO\",1000,2000\n}\n";
+        return file.good();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "generate") == 0)
+    {
+        u32 side = (u32)std::atoi(argv[2]);
+        if (side < 2 || !generateGrid(side, argv[3]))
+        {
+            std::cout << "Failed to write " << argv[3] << "\n";
+            return EXIT_FAILURE;
+        }
+        std::cout << "Wrote " << argv[3] << ": " << (u64)side * side << " vertices, " << (u64)(side - 1) * (side - 1) * 4 << " indices\n";
+        return EXIT_SUCCESS;
+    }
+    if (argc < 2)
+    {
+        std::cout << "usage: FbxBench generate <grid side> <output fbx>\n       FbxBench <fbx> [thread count] [runs]\n";
+        return EXIT_FAILURE;
+    }
+
+    JobSystem jobSystem;
+    jobSystem.init(argc > 2 ? (u32)std::atoi(argv[2]) : 0);
+    u32 runs = argc > 3 ? std::max(std::atoi(argv[3]), 1) : 7;
+
+    // mapped once, every run parses the same pages
+    MappedFile file = FileHelper::mapFile(argv[1]);
+    std::cout << argv[1] << ": " << file.size() / (1024.0f * 1024.0f) << "MB, " << jobSystem.getThreadCount() << " threads\n";
+
+    std::vector<float> times;
+    for (u32 run = 0; run < runs; ++run)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        ofbx::IScene* scene = ofbx::load((const ofbx::u8*)file.data(), (ofbx::usize)file.size(), (ofbx::u16)(ofbx::LoadFlags::BORROW_DATA | ofbx::LoadFlags::IGNORE_ANIMATIONS), &ofbxJobProcessor, &jobSystem);
+        times.push_back(std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count());
+        if (!scene)
+        {
+            std::cout << "ofbx::load failed: " << ofbx::getError() << "\n";
+            return EXIT_FAILURE;
+        }
+        if (run == 0)
+        {
+            u64 positions = 0;
+            u64 indices = 0;
+            for (int m = 0; m < scene->getMeshCount(); ++m)
+            {
+                const ofbx::GeometryData& geometry = scene->getMesh(m)->getGeometryData();
+                positions += (u64)geometry.getPositions().values_count;
+                indices += (u64)geometry.getPositions().count;
+            }
+            std::cout << "\t " << scene->getMeshCount() << " meshes, " << positions << " positions, " << indices << " indices\n";
+        }
+        scene->destroy();
+    }
+
+    std::sort(times.begin(), times.end());
+    std::cout << "ofbx::load median " << times[times.size() / 2] << "ms, min " << times[0] << "ms, max " << times.back() << "ms over " << runs << " runs\n";
+    return EXIT_SUCCESS;
+}
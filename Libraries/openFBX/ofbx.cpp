@@ -1,6 +1,8 @@
 #include "ofbx.h"
 #include "libdeflate.h"
+#include <algorithm>
 #include <cassert>
+#include <charconv>
 #include <math.h>
 #include <ctype.h>
 #include <memory>
@@ -11,12 +13,18 @@
 #include <mutex>
 #include <inttypes.h>
 #include <string.h>
+#include <type_traits>
 
 #if __cplusplus >= 202002L && defined(__cpp_lib_bit_cast)
 #include <bit> // for std::bit_cast (C++20 and later)
 #endif
 #include <map>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OFBX_SSE2
+#endif
+
 namespace ofbx
 {
 
@@ -26,6 +34,55 @@ template<typename T> static T read_value(const u8* value_ptr) {
 	return value;
 }
 
+// ASCII only, the locale aware isspace is a call per character
+static bool isTextSpace(u8 c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Occurrences of c in [begin, end), 16 bytes per step with SSE2
+static size_t countChar(const u8* begin, const u8* end, u8 c)
+{
+	size_t count = 0;
+	const u8* iter = begin;
+#ifdef OFBX_SSE2
+	const __m128i needle = _mm_set1_epi8((char)c);
+	for (; end - iter >= 16; iter += 16)
+	{
+		u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)iter), needle));
+		for (; mask; mask &= mask - 1) ++count;
+	}
+#endif
+	for (; iter < end; ++iter) count += *iter == c;
+	return count;
+}
+
+// std::from_chars of the text number at str, after whitespaces and a '+' it doesn't accept.
+// No locale and no strlen like atof, and it stops at end instead of relying on a terminator. Unparsable values are 0.
+template <typename T> static const char* parseNumber(const char* str, const char* end, T* val)
+{
+	while (str < end && (isTextSpace(*str) || *str == '+')) ++str;
+	if constexpr (std::is_same_v<T, u64>) {
+		// negative IDs wrap around like with strtoull
+		if (str < end && *str == '-') {
+			i64 signed_val;
+			const char* iter = parseNumber(str, end, &signed_val);
+			*val = (u64)signed_val;
+			return iter;
+		}
+	}
+	std::from_chars_result res = std::from_chars(str, end, *val);
+	if (res.ec != std::errc()) *val = 0;
+	return res.ptr;
+}
+
+template <typename T> static T parseNumber(const u8* begin, const u8* end)
+{
+	T val;
+	parseNumber((const char*)begin, (const char*)end, &val);
+	return val;
+}
+
 static int decodeIndex(int idx)
 {
 	return (idx < 0) ? (-idx - 1) : idx;
@@ -336,8 +393,7 @@ u64 DataView::toU64() const
 		memcpy(&result, begin, sizeof(u64));
 		return result;
 	}
-	static_assert(sizeof(unsigned long long) >= sizeof(u64), "can't use strtoull");
-	return strtoull((const char*)begin, nullptr, 10);
+	return parseNumber<u64>(begin, end);
 }
 
 
@@ -350,8 +406,7 @@ i64 DataView::toI64() const
 		memcpy(&result, begin, sizeof(i64));
 		return result;
 	}
-	static_assert(sizeof(long long) >= sizeof(i64), "can't use atoll");
-	return atoll((const char*)begin);
+	return parseNumber<i64>(begin, end);
 }
 
 
@@ -364,7 +419,7 @@ int DataView::toInt() const
 		memcpy(&result, begin, sizeof(int));
 		return result;
 	}
-	return atoi((const char*)begin);
+	return parseNumber<int>(begin, end);
 }
 
 
@@ -377,7 +432,7 @@ u32 DataView::toU32() const
 		memcpy(&result, begin, sizeof(u32));
 		return result;
 	}
-	return (u32)atoll((const char*)begin);
+	return (u32)parseNumber<i64>(begin, end);
 }
 
 bool DataView::toBool() const
@@ -395,7 +450,7 @@ double DataView::toDouble() const
 		memcpy(&result, begin, sizeof(double));
 		return result;
 	}
-	return atof((const char*)begin);
+	return parseNumber<double>(begin, end);
 }
 
 
@@ -408,7 +463,7 @@ float DataView::toFloat() const
 		memcpy(&result, begin, sizeof(float));
 		return result;
 	}
-	return (float)atof((const char*)begin);
+	return parseNumber<float>(begin, end);
 }
 
 
@@ -436,20 +491,18 @@ template <typename T> static bool parseVertexData(const Element& element, const
 static bool parseDouble(Property& property, double* out);
 
 struct ParseDataJob {
-	using F = bool (*)(Property*, void*);
+	using F = bool (*)(ParseDataJob*);
 	Property* property = nullptr;
 	void* data = nullptr;
+	// parsed range, a part of a large text array is parsed by its own job starting at value first_value
+	const u8* begin = nullptr;
+	const u8* end = nullptr;
+	size_t first_value = 0;
 	bool error = false;
 	F f;
 };
 
-template <typename T> [[nodiscard]] bool pushJob(std::vector<ParseDataJob>& jobs, Property& prop, std::vector<T>& data) {
-	ParseDataJob& job = emplace_back(jobs);
-	job.property = &prop;
-	job.data = (void*)&data;
-	job.f = [](Property* prop, void* data){ return parseVecData(*prop, (std::vector<T>*)data); };
-	return true;
-}
+template <typename T> [[nodiscard]] bool pushJob(std::vector<ParseDataJob>& jobs, Property& prop, std::vector<T>& data);
 
 struct Property : IElementProperty
 {
@@ -579,13 +632,19 @@ static bool isLong(const Property* prop)
 	return prop->getType() == Property::LONG;
 }
 
+// One decompressor per thread, reused by every array the thread inflates instead of one alloc/free per array
+struct ThreadDecompressor
+{
+	libdeflate_decompressor* dec = libdeflate_alloc_decompressor();
+	~ThreadDecompressor() { libdeflate_free_decompressor(dec); }
+};
+
 static bool decompress(const u8* in, size_t in_size, u8* out, size_t out_size)
 {
-	auto dec = libdeflate_alloc_decompressor();
+	thread_local ThreadDecompressor decompressor;
+	if (!decompressor.dec || in_size < 2) return false;
 	size_t dummy;
-	bool res = libdeflate_deflate_decompress(dec, in + 2, in_size - 2, out, out_size, &dummy) == LIBDEFLATE_SUCCESS;
-	libdeflate_free_decompressor(dec);
-	return res;
+	return libdeflate_deflate_decompress(decompressor.dec, in + 2, in_size - 2, out, out_size, &dummy) == LIBDEFLATE_SUCCESS;
 }
 
 
@@ -788,7 +847,7 @@ static bool isEndLine(const Cursor& cursor)
 
 static void skipInsignificantWhitespaces(Cursor* cursor)
 {
-	while (cursor->current < cursor->end && isspace(*cursor->current) && !isEndLine(*cursor))
+	while (cursor->current < cursor->end && isTextSpace(*cursor->current) && !isEndLine(*cursor))
 	{
 		++cursor->current;
 	}
@@ -808,7 +867,7 @@ static void skipLine(Cursor* cursor)
 
 static void skipWhitespaces(Cursor* cursor)
 {
-	while (cursor->current < cursor->end && isspace(*cursor->current))
+	while (cursor->current < cursor->end && isTextSpace(*cursor->current))
 	{
 		++cursor->current;
 	}
@@ -818,7 +877,7 @@ static void skipWhitespaces(Cursor* cursor)
 
 static bool isTextTokenChar(char c)
 {
-	return isalnum(c) || c == '_' || c == '-';
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
 }
 
 
@@ -845,10 +904,8 @@ static OptionalError<Property*> readTextProperty(Cursor* cursor, Allocator& allo
 		prop->type = 'S';
 		++cursor->current;
 		prop->value.begin = cursor->current;
-		while (cursor->current < cursor->end && *cursor->current != '"')
-		{
-			++cursor->current;
-		}
+		const u8* quote = (const u8*)memchr(cursor->current, '"', cursor->end - cursor->current);
+		cursor->current = quote ? quote : cursor->end;
 		prop->value.end = cursor->current;
 		if (cursor->current < cursor->end) ++cursor->current; // skip '"'
 		return prop;
@@ -925,22 +982,16 @@ static OptionalError<Property*> readTextProperty(Cursor* cursor, Allocator& allo
 		if (cursor->current < cursor->end) ++cursor->current; // skip ':'
 		skipInsignificantWhitespaces(cursor);
 		prop->value.begin = cursor->current;
-		prop->count = 0;
-		bool is_any = false;
-		while (cursor->current < cursor->end && *cursor->current != '}')
-		{
-			if (*cursor->current == ',')
-			{
-				if (is_any) ++prop->count;
-				is_any = false;
-			}
-			else if (!isspace(*cursor->current) && !isEndLine(*cursor))
-				is_any = true;
-			if (*cursor->current == '.') prop->type = 'd';
-			++cursor->current;
-		}
-		if (is_any) ++prop->count;
+		const u8* close = (const u8*)memchr(cursor->current, '}', cursor->end - cursor->current);
+		cursor->current = close ? close : cursor->end;
 		prop->value.end = cursor->current;
+
+		// one value per comma, plus the last one unless the list ends with a comma or is empty
+		const u8* last = prop->value.end;
+		while (last > prop->value.begin && isTextSpace(last[-1])) --last;
+		prop->count = 0;
+		if (last > prop->value.begin) prop->count = int(countChar(prop->value.begin, last, ',')) + (last[-1] != ',' ? 1 : 0);
+		if (memchr(prop->value.begin, '.', prop->value.end - prop->value.begin)) prop->type = 'd';
 		if (cursor->current < cursor->end) ++cursor->current; // skip '}'
 		return prop;
 	}
@@ -2698,8 +2749,7 @@ static OptionalError<Object*> parseMaterial(const Scene& scene, const Element& e
 template <typename T> const char* fromString(const char* str, const char* end, T* val);
 template <> const char* fromString<int>(const char* str, const char* end, int* val)
 {
-	*val = atoi(str);
-	const char* iter = str;
+	const char* iter = parseNumber(str, end, val);
 	while (iter < end && *iter != ',') ++iter;
 	if (iter < end) ++iter; // skip ','
 	return (const char*)iter;
@@ -2708,8 +2758,7 @@ template <> const char* fromString<int>(const char* str, const char* end, int* v
 
 template <> const char* fromString<u64>(const char* str, const char* end, u64* val)
 {
-	*val = strtoull(str, nullptr, 10);
-	const char* iter = str;
+	const char* iter = parseNumber(str, end, val);
 	while (iter < end && *iter != ',') ++iter;
 	if (iter < end) ++iter; // skip ','
 	return (const char*)iter;
@@ -2718,8 +2767,7 @@ template <> const char* fromString<u64>(const char* str, const char* end, u64* v
 
 template <> const char* fromString<i64>(const char* str, const char* end, i64* val)
 {
-	*val = atoll(str);
-	const char* iter = str;
+	const char* iter = parseNumber(str, end, val);
 	while (iter < end && *iter != ',') ++iter;
 	if (iter < end) ++iter; // skip ','
 	return (const char*)iter;
@@ -2728,8 +2776,7 @@ template <> const char* fromString<i64>(const char* str, const char* end, i64* v
 
 template <> const char* fromString<double>(const char* str, const char* end, double* val)
 {
-	*val = atof(str);
-	const char* iter = str;
+	const char* iter = parseNumber(str, end, val);
 	while (iter < end && *iter != ',') ++iter;
 	if (iter < end) ++iter; // skip ','
 	return (const char*)iter;
@@ -2738,8 +2785,7 @@ template <> const char* fromString<double>(const char* str, const char* end, dou
 
 template <> const char* fromString<float>(const char* str, const char* end, float* val)
 {
-	*val = (float)atof(str);
-	const char* iter = str;
+	const char* iter = parseNumber(str, end, val);
 	while (iter < end && *iter != ',') ++iter;
 	if (iter < end) ++iter; // skip ','
 	return (const char*)iter;
@@ -2751,7 +2797,7 @@ const char* fromString(const char* str, const char* end, double* val, int count)
 	const char* iter = str;
 	for (int i = 0; i < count; ++i)
 	{
-		*val = atof(iter);
+		iter = parseNumber(iter, end, val);
 		++val;
 		while (iter < end && *iter != ',') ++iter;
 		if (iter < end) ++iter; // skip ','
@@ -2766,7 +2812,7 @@ const char* fromString(const char* str, const char* end, float* val, int count)
 	const char* iter = str;
 	for (int i = 0; i < count; ++i)
 	{
-		*val = (float)atof(iter);
+		iter = parseNumber(iter, end, val);
 		++val;
 		while (iter < end && *iter != ',') ++iter;
 		if (iter < end) ++iter; // skip ','
@@ -2930,6 +2976,7 @@ static bool parseMemory(const Property& property, T* out, int max_size_bytes) {
 template <typename T> static void parseTextArray(const Property& property, std::vector<T>* out)
 {
 	out->clear();
+	if (property.type == 'd' || property.type == 'l') out->reserve(property.count / (sizeof(T) / sizeof(typename TElemType<T>::Type)));
 	const u8* iter = property.value.begin;
 	while (iter < property.value.end)
 	{
@@ -3039,6 +3086,60 @@ template <typename T> static bool parseVecData(Property& property, std::vector<T
 	return false;
 }
 
+// Text arrays larger than this are split at commas and parsed by one job per part
+static constexpr size_t TEXT_ARRAY_CHUNK_SIZE = 1 << 20;
+
+template <typename T> static bool parseTextArrayChunk(ParseDataJob* job) {
+	using ElemType = typename TElemType<T>::Type;
+	std::vector<T>& out = *(std::vector<T>*)job->data;
+	ElemType* values = (ElemType*)out.data();
+	const size_t value_count = out.size() * (sizeof(T) / sizeof(ElemType));
+	const char* iter = (const char*)job->begin;
+	const char* end = (const char*)job->end;
+	for (size_t i = job->first_value;; ++i) {
+		while (iter < end && isTextSpace(*iter)) ++iter;
+		if (iter == end) return true;
+		if (i >= value_count) return false;
+		iter = fromString<ElemType>(iter, end, &values[i]);
+	}
+}
+
+template <typename T> [[nodiscard]] bool pushJob(std::vector<ParseDataJob>& jobs, Property& prop, std::vector<T>& data) {
+	using ElemType = typename TElemType<T>::Type;
+	if (prop.value.is_binary || size_t(prop.value.end - prop.value.begin) <= TEXT_ARRAY_CHUNK_SIZE) {
+		ParseDataJob& job = emplace_back(jobs);
+		job.property = &prop;
+		job.data = (void*)&data;
+		job.begin = prop.value.begin;
+		job.end = prop.value.end;
+		job.f = [](ParseDataJob* job){ return parseVecData(*job->property, (std::vector<T>*)job->data); };
+		return true;
+	}
+
+	// the output is sized from the value count of the tokenizer, a part starts at the value after the commas before it
+	const size_t elem_count = sizeof(T) / sizeof(ElemType);
+	data.clear();
+	data.resize((prop.count + elem_count - 1) / elem_count);
+	size_t first_value = 0;
+	for (const u8* begin = prop.value.begin; begin < prop.value.end;) {
+		const u8* end = begin + std::min(TEXT_ARRAY_CHUNK_SIZE, size_t(prop.value.end - begin));
+		const u8* comma = end < prop.value.end ? (const u8*)memchr(end, ',', prop.value.end - end) : nullptr;
+		end = comma ? comma + 1 : prop.value.end;
+
+		ParseDataJob& job = emplace_back(jobs);
+		job.property = &prop;
+		job.data = (void*)&data;
+		job.begin = begin;
+		job.end = end;
+		job.first_value = first_value;
+		job.f = &parseTextArrayChunk<T>;
+
+		first_value += countChar(begin, end, ',');
+		begin = end;
+	}
+	return true;
+}
+
 template <typename T> static bool parseVertexData(const Element& element, const char* name, const char* index_name, T& out, std::vector<ParseDataJob>& jobs) {
 	const Element* data_element = findChild(element, name);
 	if (!data_element || !data_element->first_property) return false;
@@ -3562,9 +3663,13 @@ static bool parseObjects(const Element& root, Scene& scene, u16 flags, Allocator
 	}
 
 	if (!jobs.empty()) {
+		// largest arrays first, a big one picked up last would run alone at the end
+		std::stable_sort(jobs.begin(), jobs.end(), [](const ParseDataJob& a, const ParseDataJob& b) {
+			return a.end - a.begin > b.end - b.begin;
+		});
 		(*job_processor)([](void* ptr){
 			ParseDataJob* job = (ParseDataJob*)ptr;
-			job->error = !job->f(job->property, job->data);
+			job->error = !job->f(job);
 		}, job_user_ptr, &jobs[0], (u32)sizeof(jobs[0]), (u32)jobs.size());
 
 		for (const ParseDataJob& job : jobs) {
@@ -4056,14 +4161,18 @@ bool Scene::finalize() {
 IScene* load(const u8* data, usize size, u16 flags, JobProcessor job_processor, void* job_user_ptr)
 {
 	std::unique_ptr<Scene> scene(new Scene());
-	scene->m_data.resize(size);
-	memcpy(&scene->m_data[0], data, size);
+	const u8* scene_data = data;
+	if ((flags & (u16)LoadFlags::BORROW_DATA) == 0) {
+		scene->m_data.resize(size);
+		memcpy(&scene->m_data[0], data, size);
+		scene_data = &scene->m_data[0];
+	}
 
 	const bool is_binary = size >= 18 && strncmp((const char*)data, "Kaydara FBX Binary", 18) == 0;
 	OptionalError<Element*> root(nullptr);
 	if (is_binary) {
 		u32 version;
-		root = tokenize(&scene->m_data[0], size, version, scene->m_allocator);
+		root = tokenize(scene_data, size, version, scene->m_allocator);
 		scene->version = version;
 		if (version < 6100)
 		{
@@ -4077,7 +4186,7 @@ IScene* load(const u8* data, usize size, u16 flags, JobProcessor job_processor,
 		}
 	}
 	else {
-		root = tokenizeText(&scene->m_data[0], size, scene->m_allocator);
+		root = tokenizeText(scene_data, size, scene->m_allocator);
 		if (root.isError()) return nullptr;
 		const ofbx::Element* header = findChild(*root.getValue(), "FBXHeaderExtension");
 		if (header) {
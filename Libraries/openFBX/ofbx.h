@@ -30,7 +30,7 @@ using JobProcessor = void (*)(JobFunction, void*, void*, u32, u32);
 enum class LoadFlags : u16
 {
 	NONE = 0,
-	UNUSED = 1 << 0, // can be reused
+	BORROW_DATA = 1 << 0, // tokenize straight from the caller's buffer instead of copying it, it must outlive the scene
 	IGNORE_GEOMETRY = 1 << 1,
 	IGNORE_BLEND_SHAPES = 1 << 2,
 	IGNORE_CAMERAS = 1 << 3,
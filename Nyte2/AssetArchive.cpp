@@ -0,0 +1,174 @@
+#include "AssetArchive.h"
+
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <algorithm>
+#include <filesystem>
+
+using namespace AssetArchiveFormat;
+
+namespace
+{
+    u64 alignBlob(u64 _offset) { return (_offset + BlobAlignment - 1) & ~(BlobAlignment - 1); }
+}
+
+std::string AssetArchive::assetName(const std::string& _sourcePath, const std::string& _variant)
+{
+    std::string name = std::filesystem::path(_sourcePath).lexically_normal().generic_string();
+    return _variant.empty() ? name : name + "#" + _variant;
+}
+
+u64 AssetArchive::nameHash(const std::string& _name)
+{
+    return FileHelper::hash64(_name.data(), _name.size(), Magic);
+}
+
+bool AssetArchive::open(AssetArchiveView& _view, const std::string& _archivePath)
+{
+    _view = AssetArchiveView{};
+
+    try
+    {
+        _view.m_file.map(_archivePath);
+    }
+    catch (const std::exception&)
+    {
+        return false; // nothing cooked yet
+    }
+
+    size_t fileSize = _view.m_file.size();
+    if (fileSize < sizeof(Header))
+        return false;
+
+    const Header* header = (const Header*)_view.m_file.data();
+    if (header->magic != Magic || header->version != Version
+        || header->entriesOffset + sizeof(Entry) * (u64)header->entryCount > fileSize
+        || header->namesOffset + header->namesSize > fileSize)
+        return false;
+
+    const Entry* entries = (const Entry*)(_view.m_file.data() + header->entriesOffset);
+    for (u32 i = 0; i < header->entryCount; ++i)
+    {
+        if (entries[i].offset % BlobAlignment != 0 || entries[i].offset + entries[i].size > fileSize || entries[i].nameOffset >= header->namesSize || entries[i].sourceOffset >= header->namesSize)
+            return false;
+    }
+
+    _view.m_header = header;
+    _view.m_entries = entries;
+    return true;
+}
+
+bool AssetArchive::verify(const AssetArchiveView& _view, const Entry& _entry)
+{
+    return FileHelper::hash64(_view.blob(_entry), (size_t)_entry.size) == _entry.contentHash;
+}
+
+const Entry* AssetArchiveView::find(const std::string& _name) const
+{
+    if (!m_header)
+        return nullptr;
+
+    u64 hash = AssetArchive::nameHash(_name);
+    const Entry* end = m_entries + m_header->entryCount;
+    const Entry* entry = std::lower_bound(m_entries, end, hash, [](const Entry& _entry, u64 _hash) { return _entry.nameHash < _hash; });
+    for (; entry != end && entry->nameHash == hash; ++entry)
+    {
+        if (_name == name(*entry))
+            return entry;
+    }
+    return nullptr;
+}
+
+void AssetArchiveWriter::open(const std::string& _archivePath)
+{
+    m_path = _archivePath;
+    m_file.open(m_path + ".tmp", std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+        throw std::runtime_error(std::string{ "Failed to create archive: " } + _archivePath);
+
+    // the header is written last, once the entries are known
+    Header header{};
+    m_file.write((const char*)&header, sizeof(Header));
+    m_offset = sizeof(Header);
+}
+
+void AssetArchiveWriter::add(const std::string& _name, AssetType _type, const std::string& _sourcePath, u64 _sourceHash, u32 _processorVersion, const void* _blob, size_t _size)
+{
+    static const char zeros[BlobAlignment] = {};
+
+    Entry entry{};
+    entry.nameHash = AssetArchive::nameHash(_name);
+    entry.sourceHash = _sourceHash;
+    entry.contentHash = FileHelper::hash64(_blob, _size);
+    entry.size = _size;
+    entry.type = _type;
+    entry.processorVersion = _processorVersion;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto shared = m_blobs.find(entry.contentHash);
+    if (shared != m_blobs.end() && m_entries[shared->second].size == _size)
+    {
+        entry.offset = m_entries[shared->second].offset;
+        m_sharedBytes += _size;
+    }
+    else
+    {
+        entry.offset = alignBlob(m_offset);
+        m_file.write(zeros, entry.offset - m_offset);
+        m_file.write((const char*)_blob, _size);
+        m_offset = entry.offset + _size;
+        m_blobBytes += _size;
+        m_blobs.emplace(entry.contentHash, m_entries.size());
+    }
+    m_entries.push_back(entry);
+    m_names.push_back(_name);
+    m_sources.push_back(AssetArchive::assetName(_sourcePath));
+}
+
+bool AssetArchiveWriter::finish()
+{
+    // names are laid out in entry order followed by each source path once, the entries are then sorted for AssetArchiveView::find
+    std::string names;
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        m_entries[i].nameOffset = (u32)names.size();
+        names.append(m_names[i]).push_back('\0');
+    }
+    std::unordered_map<std::string, u32> sourceOffsets;
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        auto source = sourceOffsets.emplace(m_sources[i], (u32)names.size());
+        if (source.second)
+            names.append(m_sources[i]).push_back('\0');
+        m_entries[i].sourceOffset = source.first->second;
+    }
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry& _a, const Entry& _b) { return _a.nameHash < _b.nameHash; });
+
+    Header header{};
+    header.magic = Magic;
+    header.version = Version;
+    header.entryCount = (u32)m_entries.size();
+    header.namesSize = (u32)names.size();
+    header.entriesOffset = (m_offset + alignof(Entry) - 1) / alignof(Entry) * alignof(Entry);
+    header.namesOffset = header.entriesOffset + sizeof(Entry) * m_entries.size();
+
+    static const char zeros[alignof(Entry)] = {};
+    m_file.write(zeros, header.entriesOffset - m_offset);
+    m_file.write((const char*)m_entries.data(), sizeof(Entry) * m_entries.size());
+    m_file.write(names.data(), names.size());
+    m_file.seekp(0);
+    m_file.write((const char*)&header, sizeof(Header));
+    bool written = m_file.good();
+    m_file.close();
+
+    // the previous archive stays in place until the new one is complete
+    std::string tmpPath = m_path + ".tmp";
+    if (!written)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    std::remove(m_path.c_str());
+    return std::rename(tmpPath.c_str(), m_path.c_str()) == 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+// stl
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+#include "Common.h"
+#include "FileHelper.h"
+
+// Packed archive of cooked assets, written by NyteCook and mapped by the engine at startup.
+//
+//  Header
+//  blobs, each aligned on BlobAlignment so they map straight to pages
+//  Entry[entryCount], sorted by nameHash
+//  names, '\0' terminated (asset names, then the source paths)
+//
+// Blobs are ready to upload: meshes are whole mesh cache images (see MeshCacheFormat),
+// textures KTX2 files with every mip level (see KTX2Helper).
+// Identical blobs are stored once, entries then share their offset.
+// Every entry records its source and the processor that cooked it, see AssetDependencyGraph.
+namespace AssetArchiveFormat
+{
+    static constexpr u32 Magic = 0x4B50594E; // "NYPK"
+    static constexpr u32 Version = 2; // 2: source path and processor version per entry
+    static constexpr u64 BlobAlignment = 4096;
+    static constexpr u32 MaxMipLevels = 16;
+
+    enum AssetType : u32
+    {
+        Mesh = 0,
+        Texture,
+    };
+
+    struct Header
+    {
+        u32 magic;
+        u32 version;
+        u32 entryCount;
+        u32 namesSize; // bytes
+        u64 entriesOffset; // from the start of the file
+        u64 namesOffset;
+    };
+
+    struct Entry
+    {
+        u64 nameHash; // see AssetArchive::nameHash
+        u64 sourceHash; // content hash of the source file (FileHelper::hashFile)
+        u64 contentHash; // hash of the blob
+        u64 offset; // from the start of the file, aligned on BlobAlignment
+        u64 size;
+        u32 type; // AssetType
+        u32 nameOffset; // in the names
+        u32 sourceOffset; // source path, in the names
+        u32 processorVersion; // see AssetCooker::processorVersion
+    };
+
+    struct Mip
+    {
+        u64 offset; // from the start of the blob
+        u64 size;
+        u32 width;
+        u32 height;
+    };
+
+    // Levels of a texture blob, parsed from its KTX2 header (KTX2Helper::read). Mip 0 is the full resolution one
+    struct TextureHeader
+    {
+        u32 width;
+        u32 height;
+        u32 format; // VkFormat
+        u32 mipLevels;
+        Mip mips[MaxMipLevels];
+    };
+};
+
+// Read only view on a mapped archive, pointers stay valid as long as the view lives
+struct AssetArchiveView
+{
+    MappedFile m_file;
+    const AssetArchiveFormat::Header* m_header = nullptr;
+    const AssetArchiveFormat::Entry* m_entries = nullptr;
+
+    bool isOpen() const { return m_header != nullptr; }
+    // nullptr when the archive has no such asset
+    const AssetArchiveFormat::Entry* find(const std::string& _name) const;
+    const octet* blob(const AssetArchiveFormat::Entry& _entry) const { return m_file.data() + _entry.offset; }
+    const char* name(const AssetArchiveFormat::Entry& _entry) const { return m_file.data() + m_header->namesOffset + _entry.nameOffset; }
+    const char* source(const AssetArchiveFormat::Entry& _entry) const { return m_file.data() + m_header->namesOffset + _entry.sourceOffset; }
+};
+
+// Appends blobs to an archive file as they get cooked, the entries and names are written by finish
+class AssetArchiveWriter
+{
+public:
+    // Throws when the file can't be created
+    void open(const std::string& _archivePath);
+    // Thread safe, a blob already in the archive is not written again
+    void add(const std::string& _name, AssetArchiveFormat::AssetType _type, const std::string& _sourcePath, u64 _sourceHash, u32 _processorVersion, const void* _blob, size_t _size);
+    // Returns false if the file couldn't be written
+    bool finish();
+
+    u64 m_blobBytes = 0; // written
+    u64 m_sharedBytes = 0; // deduplicated
+
+private:
+    std::string m_path;
+    std::ofstream m_file;
+    u64 m_offset = 0;
+    std::mutex m_mutex;
+    std::vector<AssetArchiveFormat::Entry> m_entries;
+    std::vector<std::string> m_names;
+    std::vector<std::string> m_sources; // per entry
+    std::unordered_map<u64, size_t> m_blobs; // contentHash -> first entry with it
+};
+
+class AssetArchive
+{
+public:
+    // Assets are named after their source path, relative to the engine working directory, with '/' separators.
+    // _variant tells apart the blobs cooked from one source with different settings (e.g. vertex formats).
+    static std::string assetName(const std::string& _sourcePath, const std::string& _variant = "");
+    static u64 nameHash(const std::string& _name);
+
+    // Returns false when the archive is missing or not in the current format
+    static bool open(AssetArchiveView& _view, const std::string& _archivePath);
+    // Rehash a blob against its entry (reads every page of it)
+    static bool verify(const AssetArchiveView& _view, const AssetArchiveFormat::Entry& _entry);
+};
@@ -0,0 +1,230 @@
+#include "AssetCooker.h"
+
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+// vulkan
+#include "vulkan/vulkan_core.h"
+
+#include "FileHelper.h"
+#include "FBXHelper.h"
+#include "MeshBuilder.h"
+#include "MipGenerator.h"
+#include "TextureEncoder.h"
+#include "KTX2Helper.h"
+
+using namespace AssetArchiveFormat;
+
+namespace
+{
+    // Both vertex formats are cooked, the engine picks one per model
+    const std::vector<VertexFormat> CookedVertexFormats = { VertexFormat::Float32, VertexFormat::Packed16 };
+    constexpr MipGenerator::Filter TextureMipFilter = MipGenerator::Kaiser;
+
+    enum class TextureUsage
+    {
+        Color,
+        Specular,
+        Normal,
+        Scalar,
+    };
+
+    // From the words of the file name, "Rock_8K_Normal_LOD0.jpg" is a normal map
+    TextureUsage textureUsage(const std::string& _sourcePath)
+    {
+        static const std::vector<std::string> NormalWords = { "normal", "normals", "nrm", "nor", "n" };
+        static const std::vector<std::string> ScalarWords = { "roughness", "rough", "metalness", "metallic", "metal", "glossiness", "gloss", "ao", "occlusion",
+            "ambientocclusion", "height", "displacement", "disp", "bump", "cavity", "opacity", "mask" };
+        static const std::vector<std::string> SpecularWords = { "specular", "spec" };
+
+        std::string name = std::filesystem::path(_sourcePath).stem().string();
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char _c) { return (char)std::tolower(_c); });
+        std::vector<std::string> words(1);
+        for (char c : name)
+        {
+            if (std::isalnum((unsigned char)c))
+                words.back().push_back(c);
+            else if (!words.back().empty())
+                words.emplace_back();
+        }
+
+        auto any = [&](const std::vector<std::string>& _usageWords) {
+            return std::any_of(words.begin(), words.end(), [&](const std::string& _word) { return std::find(_usageWords.begin(), _usageWords.end(), _word) != _usageWords.end(); });
+        };
+        if (any(NormalWords))
+            return TextureUsage::Normal;
+        if (any(ScalarWords))
+            return TextureUsage::Scalar;
+        if (any(SpecularWords))
+            return TextureUsage::Specular;
+        return TextureUsage::Color;
+    }
+
+    bool encoderFormat(u32 _format, TextureEncoder::Format& _encoderFormat)
+    {
+        switch (_format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK: _encoderFormat = TextureEncoder::BC1; return true;
+        case VK_FORMAT_BC4_UNORM_BLOCK: _encoderFormat = TextureEncoder::BC4; return true;
+        case VK_FORMAT_BC5_UNORM_BLOCK: _encoderFormat = TextureEncoder::BC5; return true;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK: _encoderFormat = TextureEncoder::BC7; return true;
+        default: return false;
+        }
+    }
+}
+
+bool AssetCooker::sourceType(const std::string& _sourcePath, AssetType& _type)
+{
+    std::string extension = FileHelper::lowerExtension(_sourcePath);
+    if (extension == ".fbx" || extension == ".obj")
+        _type = Mesh;
+    else if (extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".tga" || extension == ".bmp" || extension == ".ktx2")
+        _type = Texture;
+    else
+        return false;
+    return true;
+}
+
+std::vector<std::string> AssetCooker::assetNames(const std::string& _sourcePath, AssetType _type)
+{
+    if (_type == Texture)
+        return { AssetArchive::assetName(_sourcePath) };
+
+    std::vector<std::string> names;
+    for (VertexFormat vertexFormat : CookedVertexFormats)
+        names.push_back(AssetArchive::assetName(_sourcePath, MeshBuilder::variant(vertexFormat)));
+    return names;
+}
+
+void AssetCooker::cookMesh(const std::string& _sourcePath, u64 _sourceHash, const std::vector<VertexFormat>& _vertexFormats, JobSystem* _jobSystem, std::vector<std::vector<u8>>& _images)
+{
+    FBXScene fbx;
+    fbx.filePath = _sourcePath;
+    FBXHelper::loadScene(fbx, _jobSystem);
+
+    _images.resize(_vertexFormats.size());
+    for (size_t f = 0; f < _vertexFormats.size(); ++f)
+    {
+        // the builders release the meshes they pool, every format but the last one works on a copy
+        FBXScene copy;
+        if (f + 1 < _vertexFormats.size())
+            copy = fbx;
+        FBXScene& scene = f + 1 < _vertexFormats.size() ? copy : fbx;
+
+        MeshBuilder builder(_vertexFormats[f]);
+        builder.addMeshes(scene);
+
+        // stored raw, the engine copies the sections straight from the mapped pages
+        MeshCache::serialize(_images[f], _sourceHash, MeshBuilder::layout(_vertexFormats[f]), builder.cacheData(false), _jobSystem);
+    }
+}
+
+u32 AssetCooker::textureFormat(const std::string& _sourcePath, bool _compressed)
+{
+    switch (textureUsage(_sourcePath))
+    {
+    case TextureUsage::Normal: return _compressed ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM;
+    case TextureUsage::Scalar: return _compressed ? VK_FORMAT_BC4_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM;
+    case TextureUsage::Specular: return _compressed ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB;
+    default: return _compressed ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB;
+    }
+}
+
+void AssetCooker::cookTexture(const std::string& _sourcePath, u32 _format, JobSystem* _jobSystem, std::vector<u8>& _blob)
+{
+    TextureHeader header{};
+    if (FileHelper::lowerExtension(_sourcePath) == ".ktx2")
+    {
+        std::vector<octet> file = FileHelper::readFile(_sourcePath);
+        if (!KTX2Helper::read(file.data(), file.size(), header))
+            throw std::runtime_error(std::string{ "Unsupported KTX2 texture: " } + _sourcePath);
+        _blob.assign(file.begin(), file.end());
+        return;
+    }
+
+    RawImage image;
+    image.path = _sourcePath;
+    FileHelper::loadImage(image);
+
+    header.width = (u32)image.width;
+    header.height = (u32)image.height;
+    header.format = _format;
+    header.mipLevels = std::min(MipGenerator::mipLevelCount(header.width, header.height), MaxMipLevels);
+    _blob.assign((size_t)KTX2Helper::layout(header), 0);
+    KTX2Helper::writeHeader(header, _blob.data());
+
+    // RGBA8 levels are built in place, block compressed ones are encoded from an RGBA8 chain
+    TextureEncoder::Format encoderFormat;
+    bool compressed = ::encoderFormat(_format, encoderFormat);
+    std::vector<u8> chain;
+    std::vector<u8*> levels(header.mipLevels);
+    if (compressed)
+    {
+        size_t chainSize = 0;
+        for (u32 l = 0; l < header.mipLevels; ++l)
+            chainSize += (size_t)header.mips[l].width * header.mips[l].height * 4;
+        chain.resize(chainSize);
+        levels[0] = chain.data();
+        for (u32 l = 1; l < header.mipLevels; ++l)
+            levels[l] = levels[l - 1] + (size_t)header.mips[l - 1].width * header.mips[l - 1].height * 4;
+    }
+    else
+    {
+        for (u32 l = 0; l < header.mipLevels; ++l)
+            levels[l] = _blob.data() + header.mips[l].offset;
+    }
+
+    memcpy(levels[0], image.data, (size_t)header.width * header.height * 4);
+    FileHelper::unloadImage(image);
+    MipGenerator::generate(levels.data(), header.width, header.height, header.mipLevels, KTX2Helper::isSrgb(_format), TextureMipFilter, _jobSystem);
+
+    if (!compressed)
+        return;
+    for (u32 l = 0; l < header.mipLevels; ++l)
+        TextureEncoder::encode(encoderFormat, levels[l], header.mips[l].width, header.mips[l].height, _blob.data() + header.mips[l].offset, _jobSystem);
+}
+
+void AssetCooker::cook(const std::string& _sourcePath, AssetType _type, u64 _sourceHash, JobSystem* _jobSystem, std::vector<std::vector<u8>>& _blobs)
+{
+    if (_type == Mesh)
+    {
+        cookMesh(_sourcePath, _sourceHash, CookedVertexFormats, _jobSystem, _blobs);
+        return;
+    }
+    _blobs.resize(1);
+    cookTexture(_sourcePath, textureFormat(_sourcePath, true), _jobSystem, _blobs[0]);
+}
+
+void AssetDependencyGraph::build(const AssetArchiveView& _archive)
+{
+    m_archive = &_archive;
+    m_assets.clear();
+    if (!_archive.isOpen())
+        return;
+
+    for (u32 i = 0; i < _archive.m_header->entryCount; ++i)
+        m_assets[_archive.source(_archive.m_entries[i])].push_back(&_archive.m_entries[i]);
+}
+
+bool AssetDependencyGraph::upToDate(const std::string& _sourcePath, AssetType _type, u64 _sourceHash, std::vector<const Entry*>& _entries) const
+{
+    _entries.clear();
+    auto assets = m_assets.find(AssetArchive::assetName(_sourcePath));
+    if (assets == m_assets.end())
+        return false;
+
+    u32 version = AssetCooker::processorVersion(_type);
+    for (const std::string& name : AssetCooker::assetNames(_sourcePath, _type))
+    {
+        auto entry = std::find_if(assets->second.begin(), assets->second.end(), [&](const Entry* _entry) { return name == m_archive->name(*_entry); });
+        if (entry == assets->second.end() || (*entry)->type != _type || (*entry)->sourceHash != _sourceHash || (*entry)->processorVersion != version)
+            return false;
+        _entries.push_back(*entry);
+    }
+    return true;
+}
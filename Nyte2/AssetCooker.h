@@ -0,0 +1,58 @@
+#pragma once
+
+// stl
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "Common.h"
+#include "VertexModel.h"
+#include "MeshCache.h"
+#include "AssetArchive.h"
+
+class JobSystem;
+
+// Source file -> cooked assets, shared by NyteCook and the engine hot reload.
+// Meshes are cooked as mesh cache images (one per vertex format), textures as KTX2 files with their whole mip chain.
+// Textures are block compressed by usage, told by their file name: BC7 for color, BC1 for specular color, BC5 for normals, BC4 for scalar maps.
+class AssetCooker
+{
+public:
+    // Bumped whenever a processor output changes, assets cooked by an older processor are stale
+    static constexpr u32 MeshProcessorVersion = (MeshCacheFormat::Version << 16) | 1;
+    static constexpr u32 TextureProcessorVersion = 3; // 2: KTX2, block compressed. 3: Kaiser filtered mips
+
+    static u32 processorVersion(AssetArchiveFormat::AssetType _type) { return _type == AssetArchiveFormat::Mesh ? MeshProcessorVersion : TextureProcessorVersion; }
+    // From the file extension, returns false for files that are not cooked
+    static bool sourceType(const std::string& _sourcePath, AssetArchiveFormat::AssetType& _type);
+    // Every asset cooked from a source, in cook order
+    static std::vector<std::string> assetNames(const std::string& _sourcePath, AssetArchiveFormat::AssetType _type);
+
+    // One cache image per vertex format, in _vertexFormats order. Throws when the source can't be imported.
+    static void cookMesh(const std::string& _sourcePath, u64 _sourceHash, const std::vector<VertexFormat>& _vertexFormats, JobSystem* _jobSystem, std::vector<std::vector<u8>>& _images);
+    // VkFormat of a texture by the usage its file name tells, RGBA8 (sRGB for color) when not _compressed
+    static u32 textureFormat(const std::string& _sourcePath, bool _compressed);
+    // KTX2 in _format (RGBA8 or a BC format) with the whole mip chain. KTX2 sources are taken as they are.
+    // Throws when the source can't be decoded.
+    static void cookTexture(const std::string& _sourcePath, u32 _format, JobSystem* _jobSystem, std::vector<u8>& _blob);
+    // Every asset of a source, in assetNames order
+    static void cook(const std::string& _sourcePath, AssetArchiveFormat::AssetType _type, u64 _sourceHash, JobSystem* _jobSystem, std::vector<std::vector<u8>>& _blobs);
+};
+
+// Source file -> assets cooked from it, read back from the entries of a previous archive.
+// A source only needs cooking again when its content hash or its processor version changed, or an asset is missing.
+class AssetDependencyGraph
+{
+public:
+    // _archive has to outlive the graph
+    void build(const AssetArchiveView& _archive);
+
+    // Entries of every asset of the source in assetNames order, false when any of them is stale or missing
+    bool upToDate(const std::string& _sourcePath, AssetArchiveFormat::AssetType _type, u64 _sourceHash, std::vector<const AssetArchiveFormat::Entry*>& _entries) const;
+
+    size_t sourceCount() const { return m_assets.size(); }
+
+private:
+    const AssetArchiveView* m_archive = nullptr;
+    std::unordered_map<std::string, std::vector<const AssetArchiveFormat::Entry*>> m_assets; // source path -> entries
+};
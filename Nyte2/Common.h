@@ -4,8 +4,12 @@
 #include <stdint.h>
 
 // using
+using u64 = uint64_t;
 using u32 = uint32_t;
 using u16 = uint16_t;
+using u8 = uint8_t;
 
+using i64 = int64_t;
 using i32 = int32_t;
-using i16 = int16_t;
\ No newline at end of file
+using i16 = int16_t;
+using i8 = int8_t;
\ No newline at end of file
@@ -10,17 +10,73 @@
 #include <algorithm>
 #include <unordered_map>
 #include <fstream>
+#include <filesystem>
 
 #include "FBXHelper.h"
+#include "MeshCache.h"
+#include "MeshBuilder.h"
+#include "AssetCooker.h"
+#include "KTX2Helper.h"
 
 using namespace std;
 
 
 namespace Nyte
 {
+    static_assert(Model::MaxLodCount == MeshCacheFormat::MaxLodCount && Model::MaxLodCount == FBXSubMesh::MaxLodCount, "LOD counts of the import, the cache and the model differ");
+
+    // Placement of an instance in the model, the model instance offset moves every placement
+    static glm::mat4 instanceTransform(const MeshCacheFormat::Instance& _instance, const glm::vec3& _offset)
+    {
+        glm::mat4 transform(1.0f);
+        for (u32 r = 0; r < 3; ++r)
+            for (u32 c = 0; c < 4; ++c)
+                transform[c][r] = _instance.rows[r][c];
+        transform[3] += glm::vec4(_offset, 0.0f);
+        return transform;
+    }
+
+    // Every level of a color image from one layout to another
+    static void recordImageBarrier(VkCommandBuffer _commandBuffer, VkImage _image, u32 _mipLevels, VkImageLayout _oldLayout, VkImageLayout _newLayout, VkAccessFlags _srcAccessMask, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _srcStageMask, VkPipelineStageFlags _dstStageMask)
+    {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = _oldLayout;
+        barrier.newLayout = _newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = _image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, _mipLevels, 0, 1 };
+        barrier.srcAccessMask = _srcAccessMask;
+        barrier.dstAccessMask = _dstAccessMask;
+        vkCmdPipelineBarrier(_commandBuffer, _srcStageMask, _dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // Finest level whose largest side fits in _tailSize, the coarsest one when none does
+    static u32 textureTailMip(const AssetArchiveFormat::TextureHeader& _header, u32 _tailSize)
+    {
+        u32 mip = 0;
+        while (mip + 1 < _header.mipLevels && std::max(_header.mips[mip].width, _header.mips[mip].height) > _tailSize)
+            ++mip;
+        return mip;
+    }
+
+    // A texture cache is stale when the cache layout or the way chains are cooked changed
+    static constexpr u32 TextureCacheVersion = (TextureCache::CacheVersion << 16) | AssetCooker::TextureProcessorVersion;
+
+    // Bytes of the levels of a texture from _mip on
+    static u64 textureResidentBytes(const TextureCache::Texture& _texture, u32 _mip)
+    {
+        u64 bytes = 0;
+        for (u32 level = _mip; level < _texture.header().mipLevels; ++level)
+            bytes += _texture.header().mips[level].size;
+        return bytes;
+    }
+
     const vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-        VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME
+        VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+        VK_KHR_MAINTENANCE_2_EXTENSION_NAME // UNORM storage views of sRGB images (MipDownsampler)
     };
 
 #if _DEBUG
@@ -88,10 +144,19 @@ namespace Nyte
 
     void Engine::init()
     {
+        auto startTime = std::chrono::high_resolution_clock::now();
 #if _DEBUG
         setupDebugMessenger();
 #endif
 
+        m_jobSystem.init(m_jobThreadCount);
+        cout << "Job system: " << m_jobSystem.getThreadCount() << " threads\n";
+
+        if (AssetArchive::open(m_assetArchive, ASSET_ARCHIVE_PATH))
+            cout << "Asset archive: " << m_assetArchive.m_header->entryCount << " cooked assets\n";
+        else
+            cout << "Asset archive: none, assets are imported from their sources\n";
+
         pickPhysicalDevice();
         createLogicalDevice();
         createSwapchain();
@@ -104,17 +169,10 @@ namespace Nyte
         //createDepthResources();
         //createFramebuffers();
 
-        loadFBXModel(m_models, "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx");
-        loadFBXModel(m_models, "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx");
-        //loadFBXModel(m_models, "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx");
-        //loadFBXModel(m_models, "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx");
-
-        for(Model& model : m_models)
-        {
-            createVertexBuffer(model);
-            createIndexBuffer(model);
-        }
-
+        loadModel(m_models, "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx");
+        loadModel(m_models, "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx");
+        //loadModel(m_models, "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx", VertexFormat::Packed16); // 16 byte vertices
+        //loadModel(m_models, "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx");
 
         createUniformBuffers();
         createTextureSampler();
@@ -126,13 +184,40 @@ namespace Nyte
         createOffscreenGBuffer();
         createDeferredPipepline();
         createSemaphoresAndFences();
+
+        if (m_watchAssets)
+        {
+            startAssetWatch();
+            // hot reloads cook from the sources, the archive is released so NyteCook can replace it meanwhile.
+            // Streamed textures keep reading their finer levels from their texture cache, the sources stay free for editors too.
+            for (TextureCache::Texture& texture : m_textureCache.m_textures)
+            {
+                if (!texture.m_blob || texture.m_file.m_path == TextureCache::cachePath(texture.m_path, texture.header().format))
+                    continue;
+                if (texture.m_sourceHash == 0)
+                    texture.m_sourceHash = FileHelper::hashFile(texture.m_path); // KTX2 streamed from its source
+                if (mapTextureCache(texture, texture.m_blob, texture.m_blobSize))
+                    continue;
+                // the resident levels stay
+                texture.m_file.unmap();
+                texture.m_blob = nullptr;
+            }
+            m_assetArchive = AssetArchiveView{};
+        }
+
+        float initTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+        cout << "Engine init: " << initTime << "ms\n";
     }
 
     void Engine::deinit()
     {
+        stopAssetWatch();
+
         destroySwapchain();
 
         vkDestroySampler(m_logicalDevice, m_textureSampler, nullptr);
+        if (m_mipDownsampler.m_sampler != VK_NULL_HANDLE)
+            m_mipDownsampler.destroy(m_logicalDevice);
         //vkDestroyImageView(m_logicalDevice, m_textureImageView, nullptr);
         //vkDestroyImage(m_logicalDevice, m_textureImage, nullptr);
         //vkFreeMemory(m_logicalDevice, m_textureImageDeviceMemory, nullptr);
@@ -141,14 +226,21 @@ namespace Nyte
 
         destroySemaphoresAndFences();
 
+        destroyTextureUpload();
+        for (RetiredImage& retired : m_retiredImages)
+            retired.m_image.destroyImageAttachment(m_logicalDevice);
         for (Model& model : m_models)
         {
+            destroyInstanceBuffers(model);
+            destroyMeshletBuffer(model);
             destroyIndexBuffer(model);
             destroyVertexBuffer(model);
 
-            for(ImageAttachment& imageAttachment : model.m_material.m_textures)
-                imageAttachment.destroyImageAttachment(m_logicalDevice);
+            for (TextureHandle texture : model.m_material.m_textures)
+                releaseTexture(texture);
         }
+        for (const auto& [parameters, sampler] : m_textureCache.m_samplers)
+            vkDestroySampler(m_logicalDevice, sampler, nullptr);
 
         vkDestroyCommandPool(m_logicalDevice, m_transferCommandPool, nullptr);
         vkDestroyCommandPool(m_logicalDevice, m_graphicsCommandPool, nullptr);
@@ -160,10 +252,15 @@ namespace Nyte
 #endif
 
         vkDestroySurfaceKHR(m_instance, *m_surface, nullptr);
+
+        m_jobSystem.deinit();
     }
 
     void Engine::drawFrame()
     {
+        if (m_watchAssets)
+            updateHotReload();
+
         // Acquire next available image in swapchain
         u32 imageIndex;
         VkResult acquireResult = vkAcquireNextImageKHR(m_logicalDevice, m_swapchain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
@@ -192,6 +289,8 @@ namespace Nyte
 
         // Update camera
         updateUniformBuffer(imageIndex);
+        if (STREAM_TEXTURES)
+            updateTextureStreaming(imageIndex);
 
         VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
@@ -486,6 +585,8 @@ namespace Nyte
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(_device, &supportedFeatures);
         isSuitable &= (supportedFeatures.samplerAnisotropy == VK_TRUE);
+        isSuitable &= (supportedFeatures.drawIndirectFirstInstance == VK_TRUE); // visible instance ranges of the culled meshlet draws
+        isSuitable &= (supportedFeatures.textureCompressionBC == VK_TRUE); // cooked textures
 
         // Extensions
         bool physicalDeviceExtensionsSupported = checkDeviceExtensionSupport(_device);
@@ -593,8 +694,18 @@ namespace Nyte
         createInfo.queueCreateInfoCount = (u32)queueCreateInfos.size();
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+        m_multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+        m_computeMips = supportedFeatures.shaderStorageImageWriteWithoutFormat == VK_TRUE && supportedFeatures.shaderStorageImageArrayDynamicIndexing == VK_TRUE;
+
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+        deviceFeatures.textureCompressionBC = VK_TRUE;
+        deviceFeatures.shaderStorageImageWriteWithoutFormat = supportedFeatures.shaderStorageImageWriteWithoutFormat;
+        deviceFeatures.shaderStorageImageArrayDynamicIndexing = supportedFeatures.shaderStorageImageArrayDynamicIndexing;
         createInfo.pEnabledFeatures = &deviceFeatures;
 
         VkPhysicalDeviceSynchronization2Features synchronization2Features{};
@@ -1487,23 +1598,56 @@ namespace Nyte
 
         VCR(vkCreateImageView(m_logicalDevice, &viewInfo, nullptr, &_imageView), "Failed to create image view.");
     }
-    void Engine::generateMipmaps(VkImage _image, VkFormat _format, u32 _texWidth, u32 _texHeight, u32 _mipLevels)
+    void Engine::generateMipmaps(ImageAttachment& _image, VkImageLayout _layout)
     {
-        // Check image format support filtering
-        VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, _format, &formatProperties);
+        VkCommandBuffer graphicsCommandBuffer = beginSingleTimeCommands(m_graphicsCommandPool);
 
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+        if ((_image.m_usage & VK_IMAGE_USAGE_STORAGE_BIT) && m_computeMips && MipDownsampler::supports(_image.m_extent, _image.m_mipLevels))
         {
-            throw std::runtime_error("Image format does not support linear filtering.");
+            if (m_mipDownsampler.m_sampler == VK_NULL_HANDLE)
+                m_mipDownsampler.create(m_logicalDevice);
+            if (_image.m_mipViews.empty())
+                _image.createMipDownsample(m_logicalDevice, m_physicalDevice, m_mipDownsampler);
+            _image.recordMipDownsample(graphicsCommandBuffer, m_mipDownsampler, _layout);
+            endSingleTimeCommands(m_graphicsCommandPool, m_graphicsQueue, graphicsCommandBuffer);
+            return;
         }
 
+        // Nearest blits for formats that can't be filtered linearly
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, _image.m_format, &formatProperties);
+        VkFilter filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+        VkImage image = _image.m_image;
 
-        VkCommandBuffer graphicsCommandBuffer = beginSingleTimeCommands(m_graphicsCommandPool);
+        // Every level to "transfer layout", mip 0 kept
+        {
+            std::array<VkImageMemoryBarrier, 2> barriers{};
+            for (VkImageMemoryBarrier& barrier : barriers)
+            {
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = image;
+                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount = 1;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            }
+            barriers[0].oldLayout = _layout;
+            barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            barriers[0].subresourceRange.baseMipLevel = 0;
+            barriers[0].subresourceRange.levelCount = 1;
+            barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barriers[1].srcAccessMask = VK_ACCESS_NONE;
+            barriers[1].subresourceRange.baseMipLevel = 1;
+            barriers[1].subresourceRange.levelCount = _image.m_mipLevels - 1;
+            vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, _image.m_mipLevels > 1 ? 2 : 1, barriers.data());
+        }
 
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = _image;
+        barrier.image = image;
         barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1511,10 +1655,10 @@ namespace Nyte
         barrier.subresourceRange.layerCount = 1;
         barrier.subresourceRange.levelCount = 1;
 
-        i32 mipWidth = _texWidth;
-        i32 mipHeight = _texHeight;
+        i32 mipWidth = _image.m_extent.width;
+        i32 mipHeight = _image.m_extent.height;
 
-        for (uint32_t i = 1; i < _mipLevels; i++)
+        for (uint32_t i = 1; i < _image.m_mipLevels; i++)
         {
             barrier.subresourceRange.baseMipLevel = i - 1;
             barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
@@ -1547,10 +1691,10 @@ namespace Nyte
             // Blit mip level
             vkCmdBlitImage(
                 graphicsCommandBuffer,
-                _image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                _image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 1, &blit,
-                VK_FILTER_LINEAR);
+                filter);
 
             barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
             barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -1570,7 +1714,7 @@ namespace Nyte
         }
 
 
-        barrier.subresourceRange.baseMipLevel = _mipLevels - 1;
+        barrier.subresourceRange.baseMipLevel = _image.m_mipLevels - 1;
         barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
         barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
@@ -1593,7 +1737,7 @@ namespace Nyte
         VkCommandPoolCreateInfo graphicsPoolInfo{};
         graphicsPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         graphicsPoolInfo.queueFamilyIndex = m_queueFamilyIndices.graphicsFamily.value();
-        graphicsPoolInfo.flags = 0; // Optional
+        graphicsPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // the gbuffer commands of one swapchain image are recorded again by texture streaming
         VCR(vkCreateCommandPool(m_logicalDevice, &graphicsPoolInfo, nullptr, &m_graphicsCommandPool), "Failed to create command pool.");
 
         // Transfer
@@ -1696,6 +1840,10 @@ namespace Nyte
         m_gbuffer.m_vertexShader.m_path = "Resources/Shaders/offscreen_gbuffer_vs.spv";
         m_gbuffer.m_vertexShader.createShader(m_logicalDevice);
 
+        m_gbuffer.m_packedVertexShader = ShaderStage::vertexShader();
+        m_gbuffer.m_packedVertexShader.m_path = "Resources/Shaders/offscreen_gbuffer_packed_vs.spv";
+        m_gbuffer.m_packedVertexShader.createShader(m_logicalDevice);
+
         m_gbuffer.m_fragmentShader = ShaderStage::fragmentShader();
         m_gbuffer.m_fragmentShader.m_path = "Resources/Shaders/offscreen_gbuffer_fs.spv";
         m_gbuffer.m_fragmentShader.createShader(m_logicalDevice);
@@ -1706,9 +1854,20 @@ namespace Nyte
             { VK_FORMAT_R32G32B32_SFLOAT,   sizeof(glm::vec3) }, // position
             { VK_FORMAT_R32G32B32_SFLOAT,   sizeof(glm::vec3) }, // normal
             { VK_FORMAT_R32G32_SFLOAT,      sizeof(glm::vec2) }, // texCoords
+            { VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(glm::vec4) }, // tangent
         };
         vertexDescription.setup();
 
+        // VertexPacked
+        VertexDescription packedVertexDescription;
+        packedVertexDescription.m_bindingIndex = 0;
+        packedVertexDescription.m_inputs = {
+            { VK_FORMAT_R16G16B16A16_UNORM, 4 * sizeof(u16) }, // position, packed tangent in w
+            { VK_FORMAT_R16G16_SNORM,       2 * sizeof(i16) }, // octahedral normal
+            { VK_FORMAT_R16G16_SFLOAT,      2 * sizeof(u16) }, // texCoords
+        };
+        packedVertexDescription.setup();
+
         // Descriptor Set Layout
         m_gbuffer.m_descriptorSetLayout.addUniformBufferBinding(VK_SHADER_STAGE_VERTEX_BIT);    // UBO_ModelViewProj
         //m_gbuffer.m_descriptorSetLayout.addUniformBufferBinding(VK_SHADER_STAGE_FRAGMENT_BIT);  // UBO_MaterialConstants
@@ -1718,8 +1877,13 @@ namespace Nyte
         }
         m_gbuffer.m_descriptorSetLayout.createDescriptorSetLayout(m_logicalDevice);
 
+        m_gbuffer.m_instanceDescriptorSetLayout.addStorageBufferBinding(VK_SHADER_STAGE_VERTEX_BIT);    // instance transforms
+        m_gbuffer.m_instanceDescriptorSetLayout.addStorageBufferBinding(VK_SHADER_STAGE_VERTEX_BIT);    // visible instances
+        m_gbuffer.m_instanceDescriptorSetLayout.createDescriptorSetLayout(m_logicalDevice);
+
         // Pipeline layout
-        m_gbuffer.m_pipelineLayout.m_descriptorSetLayouts = { m_gbuffer.m_descriptorSetLayout };
+        m_gbuffer.m_pipelineLayout.m_descriptorSetLayouts = { m_gbuffer.m_descriptorSetLayout, m_gbuffer.m_instanceDescriptorSetLayout };
+        m_gbuffer.m_pipelineLayout.m_pushConstantRanges = { { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants_Dequant) } };
         m_gbuffer.m_pipelineLayout.createPipelineLayout(m_logicalDevice);
 
         // Pipeline
@@ -1732,6 +1896,37 @@ namespace Nyte
         m_gbuffer.m_pipeline.m_pipelineLayout = m_gbuffer.m_pipelineLayout;
         m_gbuffer.m_pipeline.createPipeline(m_logicalDevice);
 
+        m_gbuffer.m_packedPipeline = m_gbuffer.m_pipeline;
+        m_gbuffer.m_packedPipeline.m_shaders = { m_gbuffer.m_packedVertexShader, m_gbuffer.m_fragmentShader };
+        m_gbuffer.m_packedPipeline.m_vertexDescription = packedVertexDescription;
+        m_gbuffer.m_packedPipeline.createPipeline(m_logicalDevice);
+
+        // Mirrored instances flip the winding of their triangles, they are drawn with the opposite front face
+        m_gbuffer.m_mirroredPipeline = m_gbuffer.m_pipeline;
+        m_gbuffer.m_mirroredPipeline.m_frontFace = VK_FRONT_FACE_CLOCKWISE;
+        m_gbuffer.m_mirroredPipeline.createPipeline(m_logicalDevice);
+
+        m_gbuffer.m_mirroredPackedPipeline = m_gbuffer.m_packedPipeline;
+        m_gbuffer.m_mirroredPackedPipeline.m_frontFace = VK_FRONT_FACE_CLOCKWISE;
+        m_gbuffer.m_mirroredPackedPipeline.createPipeline(m_logicalDevice);
+
+        // Cluster culling pipeline
+        m_gbuffer.m_cullDescriptorSetLayout.addUniformBufferBinding(VK_SHADER_STAGE_COMPUTE_BIT);   // UBO_ModelViewProj
+        m_gbuffer.m_cullDescriptorSetLayout.addStorageBufferBinding(VK_SHADER_STAGE_COMPUTE_BIT);   // meshlets
+        m_gbuffer.m_cullDescriptorSetLayout.addStorageBufferBinding(VK_SHADER_STAGE_COMPUTE_BIT);   // draw commands
+        m_gbuffer.m_cullDescriptorSetLayout.addStorageBufferBinding(VK_SHADER_STAGE_COMPUTE_BIT);   // SubMeshInstances
+        m_gbuffer.m_cullDescriptorSetLayout.addStorageBufferBinding(VK_SHADER_STAGE_COMPUTE_BIT);   // instance transforms
+        m_gbuffer.m_cullDescriptorSetLayout.addStorageBufferBinding(VK_SHADER_STAGE_COMPUTE_BIT);   // visible instances
+        m_gbuffer.m_cullDescriptorSetLayout.createDescriptorSetLayout(m_logicalDevice);
+
+        m_gbuffer.m_cullPipeline.m_shader = ShaderStage::computeShader();
+        m_gbuffer.m_cullPipeline.m_shader.m_path = "Resources/Shaders/cluster_cull_cs.spv";
+        m_gbuffer.m_cullPipeline.m_shader.createShader(m_logicalDevice);
+        m_gbuffer.m_cullPipeline.m_pipelineLayout.m_descriptorSetLayouts = { m_gbuffer.m_cullDescriptorSetLayout };
+        m_gbuffer.m_cullPipeline.m_pipelineLayout.m_pushConstantRanges = { { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants_Cull) } };
+        m_gbuffer.m_cullPipeline.m_pipelineLayout.createPipelineLayout(m_logicalDevice);
+        m_gbuffer.m_cullPipeline.createPipeline(m_logicalDevice);
+
 
         // Descriptor Sets
         u32 swapchainSize = (u32)m_swapchainImages.size();
@@ -1748,18 +1943,109 @@ namespace Nyte
             m_gbuffer.m_descriptorSets.updateDescriptorSets(m_logicalDevice);
         }
 
+        // Indirect draws of every model, one command and one visible instance range per meshlet and swapchain image
+        for (Model& model : m_models)
+            createDrawCommands(model);
+
         // Command buffer
         m_gbuffer.m_cmdBuffers.allocateCommands(m_logicalDevice, m_graphicsCommandPool, swapchainSize);
         m_gbuffer.m_cmdBuffers.m_pipeline = m_gbuffer.m_pipeline;
         m_gbuffer.m_cmdBuffers.m_framebuffer = m_gbuffer.m_framebuffer;
-        
+        recordOffscreenCommandBuffers();
+    }
+    void Engine::createDrawCommands(Model& _model)
+    {
+        u32 swapchainSize = (u32)m_swapchainImages.size();
+        VkDeviceSize drawCommandsSize = sizeof(VkDrawIndexedIndirectCommand) * 2 * (VkDeviceSize)std::max(_model.m_mesh.m_meshletCount, 1u);
+        VkDeviceSize visibleInstancesSize = sizeof(u32) * (VkDeviceSize)std::max(_model.m_mesh.m_instanceSlotCount, 1u);
+        _model.m_mesh.m_drawCommandBuffers.resize(swapchainSize);
+        _model.m_mesh.m_drawCommandBuffersDeviceMemory.resize(swapchainSize);
+        _model.m_mesh.m_visibleInstanceBuffers.resize(swapchainSize);
+        _model.m_mesh.m_visibleInstanceBuffersDeviceMemory.resize(swapchainSize);
+
+        _model.m_mesh.m_cullDescriptorSets.m_descriptorSetLayout = m_gbuffer.m_cullDescriptorSetLayout;
+        _model.m_mesh.m_cullDescriptorSets.allocateDescriptorSets(m_logicalDevice, swapchainSize);
+        _model.m_mesh.m_instanceDescriptorSets.m_descriptorSetLayout = m_gbuffer.m_instanceDescriptorSetLayout;
+        _model.m_mesh.m_instanceDescriptorSets.allocateDescriptorSets(m_logicalDevice, swapchainSize);
+        for (u32 i = 0; i < swapchainSize; ++i)
+        {
+            createBuffer(
+                drawCommandsSize,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                _model.m_mesh.m_drawCommandBuffers[i],
+                _model.m_mesh.m_drawCommandBuffersDeviceMemory[i]);
+            createBuffer(
+                visibleInstancesSize,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                _model.m_mesh.m_visibleInstanceBuffers[i],
+                _model.m_mesh.m_visibleInstanceBuffersDeviceMemory[i]);
+
+            VkDescriptorSet descriptorSet = _model.m_mesh.m_cullDescriptorSets.m_descriptorSets[i];
+            _model.m_mesh.m_cullDescriptorSets.addWriteBufferDescriptorSet(descriptorSet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_uniformBuffers[i], 0, sizeof(UBO_ModelViewProj));
+            _model.m_mesh.m_cullDescriptorSets.addWriteBufferDescriptorSet(descriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _model.m_mesh.m_meshletBuffer, 0, VK_WHOLE_SIZE);
+            _model.m_mesh.m_cullDescriptorSets.addWriteBufferDescriptorSet(descriptorSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _model.m_mesh.m_drawCommandBuffers[i], 0, VK_WHOLE_SIZE);
+            _model.m_mesh.m_cullDescriptorSets.addWriteBufferDescriptorSet(descriptorSet, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _model.m_mesh.m_subMeshInstanceBuffer, 0, VK_WHOLE_SIZE);
+            _model.m_mesh.m_cullDescriptorSets.addWriteBufferDescriptorSet(descriptorSet, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _model.m_mesh.m_instanceBuffer, 0, VK_WHOLE_SIZE);
+            _model.m_mesh.m_cullDescriptorSets.addWriteBufferDescriptorSet(descriptorSet, 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _model.m_mesh.m_visibleInstanceBuffers[i], 0, VK_WHOLE_SIZE);
+            _model.m_mesh.m_cullDescriptorSets.updateDescriptorSets(m_logicalDevice);
+
+            VkDescriptorSet instanceDescriptorSet = _model.m_mesh.m_instanceDescriptorSets.m_descriptorSets[i];
+            _model.m_mesh.m_instanceDescriptorSets.addWriteBufferDescriptorSet(instanceDescriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _model.m_mesh.m_instanceBuffer, 0, VK_WHOLE_SIZE);
+            _model.m_mesh.m_instanceDescriptorSets.addWriteBufferDescriptorSet(instanceDescriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _model.m_mesh.m_visibleInstanceBuffers[i], 0, VK_WHOLE_SIZE);
+            _model.m_mesh.m_instanceDescriptorSets.updateDescriptorSets(m_logicalDevice);
+        }
+    }
+    void Engine::destroyDrawCommands(Model& _model)
+    {
+        _model.m_mesh.m_cullDescriptorSets.freeDescriptorSets(m_logicalDevice);
+        _model.m_mesh.m_instanceDescriptorSets.freeDescriptorSets(m_logicalDevice);
+        for (u32 i = 0; i < _model.m_mesh.m_drawCommandBuffers.size(); ++i)
+        {
+            vkDestroyBuffer(m_logicalDevice, _model.m_mesh.m_drawCommandBuffers[i], nullptr);
+            vkFreeMemory(m_logicalDevice, _model.m_mesh.m_drawCommandBuffersDeviceMemory[i], nullptr);
+            vkDestroyBuffer(m_logicalDevice, _model.m_mesh.m_visibleInstanceBuffers[i], nullptr);
+            vkFreeMemory(m_logicalDevice, _model.m_mesh.m_visibleInstanceBuffersDeviceMemory[i], nullptr);
+        }
+        _model.m_mesh.m_drawCommandBuffers.clear();
+        _model.m_mesh.m_drawCommandBuffersDeviceMemory.clear();
+        _model.m_mesh.m_visibleInstanceBuffers.clear();
+        _model.m_mesh.m_visibleInstanceBuffersDeviceMemory.clear();
+    }
+    // Culling dispatches and draws of every model, recorded again when a model is hot reloaded
+    void Engine::recordOffscreenCommandBuffers()
+    {
+        u32 swapchainSize = (u32)m_swapchainImages.size();
+        m_staleOffscreenCommands.assign(swapchainSize, false);
         for (u32 i = 0; i < swapchainSize; ++i)
+            recordOffscreenCommandBuffer(i);
+    }
+    void Engine::recordOffscreenCommandBuffer(u32 _imageIndex)
+    {
+        m_gbuffer.m_cmdBuffers.beginCommands(_imageIndex);
+
+        // Cull the meshlets of every model against each of their instances, the visible instances are drawn by the meshlet command
+        vkCmdBindPipeline(m_gbuffer.m_cmdBuffers[_imageIndex], VK_PIPELINE_BIND_POINT_COMPUTE, m_gbuffer.m_cullPipeline.m_pipeline);
+        for (Model& model : m_models)
         {
-            m_gbuffer.m_cmdBuffers.beginPass(i);
+            PushConstants_Cull cull{ model.m_mesh.m_meshletCount, (float)m_swapchainExtent.height, LOD_ERROR_PIXELS };
+            vkCmdBindDescriptorSets(m_gbuffer.m_cmdBuffers[_imageIndex], VK_PIPELINE_BIND_POINT_COMPUTE, m_gbuffer.m_cullPipeline.m_pipelineLayout.m_pipelineLayout, 0, 1, &model.m_mesh.m_cullDescriptorSets.m_descriptorSets[_imageIndex], 0, nullptr);
+            vkCmdPushConstants(m_gbuffer.m_cmdBuffers[_imageIndex], m_gbuffer.m_cullPipeline.m_pipelineLayout.m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants_Cull), &cull);
+            vkCmdDispatch(m_gbuffer.m_cmdBuffers[_imageIndex], (model.m_mesh.m_meshletCount + ClusterCullGroupSize - 1) / ClusterCullGroupSize, 1, 1);
+        }
+
+        VkMemoryBarrier drawCommandsBarrier{};
+        drawCommandsBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        drawCommandsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        drawCommandsBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(m_gbuffer.m_cmdBuffers[_imageIndex], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &drawCommandsBarrier, 0, nullptr, 0, nullptr);
 
-            // Build command buffers for each model
-            for (Model& model : m_models)
-                buildOffscreenCommandBuffer(i, model);
+        m_gbuffer.m_cmdBuffers.beginRenderPass(_imageIndex);
+
+        // Build command buffers for each model
+        for (Model& model : m_models)
+            buildOffscreenCommandBuffer(_imageIndex, model);
         //
         //    // bind vertex buffer
         //    VkBuffer vertexBuffers[] = { m_vertexBuffer };
@@ -1770,8 +2056,8 @@ namespace Nyte
         //
         //    vkCmdDrawIndexed(m_gbuffer.m_cmdBuffers[i], (u32)m_model.mesh.indices.size(), 1, 0, 0, 0); // indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
         //
-            m_gbuffer.m_cmdBuffers.endPass(i);
-        }
+        m_gbuffer.m_cmdBuffers.endPass(_imageIndex);
+        m_staleOffscreenCommands[_imageIndex] = false;
     }
     void Engine::buildOffscreenCommandBuffer(const u32 _passIndex, Model& _model)
     {
@@ -1803,7 +2089,8 @@ namespace Nyte
             {
                 for (u32 j = 0; j < Model::Material::TextureCount; ++j)
                 {
-                    m_gbuffer.m_descriptorSets.addWriteImageDescriptorSet(m_gbuffer.m_descriptorSets.m_descriptorSets[_passIndex], 1 + j, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_textureSampler, _model.m_material.m_textures[j].m_imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                    const TextureCache::Texture& texture = m_textureCache.get(_model.m_material.m_textures[j]);
+                    m_gbuffer.m_descriptorSets.addWriteImageDescriptorSet(m_gbuffer.m_descriptorSets.m_descriptorSets[_passIndex], 1 + j, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture.m_sampler, texture.m_image.m_imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
                 }
             }
             //else if(_model.m_material.m_type == Model::Material::MaterialType::ConstantBased)
@@ -1814,13 +2101,50 @@ namespace Nyte
         }
 
         // Command buffers
+        bool packedVertices = _model.m_mesh.m_vertexFormat == VertexFormat::Packed16;
         VkBuffer vertexBuffers[] = { _model.m_mesh.m_vertexBuffer };
         VkDeviceSize offsets[] = { 0 };
         vkCmdBindVertexBuffers(m_gbuffer.m_cmdBuffers[_passIndex], 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(m_gbuffer.m_cmdBuffers[_passIndex], _model.m_mesh.m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
         vkCmdBindDescriptorSets(m_gbuffer.m_cmdBuffers[_passIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_gbuffer.m_pipelineLayout.m_pipelineLayout, 0, 1, &m_gbuffer.m_descriptorSets.m_descriptorSets[_passIndex], 0, nullptr);
+        vkCmdBindDescriptorSets(m_gbuffer.m_cmdBuffers[_passIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_gbuffer.m_pipelineLayout.m_pipelineLayout, 1, 1, &_model.m_mesh.m_instanceDescriptorSets.m_descriptorSets[_passIndex], 0, nullptr);
 
-        vkCmdDrawIndexed(m_gbuffer.m_cmdBuffers[_passIndex], (u32)_model.m_mesh.m_indices.size(), 1, 0, 0, 0); // indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
+        // Regular instances, then the mirrored ones with the opposite winding from the second half of the draw commands
+        u32 windingCount = _model.m_mesh.m_mirroredInstanceCount > 0 ? 2 : 1;
+        for (u32 winding = 0; winding < windingCount; ++winding)
+        {
+            const Pipeline& pipeline = winding == 0 ? (packedVertices ? m_gbuffer.m_packedPipeline : m_gbuffer.m_pipeline)
+                : (packedVertices ? m_gbuffer.m_mirroredPackedPipeline : m_gbuffer.m_mirroredPipeline);
+            vkCmdBindPipeline(m_gbuffer.m_cmdBuffers[_passIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.m_pipeline);
+
+            // the index buffer is rebound only when the index width changes, firstIndex is in units of that width
+            VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+            for (const Model::SubMesh& subMesh : _model.m_mesh.m_subMeshes)
+            {
+                if (subMesh.m_indexType != boundIndexType)
+                {
+                    vkCmdBindIndexBuffer(m_gbuffer.m_cmdBuffers[_passIndex], _model.m_mesh.m_indexBuffer, 0, subMesh.m_indexType);
+                    boundIndexType = subMesh.m_indexType;
+                }
+                if (packedVertices)
+                {
+                    PushConstants_Dequant dequant{ glm::vec4(subMesh.m_positionScale, 0.0f), glm::vec4(subMesh.m_positionOffset, 0.0f) };
+                    vkCmdPushConstants(m_gbuffer.m_cmdBuffers[_passIndex], m_gbuffer.m_pipelineLayout.m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants_Dequant), &dequant);
+                }
+
+                // culled meshlets have no instance, firstInstance points at their visible instance slots
+                VkBuffer drawCommands = _model.m_mesh.m_drawCommandBuffers[_passIndex];
+                VkDeviceSize drawCommandsOffset = sizeof(VkDrawIndexedIndirectCommand) * ((VkDeviceSize)winding * _model.m_mesh.m_meshletCount + subMesh.m_firstMeshlet);
+                if (m_multiDrawIndirect)
+                {
+                    vkCmdDrawIndexedIndirect(m_gbuffer.m_cmdBuffers[_passIndex], drawCommands, drawCommandsOffset, subMesh.m_meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+                }
+                else
+                {
+                    for (u32 m = 0; m < subMesh.m_meshletCount; ++m)
+                        vkCmdDrawIndexedIndirect(m_gbuffer.m_cmdBuffers[_passIndex], drawCommands, drawCommandsOffset + m * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+                }
+            }
+        }
 
     }
     void Engine::unbuildOffscreenCommandBuffer(Model& _model)
@@ -1844,13 +2168,26 @@ namespace Nyte
         // Command buffer
         m_gbuffer.m_cmdBuffers.freeCommands(m_logicalDevice, m_graphicsCommandPool);
 
+        // Indirect draws
+        for (Model& model : m_models)
+            destroyDrawCommands(model);
+
         // Descriptor Sets
         m_gbuffer.m_descriptorSets.freeDescriptorSets(m_logicalDevice);
 
         // Framebuffer
         m_gbuffer.m_framebuffer.destroyFramebuffer(m_logicalDevice);
 
+        // Cluster culling pipeline
+        m_gbuffer.m_cullPipeline.destroyPipeline(m_logicalDevice);
+        m_gbuffer.m_cullPipeline.m_pipelineLayout.destroyPipelineLayout(m_logicalDevice);
+        m_gbuffer.m_cullPipeline.m_shader.destroyShader(m_logicalDevice);
+        m_gbuffer.m_cullDescriptorSetLayout.destroyDescriptorSetLayout(m_logicalDevice);
+
         // Pipeline
+        m_gbuffer.m_mirroredPackedPipeline.destroyPipeline(m_logicalDevice);
+        m_gbuffer.m_mirroredPipeline.destroyPipeline(m_logicalDevice);
+        m_gbuffer.m_packedPipeline.destroyPipeline(m_logicalDevice);
         m_gbuffer.m_pipeline.destroyPipeline(m_logicalDevice);
 
         // Pipeline layout
@@ -1858,9 +2195,11 @@ namespace Nyte
 
         // Descriptor Set Layout
         m_gbuffer.m_descriptorSetLayout.destroyDescriptorSetLayout(m_logicalDevice);
+        m_gbuffer.m_instanceDescriptorSetLayout.destroyDescriptorSetLayout(m_logicalDevice);
 
         // Shaders
         m_gbuffer.m_fragmentShader.destroyShader(m_logicalDevice);
+        m_gbuffer.m_packedVertexShader.destroyShader(m_logicalDevice);
         m_gbuffer.m_vertexShader.destroyShader(m_logicalDevice);
 
         // Render Pass
@@ -2128,43 +2467,7 @@ namespace Nyte
     //    }
     //}
 
-    void Engine::loadOBJModel(std::vector<Model>& _models, string _ojbPath)
-    {
-        //RawObj model;
-        //model.path = MODEL_PATH;
-        //FileHelper::loadModel(model);
-        //unordered_map<Vertex, u32> verticesMap{}; // <Vertex, vertexIndex>
-        //
-        //for (const tinyobj::shape_t& shape : model.shapes)
-        //{
-        //    for (const tinyobj::index_t& index : shape.mesh.indices)
-        //    {
-        //        Vertex vertex{};
-        //        vertex.pos.x = model.attrib.vertices[index.vertex_index * 3 + 0];
-        //        vertex.pos.y = model.attrib.vertices[index.vertex_index * 3 + 1];
-        //        vertex.pos.z = model.attrib.vertices[index.vertex_index * 3 + 2];
-        //
-        //        vertex.normal.x = model.attrib.normals[index.normal_index * 3 + 0];
-        //        vertex.normal.y = model.attrib.normals[index.normal_index * 3 + 1];
-        //        vertex.normal.z = model.attrib.normals[index.normal_index * 3 + 2];
-        //
-        //        vertex.texCoords.x = model.attrib.texcoords[index.texcoord_index * 2 + 0];
-        //        vertex.texCoords.y = 1.0f - model.attrib.texcoords[index.texcoord_index * 2 + 1]; // obj -> vulkan tex coords convertion
-        //
-        //        auto it = verticesMap.find(vertex);
-        //        if (it == verticesMap.end())
-        //        {
-        //            u32 vertexIndex = (u32)m_vertices.size();
-        //            verticesMap[vertex] = vertexIndex;
-        //            m_vertices.push_back(vertex);
-        //            m_indices.push_back(vertexIndex);
-        //        }
-        //        else
-        //            m_indices.push_back(it->second);
-        //    }
-        //}
-    }
-    void Engine::loadFBXModel(std::vector<Model>& _models, string _fbxPath)
+    void Engine::loadModel(std::vector<Model>& _models, string _sourcePath, VertexFormat _vertexFormat)
     {
         cout << "Engine::loadModel >> \n";
 
@@ -2173,145 +2476,677 @@ namespace Nyte
         //string fbxPath = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_LOD0.fbx";
         //string _fbxPath = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw.fbx";
         //string fbxPath = "Resources/Models/Sponza/NewSponza_Main_Yup_003.fbx";
-        string vbCachePath = _fbxPath + ".vb.cache";
-        string ibCachePath = _fbxPath + ".ib.cache";
-
-        // Read caches
-        ifstream readVBCache(vbCachePath.c_str(), ios::binary);
-        ifstream readIBCache(ibCachePath.c_str(), ios::binary);
-        if (readVBCache.is_open() && readIBCache.is_open())
-        {
-            cout << "\t Read cache >> \n";
-            readVBCache.seekg(0, ios::end);
-            readIBCache.seekg(0, ios::end);
-            streamsize vbCacheSize = readVBCache.tellg();
-            streamsize ibCacheSize = readIBCache.tellg();
-            readVBCache.seekg(0, ios::beg);
-            readIBCache.seekg(0, ios::beg);
-            
-            size_t vbCount = vbCacheSize / sizeof(Vertex);
-            size_t ibCount = ibCacheSize / sizeof(u32);
-            model.m_mesh.m_vertices.resize(vbCount);
-            model.m_mesh.m_indices.resize(ibCount);
-
-            char* vbTmp = new char[vbCacheSize];
-            char* ibTmp = new char[ibCacheSize];
-            readVBCache.read(vbTmp, vbCacheSize);
-            readIBCache.read(ibTmp, ibCacheSize);
-            readVBCache.close();
-            readIBCache.close();
-
-            memcpy(model.m_mesh.m_vertices.data(), vbTmp, vbCacheSize);
-            memcpy(model.m_mesh.m_indices.data(), ibTmp, ibCacheSize);
-            delete(vbTmp);
-            delete(ibTmp);
-            cout << "\t << Read cache\n";
+        model.m_sourcePath = _sourcePath;
+        model.m_mesh.m_vertexFormat = _vertexFormat;
+
+        static float instance_offset_HACK = 0.0f;
+        static bool doOffset = false;
+        model.m_instanceOffset = doOffset ? glm::vec3(instance_offset_HACK, 0.0f, 0.0f) : glm::vec3(0.0f);
+        doOffset = true;
+        instance_offset_HACK += 50.0f;
+
+        loadMesh(model);
+
+        cout << "\t Load textures >> \n";
+        model.m_material.m_type = Model::Material::MaterialType::TextureBased;
+
+        //string diffuse = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_8K_Albedo.jpg";
+        //string normal = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_8K_Normal_LOD0.jpg";
+        //string specular = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_8K_Specular.jpg";
+        //string glossiness = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_8K_Roughness.jpg";
+        string diffuse = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw_8K_Diffuse.jpg";
+        string normal = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw_8K_Normal.jpg";
+        string specular = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw_8K_Metalness.jpg";
+        string glossiness = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw_8K_Roughness.jpg";
+
+        model.m_material.m_textures = acquireTextures({ diffuse, normal, specular, glossiness });
+        cout << "\t << Load textures \n";
+
+
+
+        _models.push_back(model);
+        cout << "<< Engine::loadModel\n";
+    }
+
+    void Engine::loadMesh(Model& _model, const HotReload* _reload, u32 _blob)
+    {
+        const string& sourcePath = _model.m_sourcePath;
+        const VertexFormat vertexFormat = _model.m_mesh.m_vertexFormat;
+
+        string cachePath = MeshCache::getCachePath(sourcePath, MeshBuilder::variant(vertexFormat));
+        const MeshCacheFormat::Layout vertexLayout = MeshBuilder::layout(vertexFormat);
+
+        // Geometry is decoded from the mapped cache straight into the staging buffers, or copied from the imported mesh when the cache is stale.
+        // A cooked asset is a cache image inside the mapped archive, the source file is not even hashed then.
+        // A hot reload brings its own image, cooked from the edited source.
+        MeshCacheView cache;
+        const void* vertexData = nullptr;
+        const void* indexData = nullptr;
+        const MeshCacheFormat::SubMesh* subMeshes = nullptr;
+        u32 subMeshCount = 0;
+        const MeshCacheFormat::Meshlet* meshletData = nullptr;
+        const MeshCacheFormat::Instance* instanceData = nullptr;
+        MeshBuilder builder(vertexFormat);
+        MeshCacheData cacheData;
+        bool writeCache = false;
+
+        bool cached = false;
+        u64 sourceHash = 0;
+        if (_reload)
+        {
+            const std::vector<u8>& image = _reload->m_blobs[_blob];
+            cached = MeshCache::open(cache, (const octet*)image.data(), image.size(), _reload->m_sourceHash, vertexLayout);
+        }
+        const AssetArchiveFormat::Entry* cooked = _reload ? nullptr : findCookedAsset(sourcePath, MeshBuilder::variant(vertexFormat), AssetArchiveFormat::Mesh);
+        if (cooked)
+            cached = MeshCache::open(cache, m_assetArchive.blob(*cooked), (size_t)cooked->size, cooked->sourceHash, vertexLayout);
+        if (!cached && !_reload)
+        {
+            sourceHash = FileHelper::hashFile(sourcePath);
+            cached = MeshCache::open(cache, cachePath, sourceHash, vertexLayout);
+        }
+
+        if (cached)
+        {
+            const char* origin = _reload ? "hot reload" : cache.m_file.data() ? "cache" : "archive";
+            cout << "\t Read " << origin << " >> \n";
+            _model.m_mesh.m_vertexCount = cache.m_header->vertexCount;
+            _model.m_mesh.m_indexCount = cache.m_header->indexCount;
+            _model.m_mesh.m_indexDataSize = cache.m_header->indexDataSize;
+            _model.m_mesh.m_meshletCount = cache.meshletCount();
+            subMeshes = cache.subMeshes();
+            subMeshCount = cache.subMeshCount();
+            // vertices and indices may be compressed, they are decoded into the staging buffers
+            meshletData = cache.meshlets();
+            _model.m_mesh.m_instanceCount = cache.instanceCount();
+            instanceData = cache.instances();
+            cout << "\t << Read " << origin << "\n";
+        }
+        else if (_reload)
+        {
+            throw std::runtime_error("Hot reloaded mesh does not match its layout: " + sourcePath);
         }
         else
         {
-            // no cache found, load fbx
-            FBXScene fbx;
-            fbx.filePath = _fbxPath;
+            // no valid cache found, import the fbx or obj source
+            FBXScene scene;
+            scene.filePath = sourcePath;
 
-            cout << "\t LoadFBX >> \n";
-            FBXHelper::loadFBX(fbx);
-            cout << "\t << LoadFBX\n";
+            cout << "\t Import >> \n";
+            if (BENCHMARK_IMPORT)
+            {
+                FBXScene singleThreadedScene;
+                singleThreadedScene.filePath = sourcePath;
+                FBXHelper::loadScene(singleThreadedScene, nullptr);
+            }
+            // Staged import: every mesh is welded, optimized and converted on its own job once the file is parsed,
+            // converted meshes join the vertex/index pool in mesh order while the next ones are still being processed
+            FBXHelper::loadScene(scene, &m_jobSystem, [&](u32 _mesh) { builder.addMesh(scene, _mesh); });
+            cout << "\t << Import\n";
+            cout << "\t\t " << scene.meshes.size() << " meshes, " << builder.m_instances.size() << " instances, " << builder.m_subMeshes.size() << " submeshes (" << builder.m_subMeshes16 << " with 16 bit indices), " << scene.materials.size() << " materials\n";
+
+            _model.m_mesh.m_vertexCount = builder.vertexCount();
+            _model.m_mesh.m_indexCount = builder.m_indexCount;
+            _model.m_mesh.m_indexDataSize = (u32)builder.m_indexData.size();
+            vertexData = builder.vertexData();
+            indexData = builder.m_indexData.data();
+            subMeshes = builder.m_subMeshes.data();
+            subMeshCount = (u32)builder.m_subMeshes.size();
+            _model.m_mesh.m_meshletCount = (u32)builder.m_meshlets.size();
+            meshletData = builder.m_meshlets.data();
+            _model.m_mesh.m_instanceCount = (u32)builder.m_instances.size();
+            instanceData = builder.m_instances.data();
+
+            // The cache is written while the geometry uploads
+            cacheData = builder.cacheData(COMPRESS_MESH_CACHE);
+            writeCache = true;
+        }
 
-            unordered_map<Vertex, u32> verticesMap{}; // <Vertex, vertexIndex>
+        for (u32 i = 0; i < subMeshCount; ++i)
+        {
+            const MeshCacheFormat::SubMesh& cached = subMeshes[i];
+            glm::vec3 positionScale(cached.positionScale[0], cached.positionScale[1], cached.positionScale[2]);
+            glm::vec3 positionOffset(cached.positionOffset[0], cached.positionOffset[1], cached.positionOffset[2]);
+            VkIndexType indexType = cached.indexSize == sizeof(u16) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+            _model.m_mesh.m_subMeshes.push_back({ cached.firstIndex, cached.indexCount, indexType, cached.vertexOffset, cached.vertexCount, cached.materialSlot, positionScale, positionOffset, cached.firstMeshlet, cached.meshletCount });
+            for (u32 l = 0; l < cached.lodCount; ++l)
+                _model.m_mesh.m_subMeshes.back().m_lods.push_back({ cached.lods[l].firstIndex, cached.lods[l].indexCount, cached.lods[l].error });
+            _model.m_mesh.m_subMeshes.back().m_firstInstance = cached.firstInstance;
+            _model.m_mesh.m_subMeshes.back().m_instanceCount = cached.instanceCount;
+
+            // sphere around the meshlet spheres, the culling projects the LOD errors from it for each instance
+            glm::vec3 subMeshMin(std::numeric_limits<float>::max());
+            glm::vec3 subMeshMax(-std::numeric_limits<float>::max());
+            for (u32 m = cached.firstMeshlet; m < cached.firstMeshlet + cached.meshletCount; ++m)
+            {
+                glm::vec3 center(meshletData[m].center[0], meshletData[m].center[1], meshletData[m].center[2]);
+                subMeshMin = glm::min(subMeshMin, center - meshletData[m].radius);
+                subMeshMax = glm::max(subMeshMax, center + meshletData[m].radius);
+            }
+            if (cached.meshletCount > 0)
+                _model.m_mesh.m_subMeshes.back().m_sphere = glm::vec4((subMeshMin + subMeshMax) * 0.5f, glm::length(subMeshMax - subMeshMin) * 0.5f);
+        }
 
-            //for (const FBXMesh& mesh : fbx.meshes)
-            const FBXMesh& mesh = fbx.meshes[0];
+        MeshCacheReadStatistics readStatistics;
+        bool cacheWritten = true;
+        // Job 0 fills the staging buffers and uploads, job 1 writes the fresh cache from the same pooled geometry
+        m_jobSystem.parallelFor(writeCache ? 2 : 1, [&](u32 _job) {
+            if (_job == 1)
             {
-                for (FBXVertex v : mesh.m_vertices)
-                {
-                    Vertex vertex{};
-                    vertex.pos.x = v.position.x;
-                    vertex.pos.y = v.position.y;
-                    vertex.pos.z = v.position.z;
+                cacheWritten = MeshCache::write(cachePath, sourceHash, vertexLayout, cacheData, &m_jobSystem);
+                return;
+            }
+
+            VkDeviceSize vertexBufferSize = vertexLayout.stride * (VkDeviceSize)_model.m_mesh.m_vertexCount;
+            createVertexBuffer(_model, vertexBufferSize, [&](void* _staging) {
+                if (vertexData)
+                    memcpy(_staging, vertexData, (size_t)vertexBufferSize);
+                else
+                    MeshCache::readSection(cache, MeshCacheFormat::Vertices, _staging, &m_jobSystem, &readStatistics);
+            });
 
-                    vertex.normal.x = v.normal.x;
-                    vertex.normal.y = v.normal.y;
-                    vertex.normal.z = v.normal.z;
+            VkDeviceSize indexBufferSize = _model.m_mesh.m_indexDataSize;
+            createIndexBuffer(_model, indexBufferSize, [&](void* _staging) {
+                if (indexData)
+                    memcpy(_staging, indexData, (size_t)indexBufferSize);
+                else
+                    MeshCache::readSection(cache, MeshCacheFormat::Indices, _staging, &m_jobSystem, &readStatistics);
+            });
 
-                    vertex.texCoords.x = v.uv.x;
-                    vertex.texCoords.y = v.uv.y;
+            // never empty, an empty mesh still binds it
+            size_t meshletDataSize = sizeof(MeshCacheFormat::Meshlet) * (size_t)_model.m_mesh.m_meshletCount;
+            VkDeviceSize meshletBufferSize = sizeof(MeshCacheFormat::Meshlet) * (VkDeviceSize)std::max(_model.m_mesh.m_meshletCount, 1u);
+            createMeshletBuffer(_model, meshletBufferSize, [&](void* _staging) {
+                if (meshletDataSize)
+                    memcpy(_staging, meshletData, meshletDataSize);
+            });
 
-                    model.m_mesh.m_vertices.push_back(vertex);
+            createInstanceBuffers(_model, instanceData);
+        });
+        if (readStatistics.rawSize)
+        {
+            cout << "\t\t mesh cache " << readStatistics.storedSize / (1024.0f * 1024.0f) << "MB -> " << readStatistics.rawSize / (1024.0f * 1024.0f) << "MB (x" << readStatistics.ratio() << "), decoded in "
+                << readStatistics.milliseconds << "ms (" << readStatistics.gigabytesPerSecond() << " GB/s)\n";
+        }
+        if (writeCache)
+            cout << "\t\t " << (cacheWritten ? "Wrote " : "Failed to write ") << cachePath << " during upload\n";
+
+        // Texture streaming input: bounds of the submesh spheres of every placement
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+        for (const Model::SubMesh& subMesh : _model.m_mesh.m_subMeshes)
+        {
+            if (subMesh.m_meshletCount == 0)
+                continue;
+            glm::vec3 subMeshMin = glm::vec3(subMesh.m_sphere) - subMesh.m_sphere.w;
+            glm::vec3 subMeshMax = glm::vec3(subMesh.m_sphere) + subMesh.m_sphere.w;
+
+            for (u32 i = subMesh.m_firstInstance; i < subMesh.m_firstInstance + subMesh.m_instanceCount; ++i)
+            {
+                glm::mat4 transform = instanceTransform(instanceData[i], _model.m_instanceOffset);
+                for (u32 corner = 0; corner < 8; ++corner)
+                {
+                    glm::vec3 position((corner & 1) ? subMeshMax.x : subMeshMin.x, (corner & 2) ? subMeshMax.y : subMeshMin.y, (corner & 4) ? subMeshMax.z : subMeshMin.z);
+                    position = glm::vec3(transform * glm::vec4(position, 1.0f));
+                    boundsMin = glm::min(boundsMin, position);
+                    boundsMax = glm::max(boundsMax, position);
                 }
-                model.m_mesh.m_indices.insert(model.m_mesh.m_indices.end(), mesh.m_indices.begin(), mesh.m_indices.end());
             }
+        }
+        if (boundsMin.x <= boundsMax.x)
+        {
+            _model.m_mesh.m_boundsCenter = (boundsMin + boundsMax) * 0.5f;
+            _model.m_mesh.m_boundsRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+        }
+    }
 
-            // Write caches
-            cout << "\t WriteCache >> \n";
-            ofstream writeVBCache, writeIBCache;
-            
-            writeVBCache.open(vbCachePath.c_str(), ios::binary);
-            writeIBCache.open(ibCachePath.c_str(), ios::binary);
+    void Engine::loadTexture(TextureCache::Texture& _texture)
+    {
+        // Decoding runs outside the upload lock, texture jobs decode concurrently
+        auto startTime = std::chrono::high_resolution_clock::now();
+        const AssetArchiveFormat::Entry* cooked = findCookedAsset(_texture.m_path, "", AssetArchiveFormat::Texture);
+        VkFormat format = _texture.m_parameters.m_format != VK_FORMAT_UNDEFINED ? _texture.m_parameters.m_format : (VkFormat)AssetCooker::textureFormat(_texture.m_path, false);
+        bool ktx2 = FileHelper::lowerExtension(_texture.m_path) == ".ktx2";
+        RawImage rawImage{ _texture.m_path };
+        const octet* blob = nullptr;
+        u64 blobSize = 0;
+        std::vector<u8> cookedBlob;
+        if (cooked)
+        {
+            blob = m_assetArchive.blob(*cooked);
+            blobSize = cooked->size;
+            _texture.m_sourceHash = cooked->sourceHash;
+        }
+        else if (STREAM_TEXTURES && ktx2)
+        {
+            // streamed straight from the mapped source
+            _texture.m_file.map(_texture.m_path);
+            blob = _texture.m_file.data();
+            blobSize = _texture.m_file.size();
+        }
+        else if (STREAM_TEXTURES || !GPU_MIPS || ktx2)
+        {
+            // mip chain built on the CPU like NyteCook does (MipGenerator), the finer levels are streamed from its texture cache.
+            // Not block compressed, too slow for a load. KTX2 sources come as they are.
+            // The texture cache of a previous run is streamed as it is while the source content is the same.
+            if (STREAM_TEXTURES)
+            {
+                _texture.m_sourceHash = FileHelper::hashFile(_texture.m_path);
+                std::lock_guard<std::mutex> lock(m_textureCacheMutex);
+                if (openTextureCache(_texture, (u32)format))
+                {
+                    blob = _texture.m_blob;
+                    blobSize = _texture.m_blobSize;
+                }
+            }
+            if (!blob)
+            {
+                AssetCooker::cookTexture(_texture.m_path, format, &m_jobSystem, cookedBlob);
+                blob = (const octet*)cookedBlob.data();
+                blobSize = cookedBlob.size();
+            }
+        }
+        else
+            FileHelper::loadImage(rawImage);
 
-            if (writeVBCache.is_open() && writeIBCache.is_open())
+        // Device mips in one compute dispatch when the device and the format allow it, blitted otherwise
+        bool computeMips = false;
+        if (!blob && m_computeMips && MipDownsampler::supports({ (u32)rawImage.width, (u32)rawImage.height }, rawImage.mipLevels))
+        {
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(m_physicalDevice, ImageAttachment::storageFormat(format), &formatProperties);
+            computeMips = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+        }
+
+        if (blob && !KTX2Helper::read(blob, blobSize, _texture.m_header))
+            throw std::runtime_error("Unsupported texture: " + _texture.m_path);
+        if (STREAM_TEXTURES && blob && cookedBlob.empty())
+        {
+            _texture.m_blob = blob;
+            _texture.m_blobSize = blobSize;
+        }
+        else if (STREAM_TEXTURES && blob)
+            mapTextureCache(_texture, blob, blobSize); // the whole chain is uploaded when it fails
+        auto decodedTime = std::chrono::high_resolution_clock::now();
+
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
+        auto uploadStartTime = std::chrono::high_resolution_clock::now();
+        if (blob)
+        {
+            if (_texture.m_blob)
             {
-                size_t vbSize = sizeof(Vertex) * model.m_mesh.m_vertices.size();
-                size_t ibSize = sizeof(u32) * model.m_mesh.m_indices.size();
-
-                writeVBCache.write((char*)model.m_mesh.m_vertices.data(), vbSize);
-                writeIBCache.write((char*)model.m_mesh.m_indices.data(), ibSize);
-    
-                writeVBCache.close();
-                writeIBCache.close();
+                _texture.m_residentMip = textureTailMip(_texture.header(), TEXTURE_TAIL_SIZE);
+                _texture.m_requestedMip = _texture.m_residentMip;
             }
-            cout << "\t << WriteCache \n";
+            _texture.m_image.loadImageFromArchive(m_logicalDevice, m_physicalDevice, _texture.header(), blob, m_graphicsCommandPool, m_graphicsQueue, _texture.m_residentMip);
+        }
+        else
+        {
+            if (computeMips)
+                _texture.m_image.m_usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+            _texture.m_image.loadImageFromRaw(m_logicalDevice, m_physicalDevice, rawImage, m_msaaSamples, m_graphicsCommandPool, m_graphicsQueue, format);
+            FileHelper::unloadImage(rawImage);
+            if (computeMips)
+                generateMipmaps(_texture.m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
         }
 
+        float decodeTime = std::chrono::duration<float, std::chrono::milliseconds::period>(decodedTime - startTime).count();
+        float uploadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - uploadStartTime).count();
+        float waitTime = std::chrono::duration<float, std::chrono::milliseconds::period>(uploadStartTime - decodedTime).count();
+        cout << "\t\t " << _texture.m_path << (cooked ? " cooked" : _texture.m_file.data() && !ktx2 ? " from its texture cache" : " decoded in " + std::to_string(decodeTime) + "ms") << ", uploaded in " << uploadTime << "ms (" << waitTime << "ms waiting for the queue)";
+        if (blob)
+            cout << ", format " << _texture.m_image.m_format << ", " << textureResidentBytes(_texture, _texture.m_residentMip) / (1024.0f * 1024.0f) << "MB";
+        if (_texture.m_blob)
+            cout << ", " << _texture.m_image.m_extent.width << "x" << _texture.m_image.m_extent.height << " mip tail";
+        cout << "\n";
+    }
 
+    bool Engine::mapTextureCache(TextureCache::Texture& _texture, const octet* _blob, u64 _blobSize)
+    {
+        u32 format = _texture.header().format;
+        std::string cachePath = TextureCache::cachePath(_texture.m_path, format);
+        // textures with the same source and format but other parameters share the file, the first one writes it
+        std::lock_guard<std::mutex> lock(m_textureCacheMutex);
+        if (openTextureCache(_texture, format))
+            return true;
+
+        octet prefix[TextureCache::CacheBlobAlignment] = {};
+        TextureCache::CacheHeader header{ TextureCache::CacheMagic, TextureCacheVersion, _texture.m_sourceHash, format, TextureCache::CacheBlobAlignment, _blobSize };
+        memcpy(prefix, &header, sizeof(header));
+        if (!FileHelper::writeFile(cachePath, prefix, sizeof(prefix), _blob, (size_t)_blobSize) || !openTextureCache(_texture, format))
+        {
+            cout << "\t\t Failed to write " << cachePath << ", " << _texture.m_path << " is not streamed\n";
+            return false;
+        }
+        return true;
+    }
 
-        static float instance_offset_HACK = 0.0f;
-        static bool doOffset = false;
-        if(doOffset)
+    bool Engine::openTextureCache(TextureCache::Texture& _texture, u32 _format)
+    {
+        MappedFile file;
+        try
+        {
+            file.map(TextureCache::cachePath(_texture.m_path, _format));
+        }
+        catch (const std::exception&)
+        {
+            return false; // no cache yet
+        }
+
+        const TextureCache::CacheHeader* header = (const TextureCache::CacheHeader*)file.data();
+        if (file.size() < sizeof(TextureCache::CacheHeader) || header->magic != TextureCache::CacheMagic || header->version != TextureCacheVersion
+            || header->sourceHash != _texture.m_sourceHash || header->format != _format || header->blobOffset + header->blobSize > file.size())
+            return false;
+
+        // moving the mapping keeps the blob pointer valid
+        u32 blobOffset = header->blobOffset;
+        u64 blobSize = header->blobSize;
+        _texture.m_file = std::move(file);
+        _texture.m_blob = _texture.m_file.data() + blobOffset;
+        _texture.m_blobSize = blobSize;
+        return true;
+    }
+
+    TextureHandle Engine::acquireTexture(const std::string& _filePath, const TextureParameters& _parameters)
+    {
+        return acquireTextures({ _filePath }, _parameters)[0];
+    }
+
+    std::vector<TextureHandle> Engine::acquireTextures(const std::vector<std::string>& _filePaths, const TextureParameters& _parameters)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        // Loaded textures take a reference, the others are loaded once even when listed twice
+        std::vector<TextureHandle> handles(_filePaths.size(), TextureCache::InvalidHandle);
+        std::vector<std::string> keys(_filePaths.size());
+        std::vector<TextureCache::Texture> loads;
+        for (size_t i = 0; i < _filePaths.size(); ++i)
         {
-            for (Vertex& v : model.m_mesh.m_vertices)
+            keys[i] = TextureCache::key(_filePaths[i], _parameters);
+            handles[i] = m_textureCache.acquire(keys[i]);
+            if (handles[i] != TextureCache::InvalidHandle)
             {
-                v.pos += glm::vec3(instance_offset_HACK, 0.0f, 0.0f);
+                cout << "\t\t " << _filePaths[i] << " shared, " << m_textureCache.get(handles[i]).m_refCount << " references\n";
+                continue;
             }
+            if (std::any_of(loads.begin(), loads.end(), [&](const TextureCache::Texture& _load) { return _load.m_key == keys[i]; }))
+                continue;
+
+            TextureCache::Texture& texture = loads.emplace_back();
+            texture.m_key = keys[i];
+            texture.m_path = _filePaths[i];
+            texture.m_parameters = _parameters;
+            texture.m_image = ImageAttachment::colorAttachment();
         }
-        doOffset = true;
-        instance_offset_HACK += 50.0f;
+        if (loads.empty())
+            return handles;
 
-        
-        cout << "\t Load textures >> \n";
-        model.m_material.m_type = Model::Material::MaterialType::TextureBased;
+        m_jobSystem.parallelFor((u32)loads.size(), [&](u32 _load) {
+            loadTexture(loads[_load]);
+        });
 
-        //string diffuse = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_8K_Albedo.jpg";
-        //string normal = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_8K_Normal_LOD0.jpg";
-        //string specular = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_8K_Specular.jpg";
-        //string glossiness = "Resources/Models/Nature_Rock_Cliff_xgnlfc0_8K_3d_ms/xgnlfc0_8K_Roughness.jpg";
-        string diffuse = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw_8K_Diffuse.jpg";
-        string normal = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw_8K_Normal.jpg";
-        string specular = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw_8K_Metalness.jpg";
-        string glossiness = "Resources/Models/war_hammer_axe/War_Hammer_Axe_uh1pbcufa_Raw_8K_Roughness.jpg";
+        VkSampler sampler = getTextureSampler(_parameters);
+        for (TextureCache::Texture& texture : loads)
+        {
+            texture.m_sampler = sampler;
+            m_textureCache.add(std::move(texture));
+        }
+        // the first request of a key takes the reference of add, duplicates take one more
+        std::vector<bool> added(m_textureCache.m_textures.size(), false);
+        for (size_t i = 0; i < _filePaths.size(); ++i)
+        {
+            if (handles[i] != TextureCache::InvalidHandle)
+                continue;
+            TextureHandle handle = m_textureCache.m_handles[keys[i]];
+            if (added[handle])
+                m_textureCache.acquire(keys[i]);
+            added[handle] = true;
+            handles[i] = handle;
+        }
 
-        ImageAttachment diffuseMap = ImageAttachment::colorAttachment();
-        diffuseMap.loadImageFromFile(m_logicalDevice, m_physicalDevice, diffuse, m_msaaSamples, m_graphicsCommandPool, m_graphicsQueue);
-        model.m_material.m_textures.push_back(diffuseMap);
+        float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+        cout << "\t\t " << loads.size() << " textures loaded in " << loadTime << "ms\n";
+        return handles;
+    }
 
-        ImageAttachment normalMap = ImageAttachment::colorAttachment();
-        normalMap.loadImageFromFile(m_logicalDevice, m_physicalDevice, normal, m_msaaSamples, m_graphicsCommandPool, m_graphicsQueue);
-        model.m_material.m_textures.push_back(normalMap);
+    void Engine::releaseTexture(TextureHandle _handle)
+    {
+        if (!m_textureCache.release(_handle))
+            return;
+        if (m_textureUpload.m_texture == _handle)
+            destroyTextureUpload();
+        m_textureCache.get(_handle).m_image.destroyImageAttachment(m_logicalDevice);
+        m_textureCache.get(_handle) = TextureCache::Texture{}; // unmaps its mip chain
+    }
 
-        ImageAttachment specularMap = ImageAttachment::colorAttachment();
-        specularMap.loadImageFromFile(m_logicalDevice, m_physicalDevice, specular, m_msaaSamples, m_graphicsCommandPool, m_graphicsQueue);
-        model.m_material.m_textures.push_back(specularMap);
+    VkSampler Engine::getTextureSampler(const TextureParameters& _parameters)
+    {
+        for (const auto& [parameters, sampler] : m_textureCache.m_samplers)
+        {
+            if (parameters == _parameters)
+                return sampler;
+        }
 
-        ImageAttachment glossinessMap = ImageAttachment::colorAttachment();
-        glossinessMap.loadImageFromFile(m_logicalDevice, m_physicalDevice, glossiness, m_msaaSamples, m_graphicsCommandPool, m_graphicsQueue);
-        model.m_material.m_textures.push_back(glossinessMap);
-        cout << "\t << Load textures \n";
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = _parameters.m_filter;
+        samplerInfo.minFilter = _parameters.m_filter;
+        samplerInfo.addressModeU = _parameters.m_addressMode;
+        samplerInfo.addressModeV = _parameters.m_addressMode;
+        samplerInfo.addressModeW = _parameters.m_addressMode;
+        samplerInfo.anisotropyEnable = _parameters.m_maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+        samplerInfo.maxAnisotropy = _parameters.m_maxAnisotropy;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.mipmapMode = _parameters.m_filter == VK_FILTER_LINEAR ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // every mip level, whatever the texture
+        samplerInfo.mipLodBias = 0.0f;
 
+        VkSampler sampler;
+        VCR(vkCreateSampler(m_logicalDevice, &samplerInfo, nullptr, &sampler), "Failed to create sampler.")
+        m_textureCache.m_samplers.emplace_back(_parameters, sampler);
+        return sampler;
+    }
 
+    const AssetArchiveFormat::Entry* Engine::findCookedAsset(const std::string& _sourcePath, const std::string& _variant, AssetArchiveFormat::AssetType _type)
+    {
+        const AssetArchiveFormat::Entry* cooked = m_assetArchive.find(AssetArchive::assetName(_sourcePath, _variant));
+        if (!cooked || cooked->type != _type || cooked->processorVersion != AssetCooker::processorVersion(_type))
+            return nullptr;
 
-        _models.push_back(model);
-        cout << "<< Engine::loadModel\n";
+        // The archive is trusted as is, watched sources may have been edited since the last cook
+        if (m_watchAssets && std::filesystem::exists(_sourcePath) && cooked->sourceHash != FileHelper::hashFile(_sourcePath))
+        {
+            cout << "\t\t " << m_assetArchive.name(*cooked) << " is stale in the archive\n";
+            return nullptr;
+        }
+        return cooked;
     }
 
+#pragma region HotReload
+    void Engine::startAssetWatch()
+    {
+        // Sources the loaded models depend on, the watch thread only reads this snapshot
+        for (const Model& model : m_models)
+        {
+            WatchedSource& mesh = m_watchedSources[AssetArchive::assetName(model.m_sourcePath)];
+            mesh.m_type = AssetArchiveFormat::Mesh;
+            if (std::find(mesh.m_vertexFormats.begin(), mesh.m_vertexFormats.end(), model.m_mesh.m_vertexFormat) == mesh.m_vertexFormats.end())
+                mesh.m_vertexFormats.push_back(model.m_mesh.m_vertexFormat);
+        }
+        for (const TextureCache::Texture& texture : m_textureCache.m_textures)
+        {
+            if (texture.m_refCount > 0)
+                m_watchedSources[AssetArchive::assetName(texture.m_path)].m_type = AssetArchiveFormat::Texture;
+        }
+
+        m_assetWatcher.start(ASSET_SOURCE_DIRECTORY);
+        m_stopHotReload = false;
+        m_hotReloadThread = std::thread(&Engine::watchAssets, this);
+        cout << "Hot reload: watching " << m_watchedSources.size() << " sources in " << ASSET_SOURCE_DIRECTORY << "\n";
+    }
+    void Engine::stopAssetWatch()
+    {
+        if (!m_hotReloadThread.joinable())
+            return;
+
+        m_stopHotReload = true;
+        m_hotReloadThread.join();
+        m_assetWatcher.stop();
+        m_hotReloads.clear();
+    }
+    void Engine::watchAssets()
+    {
+        while (!m_stopHotReload)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            for (const string& path : m_assetWatcher.poll())
+            {
+                auto watched = m_watchedSources.find(AssetArchive::assetName(path));
+                if (watched == m_watchedSources.end())
+                    continue;
+
+                HotReload reload;
+                reload.m_sourcePath = watched->first;
+                reload.m_type = watched->second.m_type;
+                reload.m_vertexFormats = watched->second.m_vertexFormats;
+                auto startTime = std::chrono::high_resolution_clock::now();
+                try
+                {
+                    // saved without any change
+                    reload.m_sourceHash = FileHelper::hashFile(path);
+                    if (reload.m_sourceHash == watched->second.m_sourceHash)
+                        continue;
+
+                    // Cooked like NyteCook does, only the vertex formats in use
+                    if (reload.m_type == AssetArchiveFormat::Mesh)
+                    {
+                        AssetCooker::cookMesh(path, reload.m_sourceHash, reload.m_vertexFormats, &m_jobSystem, reload.m_blobs);
+                        // the archive entry is stale now, the next launch reads the mesh cache instead of importing again
+                        for (size_t f = 0; f < reload.m_vertexFormats.size(); ++f)
+                            MeshCache::writeImage(MeshCache::getCachePath(path, MeshBuilder::variant(reload.m_vertexFormats[f])), reload.m_blobs[f]);
+                    }
+                    else
+                    {
+                        // not block compressed, the edit shows up in a blink
+                        reload.m_blobs.resize(1);
+                        AssetCooker::cookTexture(path, AssetCooker::textureFormat(path, false), &m_jobSystem, reload.m_blobs[0]);
+                    }
+                }
+                catch (const std::exception& _exception)
+                {
+                    // an exporter may still be writing, the next change tries again
+                    cout << "\t\t Hot reload of " << path << " failed: " << _exception.what() << "\n";
+                    continue;
+                }
+                watched->second.m_sourceHash = reload.m_sourceHash;
+                float cookTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+                cout << "\t\t Cooked " << path << " for hot reload in " << cookTime << "ms\n";
+
+                std::lock_guard<std::mutex> lock(m_hotReloadMutex);
+                m_hotReloads.push_back(std::move(reload));
+            }
+        }
+    }
+    void Engine::updateHotReload()
+    {
+        std::vector<HotReload> reloads;
+        {
+            std::lock_guard<std::mutex> lock(m_hotReloadMutex);
+            reloads.swap(m_hotReloads);
+        }
+        if (reloads.empty())
+            return;
+
+        // Only the reloaded buffers, images and the gbuffer commands are rebuilt, swapchain, attachments and pipelines stay.
+        // The device is drained first so no frame in flight still reads the previous resources,
+        // a reload is an editing action and the stall is cheaper than deferring every destruction.
+        auto startTime = std::chrono::high_resolution_clock::now();
+        vkDeviceWaitIdle(m_logicalDevice);
+        destroyTextureUpload(); // it may target a reloaded texture, the next frame starts it again
+
+        for (const HotReload& reload : reloads)
+        {
+            if (reload.m_type == AssetArchiveFormat::Mesh)
+            {
+                for (Model& model : m_models)
+                {
+                    if (AssetArchive::assetName(model.m_sourcePath) != reload.m_sourcePath)
+                        continue;
+                    u32 blob = (u32)(std::find(reload.m_vertexFormats.begin(), reload.m_vertexFormats.end(), model.m_mesh.m_vertexFormat) - reload.m_vertexFormats.begin());
+                    reloadMesh(model, reload, blob);
+                }
+                continue;
+            }
+
+            // the texture caches of streamed ones are written again, a mapped file can't be replaced
+            for (TextureCache::Texture& texture : m_textureCache.m_textures)
+            {
+                if (texture.m_refCount == 0 || AssetArchive::assetName(texture.m_path) != reload.m_sourcePath || !texture.m_file.data())
+                    continue;
+                texture.m_file.unmap();
+            }
+
+            // shared textures are swapped once for every material using them
+            for (TextureCache::Texture& texture : m_textureCache.m_textures)
+            {
+                if (texture.m_refCount == 0 || AssetArchive::assetName(texture.m_path) != reload.m_sourcePath)
+                    continue;
+                AssetArchiveFormat::TextureHeader header;
+                if (!KTX2Helper::read((const octet*)reload.m_blobs[0].data(), reload.m_blobs[0].size(), header))
+                    continue;
+                texture.m_image.destroyImageAttachment(m_logicalDevice);
+                texture.m_image = ImageAttachment::colorAttachment();
+                if (!texture.m_blob)
+                {
+                    texture.m_image.loadImageFromArchive(m_logicalDevice, m_physicalDevice, header, (const octet*)reload.m_blobs[0].data(), m_graphicsCommandPool, m_graphicsQueue);
+                    continue;
+                }
+
+                // streamed: back to the mip tail of the new chain, the finer levels stream in again
+                texture.m_header = header;
+                texture.m_blob = nullptr;
+                texture.m_sourceHash = reload.m_sourceHash;
+                texture.m_residentMip = 0;
+                if (mapTextureCache(texture, (const octet*)reload.m_blobs[0].data(), reload.m_blobs[0].size()))
+                {
+                    texture.m_residentMip = textureTailMip(texture.header(), TEXTURE_TAIL_SIZE);
+                    texture.m_requestedMip = texture.m_residentMip;
+                }
+                texture.m_image.loadImageFromArchive(m_logicalDevice, m_physicalDevice, header, (const octet*)reload.m_blobs[0].data(), m_graphicsCommandPool, m_graphicsQueue, texture.m_residentMip);
+            }
+        }
+
+        // the texture descriptors are written while recording
+        m_gbuffer.m_cmdBuffers.freeCommands(m_logicalDevice, m_graphicsCommandPool);
+        m_gbuffer.m_cmdBuffers.allocateCommands(m_logicalDevice, m_graphicsCommandPool, (u32)m_swapchainImages.size());
+        recordOffscreenCommandBuffers();
+
+        float reloadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+        cout << "Hot reload: " << reloads.size() << " sources swapped in " << reloadTime << "ms\n";
+    }
+    void Engine::reloadMesh(Model& _model, const HotReload& _reload, u32 _blob)
+    {
+        destroyDrawCommands(_model);
+        destroyInstanceBuffers(_model);
+        destroyMeshletBuffer(_model);
+        destroyIndexBuffer(_model);
+        destroyVertexBuffer(_model);
+
+        // everything derived from the previous geometry goes, the model keeps its vertex format and instance offset
+        VertexFormat vertexFormat = _model.m_mesh.m_vertexFormat;
+        _model.m_mesh = Model::Mesh{};
+        _model.m_mesh.m_vertexFormat = vertexFormat;
+
+        loadMesh(_model, &_reload, _blob);
+        createDrawCommands(_model);
+    }
+#pragma endregion HotReload
+
     u32 Engine::findMemoryType(u32 _typeFilter, VkMemoryPropertyFlags _properties)
     {
         VkPhysicalDeviceMemoryProperties memProperties;
@@ -2330,86 +3165,127 @@ namespace Nyte
 
         throw std::runtime_error("No memory type fit the given buffer.");
     }
-    void Engine::createVertexBuffer(Model& _model)
+    void Engine::createDeviceLocalBuffer(
+        VkDeviceSize _size,
+        VkBufferUsageFlags _usage,
+        const std::function<void(void*)>& _fillStaging,
+        VkBuffer& _buffer,
+        VkDeviceMemory& _bufferDeviceMemory)
     {
-        VkDeviceSize vertexBufferSize = sizeof(Vertex) * _model.m_mesh.m_vertices.size();
-
         // Create a staging buffer
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingBufferDeviceMemory;
         createBuffer(
-            vertexBufferSize,
+            _size,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // VK_MEMORY_PROPERTY_HOST_COHERENT_BIT: ensure coherence between buffer memory and RAM
             stagingBuffer,
             stagingBufferDeviceMemory);
 
-        // Map vertices to the staging buffer
+        // The caller writes its data straight into the mapped staging buffer
         void* data;
-        vkMapMemory(m_logicalDevice, stagingBufferDeviceMemory, 0, vertexBufferSize, 0, &data);
-        memcpy(data, _model.m_mesh.m_vertices.data(), (size_t)vertexBufferSize);
+        vkMapMemory(m_logicalDevice, stagingBufferDeviceMemory, 0, _size, 0, &data);
+        _fillStaging(data);
         vkUnmapMemory(m_logicalDevice, stagingBufferDeviceMemory);
 
-        // Create the vertex buffer (GPU only)
+        // Create the device buffer (GPU only)
         u32 queueIndices[] = { m_queueFamilyIndices.transferFamily.value(), m_queueFamilyIndices.graphicsFamily.value() };
         createConcurrentBuffer( // used by graphic queue and transfer queue (therefore shared by several queues)
-            vertexBufferSize,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            _size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | _usage,
             2,
             &queueIndices[0],
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // GPU only buffer
-            _model.m_mesh.m_vertexBuffer,
-            _model.m_mesh.m_vertexBufferDeviceMemory);
+            _buffer,
+            _bufferDeviceMemory);
 
-        // Copy staging to vertex buffer (one shot)
-        copyBuffer(stagingBuffer, _model.m_mesh.m_vertexBuffer, vertexBufferSize);
+        // Copy staging to device buffer (one shot)
+        copyBuffer(stagingBuffer, _buffer, _size);
 
         vkDestroyBuffer(m_logicalDevice, stagingBuffer, nullptr);
         vkFreeMemory(m_logicalDevice, stagingBufferDeviceMemory, nullptr);
     }
+    void Engine::createVertexBuffer(Model& _model, VkDeviceSize _size, const std::function<void(void*)>& _fillStaging)
+    {
+        createDeviceLocalBuffer(_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, _fillStaging, _model.m_mesh.m_vertexBuffer, _model.m_mesh.m_vertexBufferDeviceMemory);
+    }
     void Engine::destroyVertexBuffer(Model& _model)
     {
         vkDestroyBuffer(m_logicalDevice, _model.m_mesh.m_vertexBuffer, nullptr);
         vkFreeMemory(m_logicalDevice, _model.m_mesh.m_vertexBufferDeviceMemory, nullptr);
     }
-    void Engine::createIndexBuffer(Model& _model)
+    void Engine::createIndexBuffer(Model& _model, VkDeviceSize _size, const std::function<void(void*)>& _fillStaging)
     {
-        VkDeviceSize indexBufferSize = sizeof(_model.m_mesh.m_indices[0]) * _model.m_mesh.m_indices.size();
-
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(
-            indexBufferSize,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer,
-            stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(m_logicalDevice, stagingBufferMemory, 0, indexBufferSize, 0, &data);
-        memcpy(data, _model.m_mesh.m_indices.data(), (size_t)indexBufferSize);
-        vkUnmapMemory(m_logicalDevice, stagingBufferMemory);
-
-        u32 queueIndices[] = { m_queueFamilyIndices.transferFamily.value(), m_queueFamilyIndices.graphicsFamily.value() };
-        createConcurrentBuffer(
-            indexBufferSize,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            2,
-            &queueIndices[0],
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            _model.m_mesh.m_indexBuffer,
-            _model.m_mesh.m_indexBufferDeviceMemory);
-
-        copyBuffer(stagingBuffer, _model.m_mesh.m_indexBuffer, indexBufferSize);
-
-        vkDestroyBuffer(m_logicalDevice, stagingBuffer, nullptr);
-        vkFreeMemory(m_logicalDevice, stagingBufferMemory, nullptr);
+        createDeviceLocalBuffer(_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, _fillStaging, _model.m_mesh.m_indexBuffer, _model.m_mesh.m_indexBufferDeviceMemory);
     }
     void Engine::destroyIndexBuffer(Model& _model)
     {
         vkDestroyBuffer(m_logicalDevice, _model.m_mesh.m_indexBuffer, nullptr);
         vkFreeMemory(m_logicalDevice, _model.m_mesh.m_indexBufferDeviceMemory, nullptr);
     }
+    void Engine::createMeshletBuffer(Model& _model, VkDeviceSize _size, const std::function<void(void*)>& _fillStaging)
+    {
+        createDeviceLocalBuffer(_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, _fillStaging, _model.m_mesh.m_meshletBuffer, _model.m_mesh.m_meshletBufferDeviceMemory);
+    }
+    void Engine::destroyMeshletBuffer(Model& _model)
+    {
+        vkDestroyBuffer(m_logicalDevice, _model.m_mesh.m_meshletBuffer, nullptr);
+        vkFreeMemory(m_logicalDevice, _model.m_mesh.m_meshletBufferDeviceMemory, nullptr);
+    }
+    void Engine::createInstanceBuffers(Model& _model, const MeshCacheFormat::Instance* _instances)
+    {
+        // buffers are never empty, an empty mesh still binds them
+        // The normal matrix and the winding of each placement are computed once here rather than per vertex
+        const glm::vec3 offset = _model.m_instanceOffset;
+        _model.m_mesh.m_mirroredInstanceCount = 0;
+        VkDeviceSize instanceBufferSize = sizeof(InstanceTransform) * (VkDeviceSize)std::max(_model.m_mesh.m_instanceCount, 1u);
+        createDeviceLocalBuffer(instanceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, [&](void* _staging) {
+            InstanceTransform* instances = (InstanceTransform*)_staging;
+            for (u32 i = 0; i < _model.m_mesh.m_instanceCount; ++i)
+            {
+                glm::mat3 direction = glm::mat3(instanceTransform(_instances[i], offset));
+                float determinant = glm::determinant(direction);
+                glm::mat3 normalMatrix = determinant != 0.0f ? glm::transpose(glm::inverse(direction)) : direction;
+                for (u32 r = 0; r < 3; ++r)
+                {
+                    for (u32 c = 0; c < 4; ++c)
+                        instances[i].rows[r][c] = _instances[i].rows[r][c];
+                    instances[i].rows[r][3] += offset[r];
+                    for (u32 c = 0; c < 3; ++c)
+                        instances[i].normalRows[r][c] = normalMatrix[c][r];
+                    instances[i].normalRows[r][3] = 0.0f;
+                }
+                instances[i].normalRows[0][3] = determinant < 0.0f ? -1.0f : 1.0f;
+                if (determinant < 0.0f)
+                    ++_model.m_mesh.m_mirroredInstanceCount;
+            }
+        }, _model.m_mesh.m_instanceBuffer, _model.m_mesh.m_instanceBufferDeviceMemory);
+
+        // Every meshlet gets one visible instance slot per instance of its submesh, the culling compacts the visible ones in there
+        std::vector<SubMeshInstances> subMeshInstances;
+        u32 slotCount = 0;
+        for (const Model::SubMesh& subMesh : _model.m_mesh.m_subMeshes)
+        {
+            SubMeshInstances instances{ subMesh.m_sphere, subMesh.m_firstInstance, subMesh.m_instanceCount, subMesh.m_firstMeshlet, slotCount, (u32)subMesh.m_lods.size() };
+            for (u32 l = 0; l < instances.lodCount; ++l)
+                instances.lodErrors[l] = subMesh.m_lods[l].m_error;
+            subMeshInstances.push_back(instances);
+            slotCount += subMesh.m_meshletCount * subMesh.m_instanceCount;
+        }
+        _model.m_mesh.m_instanceSlotCount = slotCount;
+
+        VkDeviceSize subMeshInstanceBufferSize = sizeof(SubMeshInstances) * (VkDeviceSize)std::max((u32)subMeshInstances.size(), 1u);
+        createDeviceLocalBuffer(subMeshInstanceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, [&](void* _staging) {
+            memcpy(_staging, subMeshInstances.data(), sizeof(SubMeshInstances) * subMeshInstances.size());
+        }, _model.m_mesh.m_subMeshInstanceBuffer, _model.m_mesh.m_subMeshInstanceBufferDeviceMemory);
+    }
+    void Engine::destroyInstanceBuffers(Model& _model)
+    {
+        vkDestroyBuffer(m_logicalDevice, _model.m_mesh.m_instanceBuffer, nullptr);
+        vkFreeMemory(m_logicalDevice, _model.m_mesh.m_instanceBufferDeviceMemory, nullptr);
+        vkDestroyBuffer(m_logicalDevice, _model.m_mesh.m_subMeshInstanceBuffer, nullptr);
+        vkFreeMemory(m_logicalDevice, _model.m_mesh.m_subMeshInstanceBufferDeviceMemory, nullptr);
+    }
 
     void Engine::createUniformBuffers()
     {
@@ -2691,6 +3567,17 @@ namespace Nyte
         memcpy(data, &ubo_MVP, sizeof(ubo_MVP));
         vkUnmapMemory(m_logicalDevice, m_uniformBuffersDeviceMemory[_currentImage]);
 
+        // every drawn model asks again for the levels of its textures
+        for (TextureCache::Texture& texture : m_textureCache.m_textures)
+        {
+            if (!texture.m_blob)
+                continue;
+            texture.m_requestedMip = textureTailMip(texture.header(), TEXTURE_TAIL_SIZE);
+            texture.m_projectedSize = 0.0f;
+        }
+        for (Model& model : m_models)
+            requestTextureMips(model, ubo_MVP.model, cameraPos, glm::radians(45.0f));
+
 
 
         UBO_Deffered ubo_Def{};
@@ -2706,4 +3593,218 @@ namespace Nyte
         vkUnmapMemory(m_logicalDevice, m_deferred.m_uniformBuffers.m_uniformBuffersDeviceMemory[_currentImage]);
     }
 
+    float Engine::projectedPixelsPerUnit(const Model& _model, const glm::mat4& _modelMatrix, const glm::vec3& _cameraPos, float _fovY, float& _scale) const
+    {
+        _scale = std::max(glm::length(glm::vec3(_modelMatrix[0])), std::max(glm::length(glm::vec3(_modelMatrix[1])), glm::length(glm::vec3(_modelMatrix[2]))));
+        glm::vec3 center = glm::vec3(_modelMatrix * glm::vec4(_model.m_mesh.m_boundsCenter, 1.0f));
+        float distance = std::max(glm::length(center - _cameraPos) - _model.m_mesh.m_boundsRadius * _scale, 0.1f);
+        return m_swapchainExtent.height / (2.0f * distance * tanf(_fovY * 0.5f));
+    }
+
+#pragma region TextureStreaming
+    void Engine::requestTextureMips(const Model& _model, const glm::mat4& _modelMatrix, const glm::vec3& _cameraPos, float _fovY)
+    {
+        // A texture mapped once over the model needs about one texel per pixel of its projected diameter
+        float scale;
+        float pixelsPerUnit = projectedPixelsPerUnit(_model, _modelMatrix, _cameraPos, _fovY, scale);
+        float projectedSize = 2.0f * _model.m_mesh.m_boundsRadius * scale * pixelsPerUnit;
+        for (TextureHandle handle : _model.m_material.m_textures)
+        {
+            TextureCache::Texture& texture = m_textureCache.get(handle);
+            if (!texture.m_blob)
+                continue;
+
+            // coarsest level still as large as the projected size
+            const AssetArchiveFormat::TextureHeader& header = texture.header();
+            u32 mip = 0;
+            while (mip + 1 < header.mipLevels && (float)std::max(header.mips[mip + 1].width, header.mips[mip + 1].height) >= projectedSize)
+                ++mip;
+            texture.m_requestedMip = std::min(texture.m_requestedMip, mip);
+            texture.m_projectedSize = std::max(texture.m_projectedSize, projectedSize);
+        }
+    }
+
+    void Engine::updateTextureStreaming(u32 _imageIndex)
+    {
+        // Finished resize, frames in flight may still sample the previous image: it is retired behind their fences
+        if (m_textureUpload.m_fence != VK_NULL_HANDLE && vkGetFenceStatus(m_logicalDevice, m_textureUpload.m_fence) == VK_SUCCESS)
+        {
+            TextureCache::Texture& texture = m_textureCache.get(m_textureUpload.m_texture);
+            bool evicted = m_textureUpload.m_mip > texture.m_residentMip;
+            m_retiredImages.push_back({ texture.m_image, m_inFlightFences });
+            texture.m_image = m_textureUpload.m_image;
+            texture.m_residentMip = m_textureUpload.m_mip;
+            m_textureUpload.m_texture = TextureCache::InvalidHandle; // the image is the texture one now
+            destroyTextureUpload();
+            cout << "\t\t " << texture.m_path << (evicted ? " evicted down to " : " streamed in to ") << texture.m_image.m_extent.width << "x" << texture.m_image.m_extent.height << "\n";
+
+            // the texture descriptors are written while recording, each image records again once its previous frame is done
+            m_staleOffscreenCommands.assign(m_staleOffscreenCommands.size(), true);
+        }
+        releaseRetiredImages();
+
+        u64 residentBytes = 0;
+        for (const TextureCache::Texture& texture : m_textureCache.m_textures)
+        {
+            if (texture.m_refCount > 0 && texture.m_blob)
+                residentBytes += textureResidentBytes(texture, texture.m_residentMip);
+        }
+
+        // Over the budget, the levels no model needs go first, from the smallest texture on screen
+        if (m_textureUpload.m_fence == VK_NULL_HANDLE && residentBytes > TEXTURE_BUDGET_BYTES)
+        {
+            TextureHandle evicted = TextureCache::InvalidHandle;
+            for (TextureHandle handle = 0; handle < (TextureHandle)m_textureCache.m_textures.size(); ++handle)
+            {
+                const TextureCache::Texture& texture = m_textureCache.m_textures[handle];
+                if (texture.m_refCount == 0 || !texture.m_blob || texture.m_residentMip >= texture.m_requestedMip)
+                    continue;
+                if (evicted == TextureCache::InvalidHandle || texture.m_projectedSize < m_textureCache.m_textures[evicted].m_projectedSize)
+                    evicted = handle;
+            }
+            if (evicted != TextureCache::InvalidHandle)
+                startTextureResize(evicted, m_textureCache.get(evicted).m_requestedMip);
+        }
+
+        // Next level: the texture missing the most levels, then the largest on screen
+        TextureHandle next = TextureCache::InvalidHandle;
+        for (TextureHandle handle = 0; handle < (TextureHandle)m_textureCache.m_textures.size() && m_textureUpload.m_fence == VK_NULL_HANDLE; ++handle)
+        {
+            const TextureCache::Texture& texture = m_textureCache.m_textures[handle];
+            if (texture.m_refCount == 0 || !texture.m_blob || texture.m_residentMip <= texture.m_requestedMip)
+                continue;
+            if (next != TextureCache::InvalidHandle)
+            {
+                const TextureCache::Texture& best = m_textureCache.m_textures[next];
+                u32 missing = texture.m_residentMip - texture.m_requestedMip;
+                u32 bestMissing = best.m_residentMip - best.m_requestedMip;
+                if (missing < bestMissing || (missing == bestMissing && texture.m_projectedSize <= best.m_projectedSize))
+                    continue;
+            }
+            next = handle;
+        }
+        if (next != TextureCache::InvalidHandle)
+        {
+            const TextureCache::Texture& texture = m_textureCache.get(next);
+            if (residentBytes + texture.header().mips[texture.m_residentMip - 1].size <= TEXTURE_BUDGET_BYTES)
+                startTextureResize(next, texture.m_residentMip - 1);
+        }
+
+        // The fence of this image was waited for, nothing in flight reads its descriptor set.
+        // Updating the set invalidates its recorded commands, so they are recorded again with it.
+        if (m_staleOffscreenCommands[_imageIndex])
+            recordOffscreenCommandBuffer(_imageIndex);
+    }
+
+    void Engine::startTextureResize(TextureHandle _handle, u32 _mip)
+    {
+        const TextureCache::Texture& texture = m_textureCache.get(_handle);
+        m_textureUpload.m_texture = _handle;
+        m_textureUpload.m_mip = _mip;
+
+        // a finer level comes from the blob, coarser ones are all on the GPU already
+        if (_mip < texture.m_residentMip)
+        {
+            const AssetArchiveFormat::Mip& mip = texture.header().mips[_mip];
+            m_textureUpload.m_stagingBuffer.m_size = (VkDeviceSize)mip.size;
+            m_textureUpload.m_stagingBuffer.m_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            m_textureUpload.m_stagingBuffer.m_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            m_textureUpload.m_stagingBuffer.createBuffer(m_logicalDevice, m_physicalDevice);
+            void* data;
+            vkMapMemory(m_logicalDevice, m_textureUpload.m_stagingBuffer.m_bufferDeviceMemory, 0, (VkDeviceSize)mip.size, 0, &data);
+            memcpy(data, texture.m_blob + mip.offset, (size_t)mip.size);
+            vkUnmapMemory(m_logicalDevice, m_textureUpload.m_stagingBuffer.m_bufferDeviceMemory);
+        }
+
+        m_textureUpload.m_commandBuffer = VulkanHelper::beginSingleTimeCommands(m_logicalDevice, m_graphicsCommandPool);
+        m_textureUpload.m_image = recordTextureResize(m_textureUpload.m_commandBuffer, texture, _mip, _mip < texture.m_residentMip ? &m_textureUpload.m_stagingBuffer : nullptr);
+        vkEndCommandBuffer(m_textureUpload.m_commandBuffer);
+
+        // not waited for, swapped in by a later frame
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VCR(vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &m_textureUpload.m_fence), "Failed to create texture upload fence.");
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_textureUpload.m_commandBuffer;
+        VCR(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_textureUpload.m_fence), "Failed to submit texture upload.");
+    }
+
+    void Engine::releaseRetiredImages()
+    {
+        // an in flight fence that signaled is done with every frame it was submitted with up to now
+        for (RetiredImage& retired : m_retiredImages)
+        {
+            retired.m_fences.erase(std::remove_if(retired.m_fences.begin(), retired.m_fences.end(),
+                [&](VkFence _fence) { return vkGetFenceStatus(m_logicalDevice, _fence) == VK_SUCCESS; }), retired.m_fences.end());
+            if (retired.m_fences.empty())
+                retired.m_image.destroyImageAttachment(m_logicalDevice);
+        }
+        m_retiredImages.erase(std::remove_if(m_retiredImages.begin(), m_retiredImages.end(),
+            [](const RetiredImage& _retired) { return _retired.m_fences.empty(); }), m_retiredImages.end());
+    }
+
+    ImageAttachment Engine::recordTextureResize(VkCommandBuffer _commandBuffer, const TextureCache::Texture& _texture, u32 _mip, const Buffer* _stagingBuffer)
+    {
+        const AssetArchiveFormat::TextureHeader& header = _texture.header();
+        ImageAttachment image = ImageAttachment::colorAttachment();
+        image.m_format = _texture.m_image.m_format;
+        image.m_components = _texture.m_image.m_components;
+        image.m_extent = { header.mips[_mip].width, header.mips[_mip].height };
+        image.m_mipLevels = header.mipLevels - _mip;
+        image.m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+        image.m_usage = _texture.m_image.m_usage;
+        image.createImageAttachment(m_logicalDevice, m_physicalDevice);
+
+        const ImageAttachment& resident = _texture.m_image;
+        recordImageBarrier(_commandBuffer, image.m_image, image.m_mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        recordImageBarrier(_commandBuffer, resident.m_image, resident.m_mipLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        // levels both images hold
+        std::vector<VkImageCopy> copies;
+        for (u32 level = std::max(_mip, _texture.m_residentMip); level < header.mipLevels; ++level)
+        {
+            VkImageCopy copy{};
+            copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - _texture.m_residentMip, 0, 1 };
+            copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - _mip, 0, 1 };
+            copy.extent = { header.mips[level].width, header.mips[level].height, 1 };
+            copies.push_back(copy);
+        }
+        vkCmdCopyImage(_commandBuffer, resident.m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (u32)copies.size(), copies.data());
+
+        // the new finest level
+        if (_stagingBuffer)
+        {
+            VkBufferImageCopy region{};
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            region.imageExtent = { header.mips[_mip].width, header.mips[_mip].height, 1 };
+            vkCmdCopyBufferToImage(_commandBuffer, _stagingBuffer->m_buffer, image.m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+
+        recordImageBarrier(_commandBuffer, resident.m_image, resident.m_mipLevels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        recordImageBarrier(_commandBuffer, image.m_image, image.m_mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        return image;
+    }
+
+    void Engine::destroyTextureUpload()
+    {
+        if (m_textureUpload.m_fence == VK_NULL_HANDLE)
+            return;
+
+        vkWaitForFences(m_logicalDevice, 1, &m_textureUpload.m_fence, VK_TRUE, UINT64_MAX);
+        if (m_textureUpload.m_texture != TextureCache::InvalidHandle)
+            m_textureUpload.m_image.destroyImageAttachment(m_logicalDevice);
+        vkDestroyBuffer(m_logicalDevice, m_textureUpload.m_stagingBuffer.m_buffer, nullptr);
+        vkFreeMemory(m_logicalDevice, m_textureUpload.m_stagingBuffer.m_bufferDeviceMemory, nullptr);
+        vkFreeCommandBuffers(m_logicalDevice, m_graphicsCommandPool, 1, &m_textureUpload.m_commandBuffer);
+        vkDestroyFence(m_logicalDevice, m_textureUpload.m_fence, nullptr);
+        m_textureUpload = TextureUpload{};
+    }
+#pragma endregion TextureStreaming
+
 } // namespace Nyte
\ No newline at end of file
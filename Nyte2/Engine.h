@@ -7,6 +7,12 @@
 #include <chrono>
 #include <iostream>
 #include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <filesystem>
 
 // vulkan
 #include "vulkan/vulkan_core.h"
@@ -19,9 +25,16 @@
 #include "Common.h"
 #include "VertexModel.h"
 #include "FileHelper.h"
+#include "JobSystem.h"
+#include "AssetArchive.h"
+#include "MipGenerator.h"
+#include "MeshCache.h"
+#include "FileWatcher.h"
 
 const std::string MODEL_PATH = "Resources/Models/viking_room.obj";
 const std::string TEXTURE_PATH = "Resources/Textures/viking_room.png";
+const std::string ASSET_ARCHIVE_PATH = "Resources/Assets.nytepak"; // written by NyteCook, assets missing from it are imported from their sources
+const std::string ASSET_SOURCE_DIRECTORY = "Resources"; // watched for hot reload, see Engine::setWatchAssets
 
 
 // VCR for Vulkan Check Result
@@ -96,6 +109,50 @@ namespace Nyte
         alignas(16) glm::mat4 proj;
     };
 
+    struct alignas(16) PushConstants_Dequant // Packed vertex position dequantization, per submesh
+    {
+        alignas(16) glm::vec4 positionScale;
+        alignas(16) glm::vec4 positionOffset;
+    };
+
+    constexpr u32 ClusterCullGroupSize = 64; // local_size_x of cluster_cull.comp
+
+    struct alignas(16) PushConstants_Cull // Cluster culling dispatch
+    {
+        u32 meshletCount;
+        float viewportHeight; // pixels, the LOD error is projected with ubo_MVP.proj
+        float lodErrorPixels; // coarsest LOD whose projected error stays under this is drawn
+    };
+
+    constexpr u32 MipDownsampleGroupSize = 256; // local_size_x of mip_downsample.comp, 16x16 threads on a 64x64 tile
+
+    struct PushConstants_MipDownsample // Single pass mip chain dispatch
+    {
+        u32 width; // mip 0
+        u32 height;
+        u32 mipCount; // levels written after mip 0
+        u32 srgb;
+    };
+
+    struct alignas(16) SubMeshInstances // Instance range of a submesh for the cluster culling (std430, matches cluster_cull.comp)
+    {
+        glm::vec4 sphere; // bounds of its meshlets, xyz center, w radius. Each instance selects its LOD from it
+        u32 firstInstance;
+        u32 instanceCount;
+        u32 firstMeshlet;
+        u32 firstSlot; // visible instance slots of its first meshlet, instanceCount slots per meshlet
+        u32 lodCount;
+        float lodErrors[MeshCacheFormat::MaxLodCount]; // distance to LOD 0, in submesh geometry units
+    };
+    static_assert(sizeof(SubMeshInstances) == 64, "SubMeshInstances is read as std430 by cluster_cull.comp");
+
+    struct InstanceTransform // Uploaded placement of a mesh (std430, matches cluster_cull.comp and offscreen_gbuffer.glsl)
+    {
+        float rows[3][4]; // affine model transform, row major
+        float normalRows[3][4]; // inverse transpose of the 3x3 part, row major. w of the first row: determinant sign, < 0 for mirrored placements
+    };
+    static_assert(sizeof(InstanceTransform) == 96, "InstanceTransform is read as std430 by the shaders");
+
     struct alignas(16) UBO_Deffered // Uniform buffer object
     {
         alignas(16) glm::vec4 cameraPosition;
@@ -208,6 +265,8 @@ namespace Nyte
         }
     };
 
+    struct MipDownsampler;
+
     struct ImageAttachment
     {
         VkImage m_image;
@@ -222,7 +281,24 @@ namespace Nyte
         VkImageUsageFlags m_usage;
         VkImageAspectFlags m_aspectMask;
         VkClearValue m_clearValue;
+        VkComponentMapping m_components{}; // identity
 
+        // Single pass compute mips, see createMipDownsample
+        std::vector<VkImageView> m_mipViews; // mip 0 sampled, then a storage view a level
+        Buffer m_mipGlobalBuffer; // atomic counter and the mip 6 texel of every workgroup
+        VkDescriptorPool m_mipDescriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet m_mipDescriptorSet = VK_NULL_HANDLE;
+
+        // Format of the storage views, shaders can't store to sRGB
+        static VkFormat storageFormat(VkFormat _format)
+        {
+            switch (_format)
+            {
+            case VK_FORMAT_R8G8B8A8_SRGB: return VK_FORMAT_R8G8B8A8_UNORM;
+            case VK_FORMAT_B8G8R8A8_SRGB: return VK_FORMAT_B8G8R8A8_UNORM;
+            default: return _format;
+            }
+        }
 
         static ImageAttachment colorAttachment()
         {
@@ -259,6 +335,11 @@ namespace Nyte
             imageInfo.usage = m_usage;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // graphics queue exclusive
 
+            // Storage usage on sRGB: stored to through UNORM views, the sRGB format itself has no storage support
+            bool storageAlias = (m_usage & VK_IMAGE_USAGE_STORAGE_BIT) && storageFormat(m_format) != m_format;
+            if (storageAlias)
+                imageInfo.flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT_KHR;
+
             VCR(vkCreateImage(_device, &imageInfo, nullptr, &m_image), "Failed to create image.");
 
             // Allocate device memory
@@ -274,12 +355,17 @@ namespace Nyte
             // Bind image and device memory
             vkBindImageMemory(_device, m_image, m_imageDeviceMemory, 0);
 
+            VkImageViewUsageCreateInfoKHR viewUsage{};
+            viewUsage.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO_KHR;
+            viewUsage.usage = m_usage & ~VK_IMAGE_USAGE_STORAGE_BIT;
+
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.pNext = storageAlias ? &viewUsage : nullptr;
             viewInfo.image = m_image;
             viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
             viewInfo.format = m_format;
-            viewInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+            viewInfo.components = m_components;
             viewInfo.subresourceRange.aspectMask = m_aspectMask;
             viewInfo.subresourceRange.baseMipLevel = 0;
             viewInfo.subresourceRange.levelCount = m_mipLevels;
@@ -290,11 +376,20 @@ namespace Nyte
         }
         inline void destroyImageAttachment(VkDevice _device)
         {
+            if (!m_mipViews.empty())
+                destroyMipDownsample(_device);
             vkDestroyImageView(_device, m_imageView, nullptr);
             vkFreeMemory(_device, m_imageDeviceMemory, nullptr);
             vkDestroyImage(_device, m_image, nullptr);
         }
 
+        // Single pass compute mip chain (MipDownsampler), for images created with VK_IMAGE_USAGE_STORAGE_BIT and VK_IMAGE_USAGE_SAMPLED_BIT.
+        // Created once after the image, recorded whenever mip 0 changed.
+        inline void createMipDownsample(VkDevice _device, VkPhysicalDevice _physicalDevice, const MipDownsampler& _downsampler);
+        inline void destroyMipDownsample(VkDevice _device);
+        // Mip 0 is in _mip0Layout, every level ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        inline void recordMipDownsample(VkCommandBuffer _commandBuffer, const MipDownsampler& _downsampler, VkImageLayout _mip0Layout) const;
+
         inline VkAttachmentDescription getAttachmentDescription(VkImageLayout _layout)
         {
             VkAttachmentDescription attachmentDescription;
@@ -319,31 +414,61 @@ namespace Nyte
             return attachmentReference;
         }
 
-        inline void loadImageFromFile(VkDevice _device, VkPhysicalDevice _physicalDevice, std::string _filePath, VkSampleCountFlagBits _sampleCount, VkCommandPool _commandPool, VkQueue _queue)
+        // Decoded image (FileHelper::loadImage), _format is an 8 bit RGBA format, sRGB or not. The mip chain is blitted on the GPU,
+        // or built on the CPU (MipGenerator) when the format can't be filtered linearly. The pixels stay the caller's to unload.
+        // Storage images only get mip 0, left in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL for the caller's compute chain (Engine::generateMipmaps).
+        inline void loadImageFromRaw(VkDevice _device, VkPhysicalDevice _physicalDevice, const RawImage& _rawImage, VkSampleCountFlagBits _sampleCount, VkCommandPool _commandPool, VkQueue _queue, VkFormat _format = VK_FORMAT_R8G8B8A8_SRGB)
         {
-            // Load image from file
-            RawImage rawImage;
-            rawImage.path = _filePath;
-            FileHelper::loadImage(rawImage);
+            // Check image format support filtering
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(_physicalDevice, _format, &formatProperties);
+            bool computeMips = (m_usage & VK_IMAGE_USAGE_STORAGE_BIT) != 0;
+            bool blitMips = !computeMips && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+
+            // Mip 0 only when the chain is built on the GPU, every level otherwise
+            std::vector<VkBufferImageCopy> regions(blitMips || computeMips ? 1 : _rawImage.mipLevels);
+            VkDeviceSize stagingSize = 0;
+            for (u32 level = 0; level < (u32)regions.size(); ++level)
+            {
+                VkBufferImageCopy& region = regions[level];
+                region = {};
+                region.bufferOffset = stagingSize;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level;
+                region.imageSubresource.baseArrayLayer = 0;
+                region.imageSubresource.layerCount = 1;
+                region.imageOffset = { 0, 0, 0 };
+                region.imageExtent = { MipGenerator::mipSize((u32)_rawImage.width, level), MipGenerator::mipSize((u32)_rawImage.height, level), 1 };
+                stagingSize += (VkDeviceSize)region.imageExtent.width * region.imageExtent.height * 4;
+            }
 
             // Create a staging buffer for transfer
             Buffer stagingBuffer;
-            stagingBuffer.m_size = (VkDeviceSize)rawImage.size;
+            stagingBuffer.m_size = stagingSize;
             stagingBuffer.m_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
             stagingBuffer.m_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
             stagingBuffer.createBuffer(_device, _physicalDevice);
 
             void* data;
-            vkMapMemory(_device, stagingBuffer.m_bufferDeviceMemory, 0, (VkDeviceSize)rawImage.size, 0, &data);
-            memcpy(data, rawImage.data, (u32)rawImage.size);
+            vkMapMemory(_device, stagingBuffer.m_bufferDeviceMemory, 0, stagingSize, 0, &data);
+            if (blitMips || computeMips)
+                memcpy(data, _rawImage.data, (size_t)_rawImage.size);
+            else
+            {
+                // built in system memory, the staging memory may be write combined
+                std::vector<u8> chain((size_t)stagingSize);
+                std::vector<u8*> levels(regions.size());
+                for (u32 level = 0; level < (u32)regions.size(); ++level)
+                    levels[level] = chain.data() + regions[level].bufferOffset;
+                memcpy(chain.data(), _rawImage.data, (size_t)_rawImage.size);
+                MipGenerator::generate(levels.data(), (u32)_rawImage.width, (u32)_rawImage.height, (u32)levels.size(), _format == VK_FORMAT_R8G8B8A8_SRGB, MipGenerator::Box);
+                memcpy(data, chain.data(), chain.size());
+            }
             vkUnmapMemory(_device, stagingBuffer.m_bufferDeviceMemory);
 
-            // Unload image data
-            FileHelper::unloadImage(rawImage);
-
-            m_format = VK_FORMAT_R8G8B8A8_SRGB;
-            m_extent = { (u32)rawImage.width, (u32)rawImage.height };
-            m_mipLevels = rawImage.mipLevels;
+            m_format = _format;
+            m_extent = { (u32)_rawImage.width, (u32)_rawImage.height };
+            m_mipLevels = _rawImage.mipLevels;
             m_sampleCount = VK_SAMPLE_COUNT_1_BIT;// _sampleCount;
 
             // Add transfer to usage
@@ -382,29 +507,31 @@ namespace Nyte
             }
 
             // Copy staging to image
-            VkBufferImageCopy region{};
-            region.bufferOffset = 0;
-            region.bufferRowLength = 0;
-            region.bufferImageHeight = 0;
-            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            region.imageSubresource.mipLevel = 0;
-            region.imageSubresource.baseArrayLayer = 0;
-            region.imageSubresource.layerCount = 1;
-            region.imageOffset = { 0, 0, 0 };
-            region.imageExtent = { (u32)rawImage.width, (u32)rawImage.height, 1 };
-            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.m_buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-            // Generate mipmaps
-            {
-                // Check image format support filtering
-                VkFormatProperties formatProperties;
-                vkGetPhysicalDeviceFormatProperties(_physicalDevice, m_format, &formatProperties);
-
-                if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
-                {
-                    throw std::runtime_error("Image format does not support linear filtering.");
-                }
+            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.m_buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (u32)regions.size(), regions.data());
 
+            // Storage images: mip 0 stays in "transfer layout" for the caller's dispatch
+            if (!blitMips && !computeMips)
+            {
+                // Transition every level to "shader ready layout"
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = m_image;
+                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                barrier.subresourceRange.baseMipLevel = 0;
+                barrier.subresourceRange.levelCount = m_mipLevels;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount = 1;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            }
+            else if (blitMips)
+            {
+                // Generate mipmaps
                 VkImageMemoryBarrier barrier{};
                 barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
                 barrier.image = m_image;
@@ -415,8 +542,8 @@ namespace Nyte
                 barrier.subresourceRange.layerCount = 1;
                 barrier.subresourceRange.levelCount = 1;
 
-                i32 mipWidth = rawImage.width;
-                i32 mipHeight = rawImage.height;
+                i32 mipWidth = _rawImage.width;
+                i32 mipHeight = _rawImage.height;
 
                 for (uint32_t i = 1; i < m_mipLevels; i++)
                 {
@@ -517,7 +644,204 @@ namespace Nyte
             //}
 
             VulkanHelper::endSingleTimeCommands(_device, _commandPool, _queue, commandBuffer);
+
+            vkDestroyBuffer(_device, stagingBuffer.m_buffer, nullptr);
+            vkFreeMemory(_device, stagingBuffer.m_bufferDeviceMemory, nullptr);
+        }
+
+        // Cooked texture: every mip level is already in the blob (KTX2, levels read by KTX2Helper::read), one copy per level and no blit.
+        // Only the levels from _firstMip are uploaded, the image is then the size of that level (texture streaming).
+        inline void loadImageFromArchive(VkDevice _device, VkPhysicalDevice _physicalDevice, const AssetArchiveFormat::TextureHeader& _texture, const octet* _blob, VkCommandPool _commandPool, VkQueue _queue, u32 _firstMip = 0)
+        {
+            // The levels go as is in the staging buffer, KTX2 stores them from the smallest one so the uploaded ones are contiguous
+            u64 firstOffset = ~0ull;
+            u64 endOffset = 0;
+            for (u32 level = _firstMip; level < _texture.mipLevels; ++level)
+            {
+                firstOffset = std::min(firstOffset, _texture.mips[level].offset);
+                endOffset = std::max(endOffset, _texture.mips[level].offset + _texture.mips[level].size);
+            }
+            Buffer stagingBuffer;
+            stagingBuffer.m_size = (VkDeviceSize)(endOffset - firstOffset);
+            stagingBuffer.m_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            stagingBuffer.m_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            stagingBuffer.createBuffer(_device, _physicalDevice);
+
+            void* data;
+            vkMapMemory(_device, stagingBuffer.m_bufferDeviceMemory, 0, stagingBuffer.m_size, 0, &data);
+            memcpy(data, _blob + firstOffset, (size_t)stagingBuffer.m_size);
+            vkUnmapMemory(_device, stagingBuffer.m_bufferDeviceMemory);
+
+            m_format = (VkFormat)_texture.format;
+            m_extent = { _texture.mips[_firstMip].width, _texture.mips[_firstMip].height };
+            m_mipLevels = _texture.mipLevels - _firstMip;
+            m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+            // single channel textures read as gray like the RGBA8 they replace
+            if (m_format == VK_FORMAT_BC4_UNORM_BLOCK)
+                m_components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+
+            // never rendered to, block compressed formats can't be. Streaming copies the resident levels into the resized image.
+            m_usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            createImageAttachment(_device, _physicalDevice);
+
+            VkCommandBuffer commandBuffer = VulkanHelper::beginSingleTimeCommands(_device, _commandPool);
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = m_image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = m_mipLevels;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.srcAccessMask = VK_ACCESS_NONE;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            std::vector<VkBufferImageCopy> regions(m_mipLevels);
+            for (u32 i = 0; i < m_mipLevels; ++i)
+            {
+                const AssetArchiveFormat::Mip& mip = _texture.mips[_firstMip + i];
+                regions[i] = {};
+                regions[i].bufferOffset = mip.offset - firstOffset;
+                regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                regions[i].imageSubresource.mipLevel = i;
+                regions[i].imageSubresource.baseArrayLayer = 0;
+                regions[i].imageSubresource.layerCount = 1;
+                regions[i].imageExtent = { mip.width, mip.height, 1 };
+            }
+            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.m_buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (u32)regions.size(), regions.data());
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VulkanHelper::endSingleTimeCommands(_device, _commandPool, _queue, commandBuffer);
+
+            vkDestroyBuffer(_device, stagingBuffer.m_buffer, nullptr);
+            vkFreeMemory(_device, stagingBuffer.m_bufferDeviceMemory, nullptr);
+        }
+    };
+
+    // Format and sampling of a texture, the same source loaded with other parameters is another texture
+    struct TextureParameters
+    {
+        VkFormat m_format = VK_FORMAT_UNDEFINED; // of a decoded source, UNDEFINED for the one its usage asks for (AssetCooker::textureFormat). Cooked textures keep their cooked format.
+        VkFilter m_filter = VK_FILTER_LINEAR;
+        VkSamplerAddressMode m_addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        float m_maxAnisotropy = 16.0f;
+
+        bool operator==(const TextureParameters& _other) const = default;
+    };
+
+    using TextureHandle = u32; // slot of the TextureCache
+
+    // Loaded textures by canonical source path and parameters, materials hold handles.
+    // Asking for a loaded texture again takes a reference on its image instead of decoding and uploading it twice.
+    struct TextureCache
+    {
+        static constexpr TextureHandle InvalidHandle = ~0u;
+
+        struct Texture
+        {
+            std::string m_key;
+            std::string m_path; // as first requested, also the cooked asset name
+            TextureParameters m_parameters;
+            ImageAttachment m_image;
+            VkSampler m_sampler = VK_NULL_HANDLE; // shared by the textures with the same parameters
+            u32 m_refCount = 0; // free slot at 0
+
+            // Streamed textures (m_blob set) only have the levels from m_residentMip in m_image, finer ones are uploaded when asked for
+            const octet* m_blob = nullptr; // KTX2 with the whole mip chain, in the mapped archive or m_file
+            u64 m_blobSize = 0;
+            AssetArchiveFormat::TextureHeader m_header{}; // levels of m_blob
+            MappedFile m_file; // KTX2 source, or texture cache of a chain cooked at load or for a hot reload
+            u64 m_sourceHash = 0; // FileHelper::hashFile of the source, 0 until a texture cache needs it
+            u32 m_residentMip = 0;
+            u32 m_requestedMip = 0; // finest level the models drawn last frame need
+            float m_projectedSize = 0.0f; // largest projected diameter of those models, in pixels
+
+            const AssetArchiveFormat::TextureHeader& header() const { return m_header; }
+        };
+
+        std::vector<Texture> m_textures; // by handle
+        std::vector<TextureHandle> m_freeHandles;
+        std::unordered_map<std::string, TextureHandle> m_handles; // by key
+        std::vector<std::pair<TextureParameters, VkSampler>> m_samplers;
+
+        // Mip chain cooked from the source in _format (a VkFormat), next to it like the mesh caches:
+        // CacheHeader, then the KTX2 blob at blobOffset. Reused by the next runs until the version, the format or the source content hash differ.
+        inline static std::string cachePath(const std::string& _sourcePath, u32 _format) { return _sourcePath + "." + std::to_string(_format) + ".texturecache"; }
+
+        static constexpr u32 CacheMagic = 0x5443594E; // "NYCT"
+        static constexpr u32 CacheVersion = 1; // stored with AssetCooker::TextureProcessorVersion, see TextureCacheVersion in Engine.cpp
+        static constexpr u32 CacheBlobAlignment = 64;
+        struct CacheHeader
+        {
+            u32 magic;
+            u32 version;
+            u64 sourceHash; // FileHelper::hashFile of the source
+            u32 format; // VkFormat
+            u32 blobOffset; // CacheBlobAlignment aligned
+            u64 blobSize;
+        };
+
+        inline static std::string key(const std::string& _path, const TextureParameters& _parameters)
+        {
+            // "./a/../b.jpg" and "b.jpg" are the same texture, a missing file keeps its path as is
+            std::error_code error;
+            std::filesystem::path canonical = std::filesystem::weakly_canonical(_path, error);
+            std::string key = error ? _path : canonical.generic_string();
+            key += "|" + std::to_string((u32)_parameters.m_format) + "|" + std::to_string((u32)_parameters.m_filter) + "|" + std::to_string((u32)_parameters.m_addressMode) + "|" + std::to_string(_parameters.m_maxAnisotropy);
+            return key;
+        }
+
+        // A new reference on the texture loaded with this key, InvalidHandle when there is none
+        inline TextureHandle acquire(const std::string& _key)
+        {
+            auto found = m_handles.find(_key);
+            if (found == m_handles.end())
+                return InvalidHandle;
+            ++m_textures[found->second].m_refCount;
+            return found->second;
+        }
+
+        // Takes the first reference on a loaded texture
+        inline TextureHandle add(Texture&& _texture)
+        {
+            TextureHandle handle = (TextureHandle)m_textures.size();
+            if (!m_freeHandles.empty())
+            {
+                handle = m_freeHandles.back();
+                m_freeHandles.pop_back();
+            }
+            else
+                m_textures.emplace_back();
+
+            _texture.m_refCount = 1;
+            m_handles[_texture.m_key] = handle;
+            m_textures[handle] = std::move(_texture);
+            return handle;
+        }
+
+        // Drops a reference, true when it was the last one and the image is the caller's to destroy
+        inline bool release(TextureHandle _handle)
+        {
+            Texture& texture = m_textures[_handle];
+            if (--texture.m_refCount > 0)
+                return false;
+            m_handles.erase(texture.m_key);
+            m_freeHandles.push_back(_handle);
+            return true;
         }
+
+        inline Texture& get(TextureHandle _handle) { return m_textures[_handle]; }
     };
 
     struct RenderPass
@@ -633,6 +957,12 @@ namespace Nyte
             stage.m_stageFlag = VK_SHADER_STAGE_FRAGMENT_BIT;
             return stage;
         }
+        static ShaderStage computeShader()
+        {
+            ShaderStage stage;
+            stage.m_stageFlag = VK_SHADER_STAGE_COMPUTE_BIT;
+            return stage;
+        }
 
         inline void createShader(VkDevice _device)
         {
@@ -727,13 +1057,35 @@ namespace Nyte
 
             m_bindings.push_back(binding);
         }
-        inline void addSamplerBinding()
+        inline void addStorageBufferBinding(VkShaderStageFlags _stageFlags)
+        {
+            VkDescriptorSetLayoutBinding binding;
+            binding.binding = (u32)m_bindings.size();
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorCount = 1;
+            binding.stageFlags = _stageFlags;
+            binding.pImmutableSamplers = nullptr; // Optional
+
+            m_bindings.push_back(binding);
+        }
+        inline void addSamplerBinding(VkShaderStageFlags _stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT)
         {
             VkDescriptorSetLayoutBinding binding;
             binding.binding = (u32)m_bindings.size();
             binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
             binding.descriptorCount = 1;
-            binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            binding.stageFlags = _stageFlags;
+            binding.pImmutableSamplers = nullptr; // Optional
+
+            m_bindings.push_back(binding);
+        }
+        inline void addStorageImageBinding(VkShaderStageFlags _stageFlags, u32 _count = 1)
+        {
+            VkDescriptorSetLayoutBinding binding;
+            binding.binding = (u32)m_bindings.size();
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            binding.descriptorCount = _count;
+            binding.stageFlags = _stageFlags;
             binding.pImmutableSamplers = nullptr; // Optional
 
             m_bindings.push_back(binding);
@@ -785,7 +1137,7 @@ namespace Nyte
 
             m_writeDescriptorSets.push_back(descriptorWrite);
         }
-        inline void addWriteImageDescriptorSet(VkDescriptorSet _dstSet, u32 _bindingIndex, VkDescriptorType _descriptorType, VkSampler _sampler, VkImageView _imageView, VkImageLayout _imageLayout)
+        inline void addWriteImageDescriptorSet(VkDescriptorSet _dstSet, u32 _bindingIndex, VkDescriptorType _descriptorType, VkSampler _sampler, VkImageView _imageView, VkImageLayout _imageLayout, u32 _arrayElement = 0)
         {
             WriteInfo writeInfo;
             writeInfo.m_imageInfo = { _sampler, _imageView, _imageLayout };
@@ -796,7 +1148,7 @@ namespace Nyte
             descriptorWrite.pNext = nullptr;
             descriptorWrite.dstSet = _dstSet;
             descriptorWrite.dstBinding = _bindingIndex;
-            descriptorWrite.dstArrayElement = 0;
+            descriptorWrite.dstArrayElement = _arrayElement;
             descriptorWrite.descriptorType = _descriptorType;
             descriptorWrite.descriptorCount = 1;
 
@@ -808,7 +1160,7 @@ namespace Nyte
             std::vector<VkDescriptorPoolSize> poolSizes{};
             for (VkDescriptorSetLayoutBinding binding : m_descriptorSetLayout.m_bindings)
             {
-                poolSizes.emplace_back(binding.descriptorType, _allocateCount);
+                poolSizes.emplace_back(binding.descriptorType, binding.descriptorCount * _allocateCount);
             }
 
             VkDescriptorPoolCreateInfo poolInfo{};
@@ -913,6 +1265,7 @@ namespace Nyte
         VkPipelineLayout m_pipelineLayout;
 
         std::vector<DescriptorSetLayout> m_descriptorSetLayouts;
+        std::vector<VkPushConstantRange> m_pushConstantRanges;
 
         inline void createPipelineLayout(VkDevice _device)
         {
@@ -924,8 +1277,8 @@ namespace Nyte
             pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
             pipelineLayoutInfo.setLayoutCount = (u32)setLayouts.size();
             pipelineLayoutInfo.pSetLayouts = setLayouts.data();
-            pipelineLayoutInfo.pushConstantRangeCount = 0;    // Optional
-            pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+            pipelineLayoutInfo.pushConstantRangeCount = (u32)m_pushConstantRanges.size();    // Optional
+            pipelineLayoutInfo.pPushConstantRanges = m_pushConstantRanges.data(); // Optional
 
             VCR(vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout), "Failed to create pipeline layout.");
         }
@@ -946,6 +1299,7 @@ namespace Nyte
         RenderPass m_renderPass;
         PipelineLayout m_pipelineLayout;
         bool m_depthTestEnable = true;
+        VkFrontFace m_frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // careful, we use ccw here due to glm->vulkan conversion in projection matrix
 
         inline void createPipeline(VkDevice _device)
         {
@@ -995,7 +1349,7 @@ namespace Nyte
             rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // fill, edges or points
             rasterizer.lineWidth = 1.0f; // default value (otherwise require "wideLines" extension)
             rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; //VK_CULL_MODE_FRONT_AND_BACK; //VK_CULL_MODE_BACK_BIT;
-            rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // careful, we use ccw here due to glm->vulkan conversion in projection matrix
+            rasterizer.frontFace = m_frontFace;
             rasterizer.depthBiasEnable = VK_FALSE;
             rasterizer.depthBiasConstantFactor = 0.0f; // Optional
             rasterizer.depthBiasClamp = 0.0f; // Optional
@@ -1081,6 +1435,188 @@ namespace Nyte
             vkDestroyPipeline(_device, m_pipeline, nullptr);
         }
     };
+    struct ComputePipeline
+    {
+        VkPipeline m_pipeline;
+
+        ShaderStage m_shader;
+        PipelineLayout m_pipelineLayout;
+
+        inline void createPipeline(VkDevice _device)
+        {
+            VkComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage = m_shader.getStageCreateInfo();
+            pipelineInfo.layout = m_pipelineLayout.m_pipelineLayout;
+            pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional (pipeline inheritance)
+            pipelineInfo.basePipelineIndex = -1; // Optional
+
+            VCR(vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline), "Failed to create compute pipeline.");
+        }
+        inline void destroyPipeline(VkDevice _device)
+        {
+            vkDestroyPipeline(_device, m_pipeline, nullptr);
+        }
+    };
+
+    // Single pass mip chain on the GPU (mip_downsample.comp), for images mip mapped on the device: render targets, procedural maps.
+    // One dispatch writes up to 12 levels: every workgroup reduces a 64x64 tile of mip 0 to one texel of mip 6 in shared memory,
+    // the last one to finish (atomic counter) goes on to mip 12. sRGB images are filtered in linear space.
+    struct MipDownsampler
+    {
+        static constexpr u32 MaxMips = 12; // levels written after mip 0
+        static constexpr u32 TileSize = 64; // mip 0 texels of a workgroup each way
+        static constexpr u32 MaxExtent = TileSize * 64; // mip 0 texels each way, mip 6 has to fit the 64x64 texels of the global buffer
+        static constexpr VkDeviceSize GlobalBufferSize = 16 + 64 * 64 * 16; // counter, then the mip 6 texels (vec4)
+
+        ComputePipeline m_pipeline;
+        DescriptorSetLayout m_descriptorSetLayout;
+        VkSampler m_sampler = VK_NULL_HANDLE; // texelFetch of mip 0, null until created
+
+        static bool supports(VkExtent2D _extent, u32 _mipLevels)
+        {
+            return _mipLevels >= 2 && _mipLevels <= MaxMips + 1 && _extent.width <= MaxExtent && _extent.height <= MaxExtent;
+        }
+
+        inline void create(VkDevice _device)
+        {
+            m_descriptorSetLayout.addSamplerBinding(VK_SHADER_STAGE_COMPUTE_BIT);                  // mip 0
+            m_descriptorSetLayout.addStorageImageBinding(VK_SHADER_STAGE_COMPUTE_BIT, MaxMips);    // mips 1 to 12
+            m_descriptorSetLayout.addStorageBufferBinding(VK_SHADER_STAGE_COMPUTE_BIT);            // counter and mip 6
+            m_descriptorSetLayout.createDescriptorSetLayout(_device);
+
+            m_pipeline.m_shader = ShaderStage::computeShader();
+            m_pipeline.m_shader.m_path = "Resources/Shaders/mip_downsample_cs.spv";
+            m_pipeline.m_shader.createShader(_device);
+            m_pipeline.m_pipelineLayout.m_descriptorSetLayouts = { m_descriptorSetLayout };
+            m_pipeline.m_pipelineLayout.m_pushConstantRanges = { { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants_MipDownsample) } };
+            m_pipeline.m_pipelineLayout.createPipelineLayout(_device);
+            m_pipeline.createPipeline(_device);
+
+            VkSamplerCreateInfo samplerInfo{};
+            samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter = VK_FILTER_NEAREST;
+            samplerInfo.minFilter = VK_FILTER_NEAREST;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.maxLod = 0.0f;
+            VCR(vkCreateSampler(_device, &samplerInfo, nullptr, &m_sampler), "Failed to create sampler.");
+        }
+        inline void destroy(VkDevice _device)
+        {
+            vkDestroySampler(_device, m_sampler, nullptr);
+            m_pipeline.destroyPipeline(_device);
+            m_pipeline.m_pipelineLayout.destroyPipelineLayout(_device);
+            m_pipeline.m_shader.destroyShader(_device);
+            m_descriptorSetLayout.destroyDescriptorSetLayout(_device);
+        }
+    };
+
+    inline void ImageAttachment::createMipDownsample(VkDevice _device, VkPhysicalDevice _physicalDevice, const MipDownsampler& _downsampler)
+    {
+        if (!(m_usage & VK_IMAGE_USAGE_STORAGE_BIT) || !MipDownsampler::supports(m_extent, m_mipLevels))
+            throw std::runtime_error("Compute mips need a storage image of 2 to 13 levels, up to 4096 texels each way.");
+
+        // Mip 0 sampled in the image format (sRGB decoded on fetch), the other levels stored to
+        m_mipViews.resize(m_mipLevels);
+        for (u32 level = 0; level < m_mipLevels; ++level)
+        {
+            VkImageViewUsageCreateInfoKHR viewUsage{};
+            viewUsage.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO_KHR;
+            viewUsage.usage = level == 0 ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_STORAGE_BIT;
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.pNext = &viewUsage;
+            viewInfo.image = m_image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = level == 0 ? m_format : storageFormat(m_format);
+            viewInfo.subresourceRange.aspectMask = m_aspectMask;
+            viewInfo.subresourceRange.baseMipLevel = level;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+            VCR(vkCreateImageView(_device, &viewInfo, nullptr, &m_mipViews[level]), "Failed to create image view.");
+        }
+
+        m_mipGlobalBuffer.m_size = MipDownsampler::GlobalBufferSize;
+        m_mipGlobalBuffer.m_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        m_mipGlobalBuffer.m_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        m_mipGlobalBuffer.createBuffer(_device, _physicalDevice);
+
+        DescriptorSets descriptorSets;
+        descriptorSets.m_descriptorSetLayout = _downsampler.m_descriptorSetLayout;
+        descriptorSets.allocateDescriptorSets(_device, 1);
+        m_mipDescriptorPool = descriptorSets.m_descriptorPool;
+        m_mipDescriptorSet = descriptorSets.m_descriptorSets[0];
+        descriptorSets.addWriteImageDescriptorSet(m_mipDescriptorSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _downsampler.m_sampler, m_mipViews[0], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        // past the last level, elements point at it: never stored to but the whole array must be valid
+        for (u32 mip = 1; mip <= MipDownsampler::MaxMips; ++mip)
+            descriptorSets.addWriteImageDescriptorSet(m_mipDescriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, m_mipViews[std::min(mip, m_mipLevels - 1)], VK_IMAGE_LAYOUT_GENERAL, mip - 1);
+        descriptorSets.addWriteBufferDescriptorSet(m_mipDescriptorSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_mipGlobalBuffer.m_buffer, 0, VK_WHOLE_SIZE);
+        descriptorSets.updateDescriptorSets(_device);
+    }
+    inline void ImageAttachment::destroyMipDownsample(VkDevice _device)
+    {
+        vkDestroyDescriptorPool(_device, m_mipDescriptorPool, nullptr);
+        vkDestroyBuffer(_device, m_mipGlobalBuffer.m_buffer, nullptr);
+        vkFreeMemory(_device, m_mipGlobalBuffer.m_bufferDeviceMemory, nullptr);
+        for (VkImageView view : m_mipViews)
+            vkDestroyImageView(_device, view, nullptr);
+        m_mipViews.clear();
+    }
+    inline void ImageAttachment::recordMipDownsample(VkCommandBuffer _commandBuffer, const MipDownsampler& _downsampler, VkImageLayout _mip0Layout) const
+    {
+        // Counter back to 0 once the previous chain of this image is done with it
+        VkMemoryBarrier memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(_commandBuffer, m_mipGlobalBuffer.m_buffer, 0, sizeof(u32), 0);
+
+        // Mip 0 sampled, the other levels written from scratch
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        for (VkImageMemoryBarrier& barrier : barriers)
+        {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = m_image;
+            barrier.subresourceRange.aspectMask = m_aspectMask;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+        }
+        barriers[0].oldLayout = _mip0Layout;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].subresourceRange.baseMipLevel = 0;
+        barriers[0].subresourceRange.levelCount = 1;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].srcAccessMask = VK_ACCESS_NONE;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].subresourceRange.baseMipLevel = 1;
+        barriers[1].subresourceRange.levelCount = m_mipLevels - 1;
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, (u32)barriers.size(), barriers.data());
+
+        PushConstants_MipDownsample downsample{ m_extent.width, m_extent.height, m_mipLevels - 1, storageFormat(m_format) != m_format ? 1u : 0u };
+        vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _downsampler.m_pipeline.m_pipeline);
+        vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _downsampler.m_pipeline.m_pipelineLayout.m_pipelineLayout, 0, 1, &m_mipDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(_commandBuffer, _downsampler.m_pipeline.m_pipelineLayout.m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants_MipDownsample), &downsample);
+        vkCmdDispatch(_commandBuffer, (m_extent.width + MipDownsampler::TileSize - 1) / MipDownsampler::TileSize, (m_extent.height + MipDownsampler::TileSize - 1) / MipDownsampler::TileSize, 1);
+
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+    }
 
     struct CommandBuffers
     {
@@ -1107,11 +1643,19 @@ namespace Nyte
         }
 
         inline void beginPass(u32 _index)
+        {
+            beginCommands(_index);
+            beginRenderPass(_index);
+        }
+        // beginPass in two steps, for work recorded outside of the render pass (compute)
+        inline void beginCommands(u32 _index)
         {
             VkCommandBufferBeginInfo beginInfo{};
             beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
             VCR(vkBeginCommandBuffer(m_commandBuffers[_index], &beginInfo), "Failed to begin command buffer.");
-
+        }
+        inline void beginRenderPass(u32 _index)
+        {
             std::vector<VkClearValue> clearValues;
             for (const ImageAttachment& imageAttachment : m_framebuffer.m_attachments)
                 clearValues.push_back(imageAttachment.m_clearValue);
@@ -1179,13 +1723,22 @@ namespace Nyte
         Framebuffer m_framebuffer;
 
         ShaderStage m_vertexShader;
+        ShaderStage m_packedVertexShader;
         ShaderStage m_fragmentShader;
 
         DescriptorSetLayout m_descriptorSetLayout;
         DescriptorSets m_descriptorSets;
+        DescriptorSetLayout m_instanceDescriptorSetLayout; // per model: instance transforms, visible instances
 
         PipelineLayout m_pipelineLayout;
         Pipeline m_pipeline;
+        Pipeline m_packedPipeline; // VertexFormat::Packed16 meshes
+        Pipeline m_mirroredPipeline; // mirrored instances, clockwise front faces
+        Pipeline m_mirroredPackedPipeline;
+
+        // Cluster culling, fills every model's indirect draws before the render pass
+        DescriptorSetLayout m_cullDescriptorSetLayout;
+        ComputePipeline m_cullPipeline;
 
         CommandBuffers m_cmdBuffers;
     };
@@ -1210,15 +1763,70 @@ namespace Nyte
 
     struct Model
     {
+        static constexpr u32 MaxLodCount = 5;
+
+        // Simplified sub-range of a submesh index range
+        struct Lod
+        {
+            u32 m_firstIndex = 0; // in the submesh m_indexType units
+            u32 m_indexCount = 0;
+            float m_error = 0.0f; // distance to LOD 0, in submesh geometry units
+        };
+        // Range of the shared index buffer drawn with a single material
+        struct SubMesh
+        {
+            u32 m_firstIndex = 0; // in m_indexType units
+            u32 m_indexCount = 0; // every LOD
+            VkIndexType m_indexType = VK_INDEX_TYPE_UINT32; // 16 bit when the submesh indices fit
+            i32 m_vertexOffset = 0;
+            u32 m_vertexCount = 0; // vertices referenced from m_vertexOffset
+            i32 m_materialSlot = -1;
+            glm::vec3 m_positionScale{ 1.0f }; // packed vertex formats only
+            glm::vec3 m_positionOffset{ 0.0f };
+            u32 m_firstMeshlet = 0; // one indirect draw per meshlet, every LOD
+            u32 m_meshletCount = 0;
+            glm::vec4 m_sphere{ 0.0f }; // bounds of its meshlets
+            std::vector<Lod> m_lods;
+            u32 m_firstInstance = 0; // placements of the submesh, each meshlet draw instances the visible ones
+            u32 m_instanceCount = 1;
+        };
         struct Mesh
         {
-            std::vector<Vertex> m_vertices;
-            std::vector<u32> m_indices;
+            VertexFormat m_vertexFormat = VertexFormat::Float32;
+            u32 m_vertexCount = 0;
+            u32 m_indexCount = 0;
+            u32 m_indexDataSize = 0; // bytes, 16 and 32 bit ranges share the index buffer
+            std::vector<SubMesh> m_subMeshes;
 
             VkBuffer m_vertexBuffer;
             VkDeviceMemory m_vertexBufferDeviceMemory;
             VkBuffer m_indexBuffer;
             VkDeviceMemory m_indexBufferDeviceMemory;
+
+            u32 m_meshletCount = 0;
+            VkBuffer m_meshletBuffer;
+            VkDeviceMemory m_meshletBufferDeviceMemory;
+
+            // Nodes sharing a geometry are instances of one mesh
+            u32 m_instanceCount = 0;
+            u32 m_mirroredInstanceCount = 0; // negative determinant, drawn a second time with the opposite winding
+            VkBuffer m_instanceBuffer; // InstanceTransform, m_instanceOffset applied
+            VkDeviceMemory m_instanceBufferDeviceMemory;
+            VkBuffer m_subMeshInstanceBuffer; // SubMeshInstances of every submesh
+            VkDeviceMemory m_subMeshInstanceBufferDeviceMemory;
+            u32 m_instanceSlotCount = 0; // visible instance slots, the instance count of its submesh per meshlet
+
+            // per swapchain image, written by the cluster culling pass. Two draws per meshlet: regular then mirrored instances
+            std::vector<VkBuffer> m_drawCommandBuffers;
+            std::vector<VkDeviceMemory> m_drawCommandBuffersDeviceMemory;
+            std::vector<VkBuffer> m_visibleInstanceBuffers; // instance indices drawn by each meshlet
+            std::vector<VkDeviceMemory> m_visibleInstanceBuffersDeviceMemory;
+            DescriptorSets m_cullDescriptorSets;
+            DescriptorSets m_instanceDescriptorSets; // set 1 of the G-buffer pipelines
+
+            // Texture streaming, bounds of every placement. The LOD is selected per instance by the cluster culling
+            glm::vec3 m_boundsCenter{ 0.0f };
+            float m_boundsRadius = 0.0f;
         };
         struct Material
         {
@@ -1238,7 +1846,7 @@ namespace Nyte
             };
 
             MaterialType m_type;
-            std::vector<ImageAttachment> m_textures;
+            std::vector<TextureHandle> m_textures; // references of the engine TextureCache
 
             MaterialConstants m_constants;
             std::vector<VkBuffer> m_constantsUBO;
@@ -1247,6 +1855,9 @@ namespace Nyte
 
         Mesh m_mesh;
         Material m_material;
+
+        std::string m_sourcePath; // the mesh is loaded again from it on hot reload
+        glm::vec3 m_instanceOffset{ 0.0f }; // applied to the uploaded instance transforms and bounds
     };
 
     class Engine 
@@ -1265,6 +1876,8 @@ namespace Nyte
 
         VkInstance& getInstance() { return m_instance; };
         void setSurface(VkSurfaceKHR* _surface) { m_surface = _surface; };
+        void setJobThreadCount(u32 _threadCount) { m_jobThreadCount = _threadCount; }; // 0 = hardware concurrency, must be set before init()
+        void setWatchAssets(bool _watch) { m_watchAssets = _watch; }; // hot reload the sources edited while running, must be set before init()
 
     private:
 #pragma region PhysicalDevice
@@ -1307,12 +1920,19 @@ namespace Nyte
         void transitionImageLayoutFromTransferToGraphics(VkImage _image, u32 _mipLevels);
         void copyBufferToImage(VkBuffer _buffer, VkImage _image, u32 _width, u32 _height);
         void createImageView(VkImage _image, VkFormat _format, u32 _mipLevels, VkImageAspectFlags _aspectMask, VkImageView& _imageView);
-        void generateMipmaps(VkImage _image, VkFormat _format, u32 _texWidth, u32 _texHeight, u32 _mipLevels);
+        // Mip 0 of _image is in _layout, every level ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+        // One compute dispatch for storage images (MipDownsampler, created on first use) when m_computeMips, a blit a level otherwise.
+        // Records on the graphics queue: called under m_uploadMutex once textures load.
+        void generateMipmaps(ImageAttachment& _image, VkImageLayout _layout);
 #pragma endregion Common
 
         void createCommandPools();
 
         void createOffscreenGBuffer();
+        void createDrawCommands(Model& _model);
+        void destroyDrawCommands(Model& _model);
+        void recordOffscreenCommandBuffers();
+        void recordOffscreenCommandBuffer(u32 _imageIndex);
         void buildOffscreenCommandBuffer(const u32 _passIndex, Model& _model);
         void unbuildOffscreenCommandBuffer(Model& _model);
         void destroyOffscreenGBuffer();
@@ -1326,14 +1946,94 @@ namespace Nyte
         bool hasStencilComponent(VkFormat _format);
         VkFormat findDepthFormat();
 
-        void loadOBJModel(std::vector<Model>& _models, std::string _objPath);
-        void loadFBXModel(std::vector<Model>& _models, std::string _fbxPath);
+#pragma region HotReload
+        // Source cooked again by the watch thread, swapped in by updateHotReload
+        struct HotReload
+        {
+            std::string m_sourcePath; // asset name of the source
+            AssetArchiveFormat::AssetType m_type = AssetArchiveFormat::Mesh;
+            u64 m_sourceHash = 0;
+            std::vector<VertexFormat> m_vertexFormats; // meshes: one cache image per format in m_blobs
+            std::vector<std::vector<u8>> m_blobs; // laid out like the archive blobs
+        };
+        // What the loaded models use of a source
+        struct WatchedSource
+        {
+            AssetArchiveFormat::AssetType m_type = AssetArchiveFormat::Mesh;
+            std::vector<VertexFormat> m_vertexFormats;
+            u64 m_sourceHash = 0; // last cooked content, 0 until the first reload
+        };
+
+        void startAssetWatch();
+        void stopAssetWatch();
+        void watchAssets(); // watch thread
+        void updateHotReload();
+        void reloadMesh(Model& _model, const HotReload& _reload, u32 _blob);
+#pragma endregion HotReload
+
+#pragma region TextureStreaming
+        // Level streamed into a texture, or levels evicted from it, swapped in by updateTextureStreaming once its fence signaled
+        struct TextureUpload
+        {
+            TextureHandle m_texture = TextureCache::InvalidHandle;
+            u32 m_mip = 0; // finest level of m_image
+            ImageAttachment m_image;
+            Buffer m_stagingBuffer; // uploads only
+            VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+            VkFence m_fence = VK_NULL_HANDLE;
+        };
+        // Image swapped out of a texture, destroyed once the in flight fences of its swap signaled
+        struct RetiredImage
+        {
+            ImageAttachment m_image;
+            std::vector<VkFence> m_fences;
+        };
+
+        // Finest level of every texture of the model for its projected size, called for every drawn model before updateTextureStreaming
+        void requestTextureMips(const Model& _model, const glm::mat4& _modelMatrix, const glm::vec3& _cameraPos, float _fovY);
+        // Swaps in the finished resize, then evicts unneeded levels over TEXTURE_BUDGET_BYTES or starts the next upload.
+        // _imageIndex is the swapchain image of the frame, its gbuffer commands are recorded again after a swap.
+        void updateTextureStreaming(u32 _imageIndex);
+        // Resize of the texture to level _mip submitted into m_textureUpload, not waited for
+        void startTextureResize(TextureHandle _handle, u32 _mip);
+        void releaseRetiredImages();
+        // Resized image of a streamed texture from level _mip on, its resident levels are copied on the GPU and level _mip from _stagingBuffer when given
+        ImageAttachment recordTextureResize(VkCommandBuffer _commandBuffer, const TextureCache::Texture& _texture, u32 _mip, const Buffer* _stagingBuffer);
+        void destroyTextureUpload(); // waits for it, an image not swapped in yet is dropped
+#pragma endregion TextureStreaming
+
+        // FBX or OBJ, see FBXHelper::loadScene
+        void loadModel(std::vector<Model>& _models, std::string _sourcePath, VertexFormat _vertexFormat = VertexFormat::Float32);
+        // Mesh of _model from its source path and vertex format, or from a hot reload image
+        void loadMesh(Model& _model, const HotReload* _reload = nullptr, u32 _blob = 0);
+        // From the asset archive when it was cooked, decoded from its path otherwise. Streamed textures only upload their mip tail.
+        void loadTexture(TextureCache::Texture& _texture);
+        // Streams from the texture cache of _texture.m_sourceHash, _blob is only written when the file doesn't hold it yet.
+        // The chain is not kept in memory. False if it can't be written.
+        bool mapTextureCache(TextureCache::Texture& _texture, const octet* _blob, u64 _blobSize);
+        // Maps the texture cache when it holds the chain of _texture.m_sourceHash in _format. Called with m_textureCacheMutex held.
+        bool openTextureCache(TextureCache::Texture& _texture, u32 _format);
+        // Shared with every material using the same source and parameters, loaded on the first request
+        TextureHandle acquireTexture(const std::string& _filePath, const TextureParameters& _parameters = {});
+        // Same for a whole material or scene: the textures to load are decoded concurrently by the job system, each uploaded as soon as it is decoded
+        std::vector<TextureHandle> acquireTextures(const std::vector<std::string>& _filePaths, const TextureParameters& _parameters = {});
+        // The image is destroyed with its last reference
+        void releaseTexture(TextureHandle _handle);
+        VkSampler getTextureSampler(const TextureParameters& _parameters);
+        // nullptr when the archive has no up to date asset for the source
+        const AssetArchiveFormat::Entry* findCookedAsset(const std::string& _sourcePath, const std::string& _variant, AssetArchiveFormat::AssetType _type);
 
         u32 findMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties);
-        void createVertexBuffer(Model& _model);
+        void createDeviceLocalBuffer(VkDeviceSize _size, VkBufferUsageFlags _usage, const std::function<void(void*)>& _fillStaging, VkBuffer& _buffer, VkDeviceMemory& _bufferDeviceMemory);
+        void createVertexBuffer(Model& _model, VkDeviceSize _size, const std::function<void(void*)>& _fillStaging);
         void destroyVertexBuffer(Model& _model);
-        void createIndexBuffer(Model& _model);
+        void createIndexBuffer(Model& _model, VkDeviceSize _size, const std::function<void(void*)>& _fillStaging);
         void destroyIndexBuffer(Model& _model);
+        void createMeshletBuffer(Model& _model, VkDeviceSize _size, const std::function<void(void*)>& _fillStaging);
+        void destroyMeshletBuffer(Model& _model);
+        // Instance transforms and the submesh instance ranges, _model submeshes are loaded
+        void createInstanceBuffers(Model& _model, const MeshCacheFormat::Instance* _instances);
+        void destroyInstanceBuffers(Model& _model);
         void createUniformBuffers();
         void destroyUniformBuffers();
         //void createTextureImage();
@@ -1345,13 +2045,39 @@ namespace Nyte
 
 
         void updateUniformBuffer(u32 _currentImage);
+        // Pixels per model unit at the nearest point of the model bounds, _scale is the largest axis scale of _modelMatrix
+        float projectedPixelsPerUnit(const Model& _model, const glm::mat4& _modelMatrix, const glm::vec3& _cameraPos, float _fovY, float& _scale) const;
 
     private:
         static constexpr u32 MAX_FRAMES_IN_FLIGHT = 2;
+        static constexpr bool BENCHMARK_IMPORT = false; // import every source twice, single threaded then with the job system
+        static constexpr bool COMPRESS_MESH_CACHE = true; // deflate the cached vertices and indices, smaller reads for a parallel decode
+        static constexpr float LOD_ERROR_PIXELS = 1.0f; // coarsest LOD whose projected error stays under this is selected, per instance by cluster_cull.comp
+        static constexpr bool STREAM_TEXTURES = true; // textures start with their mip tail, finer levels stream in by projected size
+        static constexpr u32 TEXTURE_TAIL_SIZE = 256; // largest side of the finest level uploaded at load
+        static constexpr u64 TEXTURE_BUDGET_BYTES = 1024ull * 1024 * 1024; // streamed levels, unneeded ones are evicted above it
+        static constexpr bool GPU_MIPS = false; // uncooked textures: mip 0 uploaded and the chain built on the GPU (generateMipmaps), otherwise built on the CPU like NyteCook does
         u32 m_windowWidth;
         u32 m_windowHeight;
 
         VkSampleCountFlagBits m_msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+        bool m_multiDrawIndirect = false; // one vkCmdDrawIndexedIndirect per submesh instead of one per meshlet
+        bool m_computeMips = false; // shaderStorageImageWriteWithoutFormat and shaderStorageImageArrayDynamicIndexing, for MipDownsampler
+
+        u32 m_jobThreadCount = 0;
+        JobSystem m_jobSystem;
+        std::mutex m_uploadMutex; // texture jobs upload one at a time, the graphics command pool and queue are not thread safe
+        std::mutex m_textureCacheMutex; // texture cache files, written by one texture job and mapped by the others
+
+        AssetArchiveView m_assetArchive; // mapped for the whole engine lifetime (until loaded when assets are watched), cooked meshes point into it
+
+        bool m_watchAssets = false;
+        FileWatcher m_assetWatcher;
+        std::thread m_hotReloadThread;
+        std::atomic<bool> m_stopHotReload{ false };
+        std::mutex m_hotReloadMutex;
+        std::vector<HotReload> m_hotReloads; // cooked, waiting for the next frame
+        std::unordered_map<std::string, WatchedSource> m_watchedSources; // by source asset name, only read by the watch thread once started
 
         VkInstance m_instance;
         VkSurfaceKHR* m_surface;
@@ -1387,12 +2113,17 @@ namespace Nyte
         std::vector<VkDeviceMemory> m_uniformBuffersDeviceMemory;
 
         //std::vector<ImageAttachment> m_textures;
+        TextureCache m_textureCache;
+        TextureUpload m_textureUpload; // one resize in flight at a time
+        std::vector<RetiredImage> m_retiredImages;
+        std::vector<bool> m_staleOffscreenCommands; // per swapchain image, texture descriptors changed since recording
 
         RawImage m_texture;
         //VkImage m_textureImage;
         //VkDeviceMemory m_textureImageDeviceMemory;
         //VkImageView m_textureImageView;
         VkSampler m_textureSampler;
+        MipDownsampler m_mipDownsampler;
 
         // Note: Fences synchronize c++ calls with gpu operations
         //       Semaphores synchronize gpu operations with one another
@@ -1,14 +1,318 @@
 #include "FBXHelper.h"
 #include "FileHelper.h"
+#include "JobSystem.h"
+#include "VertexWelder.h"
+#include "MeshOptimizer.h"
+#include "OBJHelper.h"
+#include "TangentGenerator.h"
 #include <unordered_map>
+#include <map>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
 #include <fstream>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <limits>
 
-void FBXHelper::loadFBX(FBXScene& _fbx)
+#include <glm/gtc/type_ptr.hpp>
+
+// ofbx::JobProcessor adapter, _user is the JobSystem
+static void ofbxJobProcessor(ofbx::JobFunction _fn, void* _user, void* _data, u32 _size, u32 _count)
+{
+    JobSystem* jobSystem = (JobSystem*)_user;
+    ofbx::u8* data = (ofbx::u8*)_data;
+    jobSystem->parallelFor(_count, [&](u32 _index) {
+        _fn(data + (size_t)_index * _size);
+    });
+}
+
+// Global transform of a mesh node, geometric transform included.
+// Composed in double, ofbx doesn't export its DMatrix product.
+static glm::mat4 nodeTransform(const ofbx::Mesh* _mesh)
+{
+    glm::dmat4 global = glm::make_mat4(_mesh->getGlobalTransform().m);
+    glm::dmat4 geometric = glm::make_mat4(_mesh->getGeometricMatrix().m);
+    return glm::mat4(global * geometric);
+}
+
+static_assert(sizeof(ofbx::Vec3) == 3 * sizeof(float) && sizeof(ofbx::Vec2) == 2 * sizeof(float), "welding hashes float attributes");
+
+// Per corner attribute ids: the fbx index array when there is one, a value hash otherwise
+static const i32* attributeIds(const int* _indices, const float* _values, u32 _components, u32 _count, std::vector<i32>& _storage, JobSystem* _jobSystem)
+{
+    if (_values == nullptr)
+        return nullptr;
+    if (_indices != nullptr)
+        return _indices;
+
+    VertexWelder::indexValues(_values, _components, _count, _storage, _jobSystem);
+    return _storage.data();
+}
+
+int FBXHelper::findOrAddMaterial(FBXScene& _fbx, const ofbx::Material* _material, std::unordered_map<ofbx::u64, int>& _materialIndices)
+{
+    if (_material == nullptr)
+        return -1;
+
+    auto it = _materialIndices.find(_material->id);
+    if (it != _materialIndices.end())
+        return it->second;
+
+    auto textureFileName = [&](ofbx::Texture::TextureType _type) {
+        const ofbx::Texture* texture = _material->getTexture(_type);
+        if (texture == nullptr)
+            return std::string{};
+        char tmp[1024];
+        texture->getFileName().toString(tmp);
+        return std::string(tmp);
+    };
+
+    FBXMaterial fbxMaterial;
+    fbxMaterial.name = _material->name;
+    fbxMaterial.diffuse = textureFileName(ofbx::Texture::DIFFUSE);
+    fbxMaterial.normal = textureFileName(ofbx::Texture::NORMAL);
+    fbxMaterial.specular = textureFileName(ofbx::Texture::SPECULAR);
+    fbxMaterial.glossiness = textureFileName(ofbx::Texture::SHININESS);
+
+    _fbx.materials.push_back(fbxMaterial);
+    int materialIndex = (int)_fbx.materials.size() - 1;
+    _materialIndices[_material->id] = materialIndex;
+    return materialIndex;
+}
+
+void FBXHelper::weldCorners(FBXMesh& _mesh, std::vector<u32>& _cornerToVertex, const ofbx::GeometryData& _geometry, JobSystem* _jobSystem)
 {
-    std::vector<octet> rawData = FileHelper::readFile(_fbx.filePath);
+    ofbx::Vec3Attributes positions = _geometry.getPositions();
+    ofbx::Vec3Attributes normals = _geometry.getNormals();
+    // tangents are generated by finishMesh, the exported ones rarely match the MikkTSpace basis normal maps are baked in
+    ofbx::Vec2Attributes uvs = _geometry.getUVs(0);
+    u32 cornerCount = (u32)positions.count;
+
+    // Only the corners of polygons with 3+ vertices are welded, openFBX skips point and line polygons
+    // and leaves their last position index encoded as -index - 1
+    std::vector<u32> corners;
+    corners.reserve(cornerCount);
+    std::vector<u8> referenced(cornerCount, 0);
+    for (int p = 0; p < _geometry.getPartitionCount(); ++p)
+    {
+        ofbx::GeometryPartition partition = _geometry.getPartition(p);
+        for (int polygon = 0; polygon < partition.polygon_count; ++polygon)
+        {
+            const ofbx::GeometryPartition::Polygon& fbxPolygon = partition.polygons[polygon];
+            if (fbxPolygon.vertex_count >= 3)
+                std::fill_n(referenced.begin() + fbxPolygon.from_vertex, fbxPolygon.vertex_count, (u8)1);
+        }
+    }
+    for (u32 c = 0; c < cornerCount; ++c)
+        if (referenced[c])
+            corners.push_back(c);
+
+    std::vector<i32> positionStorage, normalStorage, uvStorage;
+    const i32* positionIds = attributeIds(positions.indices, (const float*)positions.values, 3, cornerCount, positionStorage, _jobSystem);
+    const i32* normalIds = normals.count == positions.count ? attributeIds(normals.indices, (const float*)normals.values, 3, cornerCount, normalStorage, _jobSystem) : nullptr;
+    const i32* uvIds = uvs.count == positions.count ? attributeIds(uvs.indices, (const float*)uvs.values, 2, cornerCount, uvStorage, _jobSystem) : nullptr;
+
+    u32 keyCount = (u32)corners.size();
+    std::vector<VertexWelder::Key> keys(keyCount);
+    for (u32 k = 0; k < keyCount; ++k)
+    {
+        u32 c = corners[k];
+        keys[k].position = positionIds[c];
+        keys[k].normal = normalIds ? normalIds[c] : -1;
+        keys[k].uv = uvIds ? uvIds[c] : -1;
+    }
+
+    std::vector<u32> remap, firstKeys;
+    VertexWelder::weld(keys.data(), keyCount, remap, firstKeys, _jobSystem);
+
+    // skipped corners are never triangulated, they keep vertex 0
+    _cornerToVertex.assign(cornerCount, 0);
+    for (u32 k = 0; k < keyCount; ++k)
+        _cornerToVertex[corners[k]] = remap[k];
+
+    _mesh.m_vertices.resize(firstKeys.size());
+    for (size_t v = 0; v < firstKeys.size(); ++v)
+    {
+        int corner = (int)corners[firstKeys[v]];
+        FBXVertex& vertex = _mesh.m_vertices[v];
+        ofbx::Vec3 position = positions.get(corner);
+        ofbx::Vec3 normal = normalIds ? normals.get(corner) : ofbx::Vec3{ 0.0f, 0.0f, 0.0f };
+        ofbx::Vec2 uv = uvIds ? uvs.get(corner) : ofbx::Vec2{ 0.0f, 0.0f };
+        vertex.pos = glm::vec3(position.x, position.y, position.z);
+        vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+        vertex.texCoords = glm::vec2(uv.x, uv.y);
+    }
+}
+
+void FBXHelper::optimizeMesh(FBXMesh& _mesh, MeshOptimizer::VertexCacheStatistics& _before, MeshOptimizer::VertexCacheStatistics& _after)
+{
+    if (_mesh.m_vertices.empty())
+        return;
+
+    // per submesh, the passes must not move triangles across materials
+    for (const FBXSubMesh& subMesh : _mesh.m_subMeshes)
+    {
+        u32* indices = _mesh.m_indices.data() + subMesh.firstIndex;
+        _before += MeshOptimizer::analyzeVertexCache(indices, subMesh.indexCount, _mesh.m_vertices.size());
+
+        MeshOptimizer::optimizeVertexCache(indices, subMesh.indexCount, _mesh.m_vertices.size());
+        MeshOptimizer::optimizeOverdraw(indices, subMesh.indexCount, &_mesh.m_vertices[0].pos.x, sizeof(FBXVertex), _mesh.m_vertices.size());
+    }
+
+    buildLods(_mesh);
+
+    // the submeshes and their LODs share the mesh vertices, fetch order follows the whole index list
+    size_t vertexCount = MeshOptimizer::optimizeVertexFetch(_mesh.m_vertices.data(), _mesh.m_vertices.size(), sizeof(FBXVertex), _mesh.m_indices.data(), _mesh.m_indices.size());
+    _mesh.m_vertices.resize(vertexCount);
+
+    for (const FBXSubMesh& subMesh : _mesh.m_subMeshes)
+        _after += MeshOptimizer::analyzeVertexCache(_mesh.m_indices.data() + subMesh.lods[0].firstIndex, subMesh.lods[0].indexCount, _mesh.m_vertices.size());
+}
+
+void FBXHelper::buildLods(FBXMesh& _mesh)
+{
+    // a LOD is kept when it removes at least LodMinReduction of the previous one's triangles
+    constexpr float LodMinReduction = 0.15f;
+    // simplification stops past this distance, relative to the submesh bounds diagonal
+    constexpr float LodMaxRelativeError = 0.05f;
+
+    std::vector<u32> indices;
+    indices.reserve(_mesh.m_indices.size() * 2);
+    std::vector<u32> lod, simplified;
+    const float* positions = &_mesh.m_vertices[0].pos.x;
+
+    for (FBXSubMesh& subMesh : _mesh.m_subMeshes)
+    {
+        const u32* subMeshIndices = _mesh.m_indices.data() + subMesh.lods[0].firstIndex;
+        u32 lod0IndexCount = subMesh.lods[0].indexCount;
+
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+        for (u32 i = 0; i < lod0IndexCount; ++i)
+        {
+            boundsMin = glm::min(boundsMin, _mesh.m_vertices[subMeshIndices[i]].pos);
+            boundsMax = glm::max(boundsMax, _mesh.m_vertices[subMeshIndices[i]].pos);
+        }
+        float maxError = lod0IndexCount ? glm::length(boundsMax - boundsMin) * LodMaxRelativeError : 0.0f;
+
+        subMesh.firstIndex = (u32)indices.size();
+        subMesh.lods[0].firstIndex = subMesh.firstIndex;
+        subMesh.lods[0].error = 0.0f;
+        subMesh.lodCount = 1;
+        indices.insert(indices.end(), subMeshIndices, subMeshIndices + lod0IndexCount);
+
+        // every LOD is simplified from the previous one, errors add up
+        lod.assign(subMeshIndices, subMeshIndices + lod0IndexCount);
+        for (u32 l = 1; l < FBXSubMesh::MaxLodCount; ++l)
+        {
+            size_t targetIndexCount = (lod0IndexCount >> l) / 3 * 3;
+            if (targetIndexCount == 0)
+                break;
+
+            simplified.resize(lod.size());
+            float error = 0.0f;
+            size_t indexCount = MeshOptimizer::simplify(simplified.data(), lod.data(), lod.size(), positions, sizeof(FBXVertex), _mesh.m_vertices.size(), targetIndexCount, maxError, &error);
+            if (indexCount == 0 || indexCount > lod.size() * (1.0f - LodMinReduction))
+                break;
+            simplified.resize(indexCount);
+            MeshOptimizer::optimizeVertexCache(simplified.data(), simplified.size(), _mesh.m_vertices.size());
+
+            FBXLod& previous = subMesh.lods[l - 1];
+            FBXLod& current = subMesh.lods[l];
+            current.firstIndex = (u32)indices.size();
+            current.indexCount = (u32)indexCount;
+            current.error = previous.error + error;
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            subMesh.lodCount = l + 1;
+            lod.swap(simplified);
+        }
+        subMesh.indexCount = (u32)indices.size() - subMesh.firstIndex;
+    }
+
+    _mesh.m_indices.swap(indices);
+}
+
+void FBXHelper::buildMeshlets(FBXMesh& _mesh)
+{
+    _mesh.m_meshlets.clear();
+    for (FBXSubMesh& subMesh : _mesh.m_subMeshes)
+    {
+        subMesh.firstMeshlet = (u32)_mesh.m_meshlets.size();
+        for (u32 l = 0; l < subMesh.lodCount; ++l)
+        {
+            FBXLod& lod = subMesh.lods[l];
+            lod.firstMeshlet = (u32)_mesh.m_meshlets.size();
+            MeshOptimizer::buildMeshlets(_mesh.m_indices.data() + lod.firstIndex, lod.indexCount, &_mesh.m_vertices[0].pos.x, sizeof(FBXVertex), _mesh.m_vertices.size(), _mesh.m_meshlets);
+            lod.meshletCount = (u32)_mesh.m_meshlets.size() - lod.firstMeshlet;
+
+            for (u32 m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; ++m)
+                _mesh.m_meshlets[m].firstIndex += lod.firstIndex;
+        }
+        subMesh.meshletCount = (u32)_mesh.m_meshlets.size() - subMesh.firstMeshlet;
+    }
+}
+
+void FBXHelper::finishMesh(FBXMesh& _mesh, MeshStatistics& _statistics, JobSystem* _jobSystem)
+{
+    // before the optimizations, split vertices are reordered with the others
+    auto tangentStartTime = std::chrono::high_resolution_clock::now();
+    _statistics.tangentSplits = TangentGenerator::generate(_mesh.m_vertices, _mesh.m_indices, _jobSystem);
+
+    auto optimizeStartTime = std::chrono::high_resolution_clock::now();
+    _statistics.tangentTime = std::chrono::duration<float, std::chrono::milliseconds::period>(optimizeStartTime - tangentStartTime).count();
+    optimizeMesh(_mesh, _statistics.before, _statistics.after);
+    if (!_mesh.m_vertices.empty())
+        buildMeshlets(_mesh);
+    _statistics.optimizeTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - optimizeStartTime).count();
+
+    _statistics.meshlets = _mesh.m_meshlets.size();
+    _statistics.subMeshes = (u32)_mesh.m_subMeshes.size();
+    for (const FBXSubMesh& subMesh : _mesh.m_subMeshes)
+        _statistics.lods += subMesh.lodCount;
+}
+
+void FBXHelper::logStatistics(const std::vector<MeshStatistics>& _statistics, float _importTime)
+{
+    MeshStatistics total;
+    for (const MeshStatistics& meshStatistics : _statistics)
+    {
+        total.corners += meshStatistics.corners;
+        total.vertices += meshStatistics.vertices;
+        total.lods += meshStatistics.lods;
+        total.subMeshes += meshStatistics.subMeshes;
+        total.meshlets += meshStatistics.meshlets;
+        total.weldTime += meshStatistics.weldTime;
+        total.tangentSplits += meshStatistics.tangentSplits;
+        total.tangentTime += meshStatistics.tangentTime;
+        total.optimizeTime += meshStatistics.optimizeTime;
+        total.before += meshStatistics.before;
+        total.after += meshStatistics.after;
+    }
+    std::cout << "\t\t weld " << total.corners << " corners -> " << total.vertices << " vertices " << total.weldTime << "ms\n";
+    std::cout << "\t\t tangents, " << total.tangentSplits << " vertices split on mirrored uvs " << total.tangentTime << "ms\n";
+    std::cout << "\t\t optimize ACMR " << total.before.acmr() << " -> " << total.after.acmr()
+        << ", ATVR " << total.before.atvr() << " -> " << total.after.atvr() << ", " << total.lods << " LODs for " << total.subMeshes << " submeshes, " << total.meshlets << " meshlets " << total.optimizeTime << "ms\n";
+    std::cout << "\t\t " << _statistics.size() << " meshes imported in " << _importTime << "ms (stage times above are summed over the mesh jobs)\n";
+}
+
+void FBXHelper::loadScene(FBXScene& _scene, JobSystem* _jobSystem, const std::function<void(u32)>& _meshReady)
+{
+    if (FileHelper::lowerExtension(_scene.filePath) == ".obj")
+        OBJHelper::loadOBJ(_scene, _jobSystem, _meshReady);
+    else
+        loadFBX(_scene, _jobSystem, _meshReady);
+}
+
+void FBXHelper::loadFBX(FBXScene& _fbx, JobSystem* _jobSystem, const std::function<void(u32)>& _meshReady)
+{
+    // the scene tokenizes straight from the mapped pages (BORROW_DATA), the mapping has to outlive it
+    MappedFile rawData = FileHelper::mapFile(_fbx.filePath);
 
     // Ignoring certain nodes will only stop them from being processed not tokenised (i.e. they will still be in the tree)
     ofbx::LoadFlags flags =
+        ofbx::LoadFlags::BORROW_DATA |
         //		ofbx::LoadFlags::IGNORE_MODELS |
         ofbx::LoadFlags::IGNORE_BLEND_SHAPES |
         ofbx::LoadFlags::IGNORE_CAMERAS |
@@ -24,107 +328,108 @@ void FBXHelper::loadFBX(FBXScene& _fbx)
         //		ofbx::LoadFlags::IGNORE_MESHES |
         ofbx::LoadFlags::IGNORE_ANIMATIONS;
 
-    ofbx::IScene* scene = ofbx::load((ofbx::u8*)rawData.data(), (ofbx::usize)rawData.size(), (ofbx::u16)flags);
+    u32 threadCount = _jobSystem ? _jobSystem->getThreadCount() : 1;
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-    int meshCount = scene->getMeshCount();
-    std::unordered_map<ofbx::u64, int> allMaterialIndices;
+    ofbx::IScene* scene = _jobSystem
+        ? ofbx::load((ofbx::u8*)rawData.data(), (ofbx::usize)rawData.size(), (ofbx::u16)flags, &ofbxJobProcessor, _jobSystem)
+        : ofbx::load((ofbx::u8*)rawData.data(), (ofbx::usize)rawData.size(), (ofbx::u16)flags);
+    if (!scene)
+        throw std::runtime_error(std::string{ "Failed to load fbx: " } + _fbx.filePath + " (" + ofbx::getError() + ")");
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count();
+    std::cout << "\t\t ofbx::load " << loadTime << "ms (" << threadCount << " thread" << (threadCount > 1 ? "s" : "") << ")\n";
 
-    for (int i = 0; i < meshCount; ++i)
+    // Mesh nodes are deduplicated on their geometry and materials, every node becomes an instance of its mesh.
+    // Materials are shared by the meshes, they are resolved before the meshes run in parallel.
+    int nodeCount = scene->getMeshCount();
+    std::unordered_map<ofbx::u64, int> allMaterialIndices;
+    std::map<std::pair<const void*, std::vector<int>>, u32> meshIndices;
+    std::vector<const ofbx::Mesh*> meshNodes; // first node of every mesh, its geometry is imported
+    std::vector<std::vector<int>> partitionMaterials;
+    for (int i = 0; i < nodeCount; ++i)
     {
-        const ofbx::Mesh* mesh = scene->getMesh(i);
-        const ofbx::GeometryData& geometryData = mesh->getGeometryData();
+        const ofbx::Mesh* node = scene->getMesh(i);
+        std::vector<int> materials;
+        int partitionCount = node->getGeometryData().getPartitionCount();
+        for (int p = 0; p < partitionCount; ++p)
+            materials.push_back(p < node->getMaterialCount() ? findOrAddMaterial(_fbx, node->getMaterial(p), allMaterialIndices) : -1);
 
-        ofbx::Vec3Attributes positions = geometryData.getPositions();
-        ofbx::Vec3Attributes normals = geometryData.getNormals();
-        //ofbx::Vec3Attributes tangents = geometryData.getTangents();
-        ofbx::Vec2Attributes uv0 = geometryData.getUVs(0);
+        // a mesh without geometry object keeps its own data
+        const void* geometry = node->getGeometry() ? (const void*)node->getGeometry() : (const void*)node;
+        auto [it, added] = meshIndices.try_emplace({ geometry, materials }, (u32)meshNodes.size());
+        if (added)
+        {
+            meshNodes.push_back(node);
+            partitionMaterials.push_back(std::move(materials));
+        }
+        _fbx.instances.push_back({ it->second, nodeTransform(node) });
+    }
+    std::stable_sort(_fbx.instances.begin(), _fbx.instances.end(), [](const FBXInstance& _a, const FBXInstance& _b) { return _a.mesh < _b.mesh; });
+
+    u32 meshCount = (u32)meshNodes.size();
+    _fbx.meshes.resize(meshCount);
+    std::cout << "\t\t " << nodeCount << " mesh nodes -> " << meshCount << " meshes\n";
+
+    std::vector<MeshStatistics> statistics(meshCount);
+    auto importStartTime = std::chrono::high_resolution_clock::now();
 
-	// TODO: improve import speed by reworking VB data (multi-buffer, stride)
-        static bool GOTTA_GO_FAST = true; // hack to speed up the importer
+    auto importJob = [&](u32 _mesh) {
+        const ofbx::GeometryData& geometryData = meshNodes[_mesh]->getGeometryData();
+        FBXMesh& fbxMesh = _fbx.meshes[_mesh];
+        MeshStatistics& meshStatistics = statistics[_mesh];
 
-        FBXMesh fbxMesh;
-        int vertexCount = positions.count;
-        for (int idx = 0; idx < vertexCount; ++idx)
+        auto weldStartTime = std::chrono::high_resolution_clock::now();
+        std::vector<u32> cornerToVertex;
+        weldCorners(fbxMesh, cornerToVertex, geometryData, _jobSystem);
+        meshStatistics.corners = (u32)cornerToVertex.size();
+        meshStatistics.vertices = (u32)fbxMesh.m_vertices.size();
+
+        // One submesh per material partition, all sharing the mesh vertices
+        int partitionCount = geometryData.getPartitionCount();
+        for (int p = 0; p < partitionCount; ++p)
         {
-            FBXVertex vertex;
-            vertex.position = positions.get(idx);
-            vertex.normal = normals.get(idx);
-            //vertex.tangent = tangents.get(idx);
-            vertex.uv = uv0.get(idx);
+            ofbx::GeometryPartition partition = geometryData.getPartition(p);
+            if (partition.polygon_count == 0)
+                continue;
 
-            if (GOTTA_GO_FAST)
-            {
-                fbxMesh.m_vertices.emplace_back(
-                    positions.get(idx),
-                    normals.get(idx),
-                    //tangents.get(idx),
-                    uv0.get(idx)
-                );
-                u32 index = (u32)fbxMesh.m_vertices.size() - 1;
-                fbxMesh.m_indices.push_back(index);
-            }
-            else
+            FBXSubMesh subMesh;
+            subMesh.firstIndex = (u32)fbxMesh.m_indices.size();
+            // point and line polygons count -1 and 0 triangles in material partitions
+            subMesh.indexCount = (u32)std::max(partition.triangles_count, 0) * 3;
+            subMesh.materialIndex = partitionMaterials[_mesh][p];
+
+            fbxMesh.m_indices.reserve(fbxMesh.m_indices.size() + subMesh.indexCount);
+            std::vector<int> triangleCorners(3 * partition.max_polygon_triangles);
+            for (int polygon = 0; polygon < partition.polygon_count; ++polygon)
             {
-                auto foundIt = std::find(fbxMesh.m_vertices.rbegin(), fbxMesh.m_vertices.rend(), vertex);
-                if (foundIt == fbxMesh.m_vertices.rend())
-                {
-                    fbxMesh.m_vertices.emplace_back(
-                        positions.get(idx),
-                        normals.get(idx),
-                        //tangents.get(idx),
-                        uv0.get(idx)
-                    );
-                    u32 index = (u32)fbxMesh.m_vertices.size() - 1;
-                    fbxMesh.m_indices.push_back(index);
-                }
-                else
-                {
-                    // vertex already registered
-                    u32 index = (u32)std::distance(fbxMesh.m_vertices.begin(), foundIt.base()) - 1;
-                    fbxMesh.m_indices.push_back(index);
-                }
+                u32 cornerCount = ofbx::triangulate(geometryData, partition.polygons[polygon], triangleCorners.data());
+                for (u32 c = 0; c < cornerCount; ++c)
+                    fbxMesh.m_indices.push_back(cornerToVertex[triangleCorners[c]]);
             }
+            subMesh.indexCount = (u32)fbxMesh.m_indices.size() - subMesh.firstIndex;
+            subMesh.lods[0].firstIndex = subMesh.firstIndex;
+            subMesh.lods[0].indexCount = subMesh.indexCount;
+
+            fbxMesh.m_subMeshes.push_back(subMesh);
         }
-        
-
-        //if (mesh->getMaterialCount() > 0)
-        //{
-        //    const ofbx::Material* material = mesh->getMaterial(0);
-        //
-        //    auto it = allMaterialIndices.find(material->id);
-        //    if (it == allMaterialIndices.end())
-        //    {
-        //        // Add new material
-        //        FBXMaterial fbxMaterial;
-        //
-        //        char tmp[1024];
-        //
-        //        material->getTexture(ofbx::Texture::DIFFUSE)->getFileName().toString(tmp);
-        //        fbxMaterial.diffuse = std::string(tmp);
-        //
-        //        material->getTexture(ofbx::Texture::NORMAL)->getFileName().toString(tmp);
-        //        fbxMaterial.normal = std::string(tmp);
-        //
-        //        material->getTexture(ofbx::Texture::SPECULAR)->getFileName().toString(tmp);
-        //        fbxMaterial.specular = std::string(tmp);
-        //
-        //        material->getTexture(ofbx::Texture::SHININESS)->getFileName().toString(tmp);
-        //        fbxMaterial.shininess = std::string(tmp);
-        //
-        //        _fbx.materials.push_back(fbxMaterial);
-        //        int materialIndex = _fbx.materials.size() - 1;
-        //
-        //        allMaterialIndices[material->id] = materialIndex;
-        //        fbxMesh.materialIndex = materialIndex;
-        //    }
-        //    else
-        //    {
-        //        fbxMesh.materialIndex = it->second;
-        //    }
-        //}
-
-        _fbx.meshes.push_back(fbxMesh);
-    }
+        meshStatistics.weldTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - weldStartTime).count();
+
+        finishMesh(fbxMesh, meshStatistics, _jobSystem);
+        if (_meshReady)
+            _meshReady(_mesh);
+    };
+    if (_jobSystem)
+        _jobSystem->parallelFor(meshCount, importJob);
+    else
+        for (u32 m = 0; m < meshCount; ++m)
+            importJob(m);
+
+    scene->destroy();
+
+    float importTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - importStartTime).count();
+    logStatistics(statistics, importTime);
 
     // Cache result
     //std::string cachePath = getCachePath(_fbx);
@@ -4,6 +4,8 @@
 #include <vector>
 #include <string>
 #include <array>
+#include <unordered_map>
+#include <functional>
 
 // openFBX
 #include "ofbx.h"
@@ -12,104 +14,107 @@
 #include "vulkan/vulkan_core.h"
 
 #include "Common.h"
+#include "VertexModel.h"
+#include "MeshOptimizer.h"
 
+class JobSystem;
 
-struct FBXVertex
-{
-    using Vec3 = ofbx::Vec3;
-    using Vec2 = ofbx::Vec2;
-
-    ofbx::Vec3 position;
-    ofbx::Vec3 normal;
-    //ofbx::Vec3 tangent;
-    ofbx::Vec2 uv;
-
-    static VkVertexInputBindingDescription getBindingDescription()
-    {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0; // binding index 
-        bindingDescription.stride = sizeof(FBXVertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return bindingDescription;
-    }
-
-    using FBXVertexInputAttributDescriptions = std::array<VkVertexInputAttributeDescription, 3>;
-    static FBXVertexInputAttributDescriptions getAttributeDescriptions()
-    {
-        FBXVertexInputAttributDescriptions attributeDescriptions{};
-
-        // inPosition
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT; // = vec3
-        attributeDescriptions[0].offset = offsetof(FBXVertex, position);
-
-        // inNormal
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT; // = vec3
-        attributeDescriptions[1].offset = offsetof(FBXVertex, normal);
-
-        //// inTangent
-        //attributeDescriptions[2].binding = 0;
-        //attributeDescriptions[2].location = 2;
-        //attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT; // = vec3
-        //attributeDescriptions[2].offset = offsetof(FBXVertex, tangent);
-
-        // inUV
-        attributeDescriptions[3].binding = 0;
-        attributeDescriptions[3].location = 2;
-        attributeDescriptions[3].format = VK_FORMAT_R32G32_SFLOAT; // = vec2
-        attributeDescriptions[3].offset = offsetof(FBXVertex, uv);
-
-        return attributeDescriptions;
-    }
+// Corners are welded straight into the engine vertex layout, the import has no conversion pass
+using FBXVertex = Vertex;
 
-    bool operator== (const FBXVertex& _other)
-    {
-        return
-            position.x == _other.position.x
-            && position.y == _other.position.y
-            && position.z == _other.position.z
-
-            && normal.x == _other.normal.x
-            && normal.y == _other.normal.y
-            && normal.z == _other.normal.z
-
-            //&& tangent.x == _other.tangent.x
-            //&& tangent.y == _other.tangent.y
-            //&& tangent.z == _other.tangent.z
-
-            && uv.x == _other.uv.x
-            && uv.y == _other.uv.y;
-    }
+// Simplified index range of a submesh, LOD 0 is the full resolution one
+struct FBXLod
+{
+    u32 firstIndex = 0; // in FBXMesh::m_indices
+    u32 indexCount = 0;
+    float error = 0.0f; // distance to LOD 0, in position units
+    u32 firstMeshlet = 0; // in FBXMesh::m_meshlets
+    u32 meshletCount = 0;
+};
+// Triangles of one material partition, indices are relative to the mesh vertices
+struct FBXSubMesh
+{
+    static constexpr u32 MaxLodCount = 5;
+
+    u32 firstIndex = 0; // every LOD, back to back
+    u32 indexCount = 0;
+    int materialIndex = -1; // in FBXScene::materials
+    u32 firstMeshlet = 0; // in FBXMesh::m_meshlets, every LOD
+    u32 meshletCount = 0;
+    FBXLod lods[MaxLodCount];
+    u32 lodCount = 1;
 };
-
 struct FBXMesh
 {
     std::vector<FBXVertex> m_vertices;
-    std::vector<u32> m_indices;
-
-    int materialIndex = -1;
+    std::vector<u32> m_indices; // triangle list
+    std::vector<FBXSubMesh> m_subMeshes;
+    std::vector<MeshOptimizer::Meshlet> m_meshlets; // firstIndex is relative to m_indices
 };
 struct FBXMaterial
 {
+    std::string name;
     std::string diffuse;
     std::string normal;
     std::string specular;
     std::string glossiness;
 };
+// Placement of a mesh: nodes sharing a geometry share one FBXMesh and get one instance each
+struct FBXInstance
+{
+    u32 mesh = 0; // in FBXScene::meshes
+    glm::mat4 transform{ 1.0f }; // node global transform, geometric transform included
+};
 struct FBXScene
 {
     std::string filePath;
     std::vector<FBXMesh> meshes;
-    //std::vector<FBXMaterial> materials;
+    std::vector<FBXMaterial> materials;
+    std::vector<FBXInstance> instances; // sorted by mesh, every mesh has at least one
 };
 
 class FBXHelper
 {
 public:
-    static void loadFBX(FBXScene& _fbx);
+    // Per mesh stage statistics, timed per job: they overlap across meshes
+    struct MeshStatistics
+    {
+        u32 corners = 0;
+        u32 vertices = 0;
+        u32 lods = 0;
+        u32 subMeshes = 0;
+        size_t meshlets = 0;
+        u32 tangentSplits = 0;
+        float weldTime = 0.0f;
+        float tangentTime = 0.0f;
+        float optimizeTime = 0.0f;
+        MeshOptimizer::VertexCacheStatistics before, after;
+    };
+
+    // FBX or OBJ (see OBJHelper) from the file extension, same contract as loadFBX
+    static void loadScene(FBXScene& _scene, JobSystem* _jobSystem = nullptr, const std::function<void(u32)>& _meshReady = nullptr);
+    // _jobSystem is handed to openFBX as its job processor, nullptr parses on the calling thread.
+    // Mesh nodes sharing a geometry and its materials are imported once, each node becomes an instance of it.
+    // Instances are final before the first mesh job starts.
+    // Once openFBX is done every mesh goes through weld, optimize, LODs and meshlets as its own job,
+    // _meshReady(meshIndex) is called from that job as soon as the mesh is final, in any order.
+    // The callback may take the mesh data, loadFBX does not read a mesh after handing it out.
+    static void loadFBX(FBXScene& _fbx, JobSystem* _jobSystem = nullptr, const std::function<void(u32)>& _meshReady = nullptr);
+
+    // Merge the polygon corners sharing the same (position, normal, uv) into _mesh vertices,
+    // _cornerToVertex gets one vertex index per corner. Corners of point and line polygons are not welded.
+    static void weldCorners(FBXMesh& _mesh, std::vector<u32>& _cornerToVertex, const ofbx::GeometryData& _geometry, JobSystem* _jobSystem);
+    // Vertex cache and overdraw ordering of every submesh, then vertex fetch ordering of the mesh.
+    // Cache statistics are accumulated in _before/_after.
+    static void optimizeMesh(FBXMesh& _mesh, MeshOptimizer::VertexCacheStatistics& _before, MeshOptimizer::VertexCacheStatistics& _after);
+    // Append the simplified LODs after LOD 0 of every submesh, each LOD halves the triangle count
+    static void buildLods(FBXMesh& _mesh);
+    // Meshlets of every submesh LOD, run once the index order is final
+    static void buildMeshlets(FBXMesh& _mesh);
+    // Stages shared by every importer once a mesh is welded: tangents, optimize, LODs and meshlets
+    static void finishMesh(FBXMesh& _mesh, MeshStatistics& _statistics, JobSystem* _jobSystem);
+    static void logStatistics(const std::vector<MeshStatistics>& _statistics, float _importTime);
+    static int findOrAddMaterial(FBXScene& _fbx, const ofbx::Material* _material, std::unordered_map<ofbx::u64, int>& _materialIndices);
 
     static std::string getCachePath(FBXScene& _fbx)
     {
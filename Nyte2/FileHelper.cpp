@@ -2,6 +2,23 @@
 
 #include <fstream>
 #include <stdexcept>
+#include <utility>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -30,6 +47,220 @@ std::vector<octet> FileHelper::readFile(const std::string& _filePath)
     return buffer;
 }
 
+bool FileHelper::writeFile(const std::string& _filePath, const void* _data, size_t _size)
+{
+    return writeFile(_filePath, nullptr, 0, _data, _size);
+}
+
+bool FileHelper::writeFile(const std::string& _filePath, const void* _prefix, size_t _prefixSize, const void* _data, size_t _size)
+{
+    std::string tmpPath = _filePath + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        file.write((const char*)_prefix, _prefixSize);
+        file.write((const char*)_data, _size);
+        if (!file.good())
+            return false;
+    }
+
+    std::remove(_filePath.c_str());
+    return std::rename(tmpPath.c_str(), _filePath.c_str()) == 0;
+}
+
+std::string FileHelper::lowerExtension(const std::string& _filePath)
+{
+    std::string extension = std::filesystem::path(_filePath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char _c) { return (char)std::tolower(_c); });
+    return extension;
+}
+
+MappedFile FileHelper::mapFile(const std::string& _filePath)
+{
+    MappedFile file;
+    file.map(_filePath);
+    return file;
+}
+
+MappedFile::MappedFile(MappedFile&& _other) noexcept
+{
+    *this = std::move(_other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& _other) noexcept
+{
+    if (this != &_other)
+    {
+        unmap();
+        m_path = std::move(_other.m_path);
+        m_data = std::exchange(_other.m_data, nullptr);
+        m_size = std::exchange(_other.m_size, 0);
+    }
+    return *this;
+}
+
+void MappedFile::map(const std::string& _filePath)
+{
+    unmap();
+    m_path = _filePath;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(_filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error(std::string{ "Failed to open file: " } + _filePath);
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    m_size = (size_t)fileSize.QuadPart;
+    if (m_size == 0)
+    {
+        CloseHandle(file);
+        return;
+    }
+
+    // the view keeps the mapping and the file alive, both handles can be closed right away
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+        throw std::runtime_error(std::string{ "Failed to map file: " } + _filePath);
+
+    m_data = (const octet*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (m_data == nullptr)
+        throw std::runtime_error(std::string{ "Failed to map file: " } + _filePath);
+#else
+    int file = open(_filePath.c_str(), O_RDONLY);
+    if (file < 0)
+        throw std::runtime_error(std::string{ "Failed to open file: " } + _filePath);
+
+    struct stat fileStat;
+    fstat(file, &fileStat);
+    m_size = (size_t)fileStat.st_size;
+    if (m_size == 0)
+    {
+        close(file);
+        return;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+        throw std::runtime_error(std::string{ "Failed to map file: " } + _filePath);
+
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = (const octet*)data;
+#endif
+}
+
+void MappedFile::unmap()
+{
+    if (m_data)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap((void*)m_data, m_size);
+#endif
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+namespace
+{
+    constexpr u64 PRIME64_1 = 0x9E3779B185EBCA87ull;
+    constexpr u64 PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr u64 PRIME64_3 = 0x165667B19E3779F9ull;
+    constexpr u64 PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+    constexpr u64 PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+    inline u64 rotl64(u64 _x, int _r) { return (_x << _r) | (_x >> (64 - _r)); }
+    inline u64 read64(const u8* _p) { u64 v; memcpy(&v, _p, sizeof(v)); return v; }
+    inline u32 read32(const u8* _p) { u32 v; memcpy(&v, _p, sizeof(v)); return v; }
+
+    inline u64 round64(u64 _acc, u64 _input)
+    {
+        _acc += _input * PRIME64_2;
+        _acc = rotl64(_acc, 31);
+        return _acc * PRIME64_1;
+    }
+    inline u64 mergeRound64(u64 _acc, u64 _value)
+    {
+        _acc ^= round64(0, _value);
+        return _acc * PRIME64_1 + PRIME64_4;
+    }
+}
+
+u64 FileHelper::hash64(const void* _data, size_t _size, u64 _seed)
+{
+    const u8* p = (const u8*)_data;
+    const u8* end = p + _size;
+    u64 hash;
+
+    if (_size >= 32)
+    {
+        u64 v1 = _seed + PRIME64_1 + PRIME64_2;
+        u64 v2 = _seed + PRIME64_2;
+        u64 v3 = _seed;
+        u64 v4 = _seed - PRIME64_1;
+
+        const u8* limit = end - 32;
+        do
+        {
+            v1 = round64(v1, read64(p)); p += 8;
+            v2 = round64(v2, read64(p)); p += 8;
+            v3 = round64(v3, read64(p)); p += 8;
+            v4 = round64(v4, read64(p)); p += 8;
+        } while (p <= limit);
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = mergeRound64(hash, v1);
+        hash = mergeRound64(hash, v2);
+        hash = mergeRound64(hash, v3);
+        hash = mergeRound64(hash, v4);
+    }
+    else
+    {
+        hash = _seed + PRIME64_5;
+    }
+
+    hash += (u64)_size;
+
+    while (p + 8 <= end)
+    {
+        hash ^= round64(0, read64(p));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end)
+    {
+        hash ^= (u64)read32(p) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        hash ^= (*p) * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+        ++p;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+u64 FileHelper::hashFile(const std::string& _filePath)
+{
+    MappedFile file = mapFile(_filePath);
+    return hash64(file.data(), file.size());
+}
+
 void FileHelper::loadImage(RawImage& _image) 
 {
     stbi_uc* pixels = stbi_load(_image.path.c_str(), &_image.width, &_image.height, &_image.channels, STBI_rgb_alpha);
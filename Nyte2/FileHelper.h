@@ -5,6 +5,8 @@
 
 #include "tiny_obj_loader.h"
 
+#include "Common.h"
+
 using octet = char;
 
 struct RawImage
@@ -18,6 +20,28 @@ struct RawImage
     void* data;
 };
 
+// Read only memory mapped view of a file, pages are loaded on first access.
+// The view is unmapped when the MappedFile is destroyed.
+struct MappedFile
+{
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& _other) noexcept;
+    MappedFile& operator=(MappedFile&& _other) noexcept;
+    ~MappedFile() { unmap(); }
+
+    void map(const std::string& _filePath);
+    void unmap();
+
+    const octet* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    std::string m_path;
+    const octet* m_data = nullptr;
+    size_t m_size = 0;
+};
+
 struct RawObj
 {
     std::string path;
@@ -30,6 +54,17 @@ class FileHelper
 {
 public:
     static std::vector<octet> readFile(const std::string& _filePath);
+    // Written to a temporary file renamed over _filePath, a crash never leaves half of it behind. Returns false if it can't be written.
+    static bool writeFile(const std::string& _filePath, const void* _data, size_t _size);
+    // Same, _prefix is written first (a file header in front of a payload the caller already holds)
+    static bool writeFile(const std::string& _filePath, const void* _prefix, size_t _prefixSize, const void* _data, size_t _size);
+    static MappedFile mapFile(const std::string& _filePath);
+    // ".JPG" -> ".jpg", file types are told by their extension whatever its case
+    static std::string lowerExtension(const std::string& _filePath);
+
+    // 64 bit content hash (xxHash64), used to detect stale caches
+    static u64 hash64(const void* _data, size_t _size, u64 _seed = 0);
+    static u64 hashFile(const std::string& _filePath);
     static void loadImage(RawImage& _image);
     static void unloadImage(RawImage& _image);
     
@@ -0,0 +1,204 @@
+#include "FileWatcher.h"
+
+#include <stdexcept>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr int WaitMilliseconds = 100; // stop() latency of the watch thread
+}
+
+void FileWatcher::changed(const std::string& _path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changes[_path] = std::chrono::steady_clock::now();
+}
+
+std::vector<std::string> FileWatcher::poll(std::chrono::milliseconds _settle)
+{
+    std::vector<std::string> paths;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto change = m_changes.begin(); change != m_changes.end();)
+    {
+        if (now - change->second < _settle)
+        {
+            ++change;
+            continue;
+        }
+        paths.push_back(change->first);
+        change = m_changes.erase(change);
+    }
+    return paths;
+}
+
+#ifdef _WIN32
+
+void FileWatcher::start(const std::string& _directory)
+{
+    stop();
+    m_directory = std::filesystem::path(_directory).lexically_normal().generic_string();
+
+    HANDLE directory = CreateFileA(m_directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (directory == INVALID_HANDLE_VALUE)
+        throw std::runtime_error(std::string{ "Failed to watch directory: " } + _directory);
+
+    m_directoryHandle = directory;
+    m_stop = false;
+    m_thread = std::thread(&FileWatcher::watchLoop, this);
+}
+
+void FileWatcher::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_stop = true;
+    m_thread.join();
+    CloseHandle((HANDLE)m_directoryHandle);
+    m_directoryHandle = nullptr;
+}
+
+void FileWatcher::watchLoop()
+{
+    HANDLE directory = (HANDLE)m_directoryHandle;
+    alignas(DWORD) u8 buffer[64 * 1024];
+    OVERLAPPED overlapped{};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+    while (!m_stop)
+    {
+        ResetEvent(overlapped.hEvent);
+        if (!ReadDirectoryChangesW(directory, buffer, sizeof(buffer), TRUE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE, nullptr, &overlapped, nullptr))
+            break;
+
+        DWORD bytes = 0;
+        while (!m_stop && WaitForSingleObject(overlapped.hEvent, WaitMilliseconds) == WAIT_TIMEOUT) {}
+        if (m_stop)
+        {
+            CancelIoEx(directory, &overlapped);
+            GetOverlappedResult(directory, &overlapped, &bytes, TRUE);
+            break;
+        }
+        // 0 bytes: the buffer overflowed, those changes are lost
+        if (!GetOverlappedResult(directory, &overlapped, &bytes, FALSE) || bytes == 0)
+            continue;
+
+        for (const u8* record = buffer;;)
+        {
+            const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)record;
+            if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+            {
+                std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                changed((std::filesystem::path(m_directory) / name).generic_string());
+            }
+            if (info->NextEntryOffset == 0)
+                break;
+            record += info->NextEntryOffset;
+        }
+    }
+    CloseHandle(overlapped.hEvent);
+}
+
+#else
+
+void FileWatcher::addWatches(const std::string& _directory)
+{
+    const u32 mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR;
+    int watch = inotify_add_watch(m_inotify, _directory.c_str(), mask);
+    if (watch >= 0)
+        m_watches[watch] = _directory;
+
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(_directory, error))
+    {
+        if (!entry.is_directory())
+            continue;
+        std::string directory = entry.path().generic_string();
+        watch = inotify_add_watch(m_inotify, directory.c_str(), mask);
+        if (watch >= 0)
+            m_watches[watch] = directory;
+    }
+}
+
+void FileWatcher::start(const std::string& _directory)
+{
+    stop();
+    m_directory = std::filesystem::path(_directory).lexically_normal().generic_string();
+
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0)
+        throw std::runtime_error(std::string{ "Failed to watch directory: " } + _directory);
+
+    addWatches(m_directory);
+    if (m_watches.empty())
+    {
+        close(m_inotify);
+        m_inotify = -1;
+        throw std::runtime_error(std::string{ "Failed to watch directory: " } + _directory);
+    }
+
+    m_stop = false;
+    m_thread = std::thread(&FileWatcher::watchLoop, this);
+}
+
+void FileWatcher::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_stop = true;
+    m_thread.join();
+    close(m_inotify); // drops every watch
+    m_inotify = -1;
+    m_watches.clear();
+}
+
+void FileWatcher::watchLoop()
+{
+    alignas(inotify_event) char buffer[64 * 1024];
+    pollfd descriptor{ m_inotify, POLLIN, 0 };
+
+    while (!m_stop)
+    {
+        if (::poll(&descriptor, 1, WaitMilliseconds) <= 0)
+            continue;
+
+        ssize_t bytes = read(m_inotify, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < bytes;)
+        {
+            const inotify_event* event = (const inotify_event*)(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto directory = m_watches.find(event->wd);
+            if (directory == m_watches.end() || event->len == 0)
+                continue;
+
+            std::string path = directory->second + "/" + event->name;
+            if (event->mask & IN_ISDIR)
+            {
+                // a new directory may already hold files, they are reported when written again
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    addWatches(path);
+                continue;
+            }
+            // IN_CREATE alone is an empty file, its content comes with IN_CLOSE_WRITE
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                changed(path);
+        }
+    }
+}
+
+#endif
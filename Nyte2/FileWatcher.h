@@ -0,0 +1,48 @@
+#pragma once
+
+// stl
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "Common.h"
+
+// Recursive watch of a directory tree, change notifications are gathered on a background thread and polled.
+// inotify on Linux (one watch per directory, new directories are picked up), ReadDirectoryChangesW on Windows.
+class FileWatcher
+{
+public:
+    ~FileWatcher() { stop(); }
+
+    // Throws when the directory can't be watched
+    void start(const std::string& _directory);
+    void stop();
+    bool isWatching() const { return m_thread.joinable(); }
+
+    // Files written, created or moved in since the last poll, named like _directory/<relative path> with '/' separators.
+    // A file is reported once it has been quiet for _settle, editors and exporters write in several steps.
+    std::vector<std::string> poll(std::chrono::milliseconds _settle = std::chrono::milliseconds(200));
+
+private:
+    void watchLoop();
+    void changed(const std::string& _path);
+
+    std::string m_directory;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{ false };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> m_changes; // path -> last notification
+
+#ifdef _WIN32
+    void* m_directoryHandle = nullptr; // HANDLE
+#else
+    int m_inotify = -1;
+    std::unordered_map<int, std::string> m_watches; // watch descriptor -> directory
+    void addWatches(const std::string& _directory);
+#endif
+};
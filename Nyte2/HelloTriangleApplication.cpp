@@ -19,6 +19,9 @@ void HelloTriangleApplication::run()
     m_engine.createInstance(getGLFWRequiredExtensions());
     createWindowSurface(m_engine.getInstance());
     m_engine.setSurface(&m_windowSurface);
+#if _DEBUG
+    m_engine.setWatchAssets(true); // edited models and textures are hot reloaded
+#endif
     m_engine.init();
 
     mainLoop();
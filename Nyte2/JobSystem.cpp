@@ -0,0 +1,117 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+void JobSystem::init(u32 _threadCount)
+{
+    deinit();
+
+    if (_threadCount == 0)
+        _threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    m_stop = false;
+    // the caller is the first thread
+    for (u32 i = 1; i < _threadCount; ++i)
+        m_workers.emplace_back(&JobSystem::workerLoop, this);
+}
+
+void JobSystem::deinit()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+    m_batches.clear();
+}
+
+void JobSystem::parallelFor(u32 _count, const std::function<void(u32)>& _job)
+{
+    if (_count == 0)
+        return;
+
+    if (m_workers.empty() || _count == 1)
+    {
+        for (u32 i = 0; i < _count; ++i)
+            _job(i);
+        return;
+    }
+
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->job = &_job;
+    batch->count = _count;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_batches.push_back(batch);
+    }
+    m_wakeCondition.notify_all();
+
+    runBatch(*batch);
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_doneCondition.wait(lock, [&]() { return batch->done.load() == batch->count; });
+
+        auto it = std::find(m_batches.begin(), m_batches.end(), batch);
+        if (it != m_batches.end())
+            m_batches.erase(it);
+    }
+
+    if (batch->exception)
+        std::rethrow_exception(batch->exception);
+}
+
+void JobSystem::workerLoop()
+{
+    for (;;)
+    {
+        std::shared_ptr<Batch> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCondition.wait(lock, [&]() { return m_stop || !m_batches.empty(); });
+            if (m_stop)
+                return;
+
+            batch = m_batches.front();
+            if (batch->next.load() >= batch->count)
+            {
+                // every index is already taken, the owner waits for the last ones
+                m_batches.pop_front();
+                continue;
+            }
+        }
+        runBatch(*batch);
+    }
+}
+
+void JobSystem::runBatch(Batch& _batch)
+{
+    for (;;)
+    {
+        u32 i = _batch.next.fetch_add(1);
+        if (i >= _batch.count)
+            return;
+
+        try
+        {
+            (*_batch.job)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(_batch.exceptionMutex);
+            if (!_batch.exception)
+                _batch.exception = std::current_exception();
+        }
+
+        if (_batch.done.fetch_add(1) + 1 == _batch.count)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_doneCondition.notify_all();
+        }
+    }
+}
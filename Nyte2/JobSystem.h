@@ -0,0 +1,55 @@
+#pragma once
+
+// stl
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+#include "Common.h"
+
+// Fixed size worker pool.
+// The thread submitting work always takes part in it, so nested parallelFor calls can't deadlock.
+class JobSystem
+{
+public:
+    ~JobSystem() { deinit(); }
+
+    void init(u32 _threadCount = 0); // 0 = std::thread::hardware_concurrency()
+    void deinit();
+
+    // workers + calling thread
+    u32 getThreadCount() const { return (u32)m_workers.size() + 1; }
+
+    // Run _job(i) for every i in [0, _count) and wait for all of them.
+    // The first exception thrown by a job is rethrown here.
+    void parallelFor(u32 _count, const std::function<void(u32)>& _job);
+
+private:
+    struct Batch
+    {
+        const std::function<void(u32)>* job = nullptr;
+        u32 count = 0;
+        std::atomic<u32> next{ 0 };
+        std::atomic<u32> done{ 0 };
+
+        std::mutex exceptionMutex;
+        std::exception_ptr exception;
+    };
+
+    void workerLoop();
+    void runBatch(Batch& _batch);
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::shared_ptr<Batch>> m_batches;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    bool m_stop = false;
+};
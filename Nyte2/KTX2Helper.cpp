@@ -0,0 +1,249 @@
+#include "KTX2Helper.h"
+
+#include <cstring>
+#include <numeric>
+
+// vulkan
+#include "vulkan/vulkan_core.h"
+
+#include "MipGenerator.h"
+
+using namespace AssetArchiveFormat;
+
+namespace
+{
+    constexpr u8 Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A }; // «KTX 20»\r\n\x1A\n
+
+#pragma pack(push, 4)
+    struct FileHeader
+    {
+        u32 vkFormat;
+        u32 typeSize;
+        u32 pixelWidth;
+        u32 pixelHeight;
+        u32 pixelDepth; // 0 for 2D
+        u32 layerCount; // 0 when not an array
+        u32 faceCount;
+        u32 levelCount;
+        u32 supercompressionScheme;
+
+        // index
+        u32 dfdByteOffset;
+        u32 dfdByteLength;
+        u32 kvdByteOffset;
+        u32 kvdByteLength;
+        u64 sgdByteOffset;
+        u64 sgdByteLength;
+    };
+#pragma pack(pop)
+    static_assert(sizeof(FileHeader) == 68, "KTX2 header and index are 68 bytes after the identifier");
+
+    struct Level
+    {
+        u64 byteOffset;
+        u64 byteLength;
+        u64 uncompressedByteLength;
+    };
+
+    constexpr u64 LevelIndexOffset = sizeof(Identifier) + sizeof(FileHeader);
+
+    // Khronos data format descriptor, basic block
+    constexpr u32 ModelRGBSDA = 1;
+    constexpr u32 ModelBC1A = 128;
+    constexpr u32 ModelBC4 = 131;
+    constexpr u32 ModelBC5 = 132;
+    constexpr u32 ModelBC7 = 134;
+    constexpr u32 PrimariesBT709 = 1;
+    constexpr u32 TransferLinear = 1;
+    constexpr u32 TransferSRGB = 2;
+    constexpr u32 SampleLinear = 0x10; // channel type qualifier, alpha of sRGB formats
+
+    struct Sample
+    {
+        u32 bitOffset;
+        u32 bitLength;
+        u32 channelType;
+        u32 upper;
+    };
+
+    // Basic descriptor block of a supported format, the dfdTotalSize word first
+    std::vector<u32> dataFormatDescriptor(u32 _format)
+    {
+        u32 blockSize, blockBytes;
+        KTX2Helper::blockInfo(_format, blockSize, blockBytes);
+
+        u32 model = ModelRGBSDA;
+        std::vector<Sample> samples;
+        switch (_format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            model = ModelBC1A;
+            samples = { { 0, 64, 0, ~0u } };
+            break;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            model = ModelBC4;
+            samples = { { 0, 64, 0, ~0u } };
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            model = ModelBC5;
+            samples = { { 0, 64, 0, ~0u }, { 64, 64, 1, ~0u } };
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            model = ModelBC7;
+            samples = { { 0, 128, 0, ~0u } };
+            break;
+        default:
+            samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, 15 | (KTX2Helper::isSrgb(_format) ? SampleLinear : 0), 255 } };
+            break;
+        }
+
+        u32 blockDimension = blockSize - 1;
+        u32 descriptorBlockSize = 24 + 16 * (u32)samples.size();
+        std::vector<u32> words = {
+            4 + descriptorBlockSize,
+            0, // vendor and descriptor type: Khronos basic
+            2 | (descriptorBlockSize << 16), // version 1.3
+            model | (PrimariesBT709 << 8) | ((KTX2Helper::isSrgb(_format) ? TransferSRGB : TransferLinear) << 16),
+            blockDimension | (blockDimension << 8),
+            blockBytes, // bytes of plane 0
+            0,
+        };
+        for (const Sample& sample : samples)
+        {
+            words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channelType << 24));
+            words.push_back(0); // sample position
+            words.push_back(0); // lower
+            words.push_back(sample.upper);
+        }
+        return words;
+    }
+}
+
+bool KTX2Helper::blockInfo(u32 _format, u32& _blockSize, u32& _blockBytes)
+{
+    switch (_format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        _blockSize = 1;
+        _blockBytes = 4;
+        return true;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        _blockSize = 4;
+        _blockBytes = 8;
+        return true;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        _blockSize = 4;
+        _blockBytes = 16;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool KTX2Helper::isSrgb(u32 _format)
+{
+    return _format == VK_FORMAT_R8G8B8A8_SRGB || _format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || _format == VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+u64 KTX2Helper::levelSize(u32 _format, u32 _width, u32 _height)
+{
+    u32 blockSize, blockBytes;
+    if (!blockInfo(_format, blockSize, blockBytes))
+        return 0;
+    return (u64)((_width + blockSize - 1) / blockSize) * ((_height + blockSize - 1) / blockSize) * blockBytes;
+}
+
+u64 KTX2Helper::layout(TextureHeader& _header)
+{
+    u32 blockSize, blockBytes;
+    blockInfo(_header.format, blockSize, blockBytes);
+    const u64 alignment = std::lcm((u64)blockBytes, (u64)4);
+
+    u64 offset = LevelIndexOffset + sizeof(Level) * _header.mipLevels + dataFormatDescriptor(_header.format).size() * sizeof(u32);
+    for (u32 level = _header.mipLevels; level-- > 0;)
+    {
+        Mip& mip = _header.mips[level];
+        mip.width = MipGenerator::mipSize(_header.width, level);
+        mip.height = MipGenerator::mipSize(_header.height, level);
+        mip.size = levelSize(_header.format, mip.width, mip.height);
+        mip.offset = (offset + alignment - 1) / alignment * alignment;
+        offset = mip.offset + mip.size;
+    }
+    return offset;
+}
+
+void KTX2Helper::writeHeader(const TextureHeader& _header, u8* _file)
+{
+    std::vector<u32> descriptor = dataFormatDescriptor(_header.format);
+    u32 dfdByteOffset = (u32)(LevelIndexOffset + sizeof(Level) * _header.mipLevels);
+
+    FileHeader header{};
+    header.vkFormat = _header.format;
+    header.typeSize = 1; // block formats and 8 bit channels
+    header.pixelWidth = _header.width;
+    header.pixelHeight = _header.height;
+    header.faceCount = 1;
+    header.levelCount = _header.mipLevels;
+    header.dfdByteOffset = dfdByteOffset;
+    header.dfdByteLength = (u32)(descriptor.size() * sizeof(u32));
+
+    memcpy(_file, Identifier, sizeof(Identifier));
+    memcpy(_file + sizeof(Identifier), &header, sizeof(header));
+    for (u32 level = 0; level < _header.mipLevels; ++level)
+    {
+        Level entry{ _header.mips[level].offset, _header.mips[level].size, _header.mips[level].size };
+        memcpy(_file + LevelIndexOffset + sizeof(Level) * level, &entry, sizeof(entry));
+    }
+    memcpy(_file + dfdByteOffset, descriptor.data(), header.dfdByteLength);
+
+    // mip padding
+    u64 end = dfdByteOffset + header.dfdByteLength;
+    memset(_file + end, 0, (size_t)(_header.mips[_header.mipLevels - 1].offset - end));
+    for (u32 level = _header.mipLevels - 1; level-- > 0;)
+    {
+        end = _header.mips[level + 1].offset + _header.mips[level + 1].size;
+        memset(_file + end, 0, (size_t)(_header.mips[level].offset - end));
+    }
+}
+
+bool KTX2Helper::read(const octet* _data, u64 _size, TextureHeader& _header)
+{
+    if (_size < LevelIndexOffset || memcmp(_data, Identifier, sizeof(Identifier)) != 0)
+        return false;
+
+    FileHeader header;
+    memcpy(&header, _data + sizeof(Identifier), sizeof(header));
+    u32 blockSize, blockBytes;
+    if (!blockInfo(header.vkFormat, blockSize, blockBytes) || header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1
+        || header.faceCount != 1 || header.supercompressionScheme != 0 || header.levelCount == 0 || header.levelCount > MaxMipLevels
+        || LevelIndexOffset + sizeof(Level) * header.levelCount > _size)
+        return false;
+
+    _header = TextureHeader{};
+    _header.width = header.pixelWidth;
+    _header.height = header.pixelHeight;
+    _header.format = header.vkFormat;
+    _header.mipLevels = header.levelCount;
+    for (u32 level = 0; level < header.levelCount; ++level)
+    {
+        Level entry;
+        memcpy(&entry, _data + LevelIndexOffset + sizeof(Level) * level, sizeof(entry));
+
+        Mip& mip = _header.mips[level];
+        mip.width = MipGenerator::mipSize(header.pixelWidth, level);
+        mip.height = MipGenerator::mipSize(header.pixelHeight, level);
+        mip.offset = entry.byteOffset;
+        mip.size = entry.byteLength;
+        // vkCmdCopyBufferToImage reads from a multiple of the block size
+        if (mip.size != levelSize(header.vkFormat, mip.width, mip.height) || mip.offset % blockBytes != 0 || mip.offset + mip.size > _size)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// stl
+#include <vector>
+
+#include "Common.h"
+#include "FileHelper.h"
+#include "AssetArchive.h"
+
+// KTX 2.0 textures (Khronos), the cooked texture blob and a source format of its own.
+//
+//  identifier, header, index
+//  level index, mip 0 first
+//  data format descriptor
+//  levels, from the smallest one to mip 0, each aligned on lcm(block size, 4)
+//
+// Only what the engine uploads as is: 2D, one layer and face, no supercompression, RGBA8 or BC1/BC4/BC5/BC7.
+class KTX2Helper
+{
+public:
+    // Texel block of a supported VkFormat, false for the others
+    static bool blockInfo(u32 _format, u32& _blockSize, u32& _blockBytes);
+    static u64 levelSize(u32 _format, u32 _width, u32 _height);
+    static bool isSrgb(u32 _format);
+
+    // Fills the mips of _header (width, height, format and mipLevels set) with their file offsets and sizes, returns the file size
+    static u64 layout(AssetArchiveFormat::TextureHeader& _header);
+    // Everything before the levels, _file is layout(_header) bytes
+    static void writeHeader(const AssetArchiveFormat::TextureHeader& _header, u8* _file);
+
+    // Mip offsets of _header are from the start of _data. Returns false when the file is not a texture the engine uploads as is.
+    static bool read(const octet* _data, u64 _size, AssetArchiveFormat::TextureHeader& _header);
+};
@@ -0,0 +1,195 @@
+#include "MeshBuilder.h"
+
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+    MeshCacheFormat::Instance toInstance(const glm::mat4& _transform)
+    {
+        // glm is column major, the rows are the transposed columns
+        MeshCacheFormat::Instance instance;
+        for (u32 r = 0; r < 3; ++r)
+            for (u32 c = 0; c < 4; ++c)
+                instance.rows[r][c] = _transform[c][r];
+        return instance;
+    }
+}
+
+MeshCacheFormat::Layout MeshBuilder::layout(VertexFormat _vertexFormat)
+{
+    if (_vertexFormat == VertexFormat::Packed16)
+    {
+        const VertexPacked::VertexInputAttributDescriptions attributes = VertexPacked::getAttributeDescriptions();
+        return MeshCache::makeLayout(VertexPacked::getBindingDescription(), attributes.data(), (u32)attributes.size());
+    }
+    const Vertex::VertexInputAttributDescriptions attributes = Vertex::getAttributeDescriptions();
+    return MeshCache::makeLayout(Vertex::getBindingDescription(), attributes.data(), (u32)attributes.size());
+}
+
+void MeshBuilder::convert(const FBXMesh& _mesh, ConvertedMesh& _converted) const
+{
+    // Packed positions are quantized over the mesh bounds, a flat axis keeps a unit scale
+    glm::vec3 positionScale(1.0f);
+    glm::vec3 positionOffset(0.0f);
+    if (m_vertexFormat == VertexFormat::Packed16 && !_mesh.m_vertices.empty())
+    {
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+        for (const FBXVertex& v : _mesh.m_vertices)
+        {
+            boundsMin = glm::min(boundsMin, v.pos);
+            boundsMax = glm::max(boundsMax, v.pos);
+        }
+        glm::vec3 extent = boundsMax - boundsMin;
+        positionScale = glm::vec3(extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f, extent.z > 0.0f ? extent.z : 1.0f);
+        positionOffset = boundsMin;
+
+        _converted.packedVertices.resize(_mesh.m_vertices.size());
+        for (size_t v = 0; v < _mesh.m_vertices.size(); ++v)
+            _converted.packedVertices[v] = VertexPacked::pack(_mesh.m_vertices[v], positionScale, positionOffset);
+    }
+
+    // A submesh goes 16 bit when its largest index fits.
+    // Ranges are aligned on their own index size so firstIndex stays exact in those units.
+    _converted.indexData.reserve(_mesh.m_indices.size() * sizeof(u32));
+    for (const FBXSubMesh& subMesh : _mesh.m_subMeshes)
+    {
+        const u32* indices = _mesh.m_indices.data() + subMesh.firstIndex;
+        u32 maxIndex = 0;
+        for (u32 i = 0; i < subMesh.indexCount; ++i)
+            maxIndex = std::max(maxIndex, indices[i]);
+
+        bool fits16 = maxIndex <= std::numeric_limits<u16>::max();
+        u32 indexSize = fits16 ? sizeof(u16) : sizeof(u32);
+        size_t rangeOffset = (_converted.indexData.size() + indexSize - 1) / indexSize * indexSize;
+        _converted.indexData.resize(rangeOffset + (size_t)subMesh.indexCount * indexSize);
+        if (fits16)
+        {
+            u16* indices16 = (u16*)(_converted.indexData.data() + rangeOffset);
+            for (u32 i = 0; i < subMesh.indexCount; ++i)
+                indices16[i] = (u16)indices[i];
+        }
+        else
+        {
+            memcpy(_converted.indexData.data() + rangeOffset, indices, (size_t)subMesh.indexCount * indexSize);
+        }
+
+        MeshCacheFormat::SubMesh converted{ (u32)(rangeOffset / indexSize), subMesh.indexCount, 0, (u32)_mesh.m_vertices.size(), subMesh.materialIndex, indexSize,
+            { positionScale.x, positionScale.y, positionScale.z },
+            { positionOffset.x, positionOffset.y, positionOffset.z },
+            (u32)_converted.meshlets.size(), subMesh.meshletCount, subMesh.lodCount };
+
+        // LODs and meshlets move with their submesh range, the last LOD meshlets stay drawn past it
+        for (u32 l = 0; l < subMesh.lodCount; ++l)
+        {
+            const FBXLod& lod = subMesh.lods[l];
+            converted.lods[l] = { converted.firstIndex + (lod.firstIndex - subMesh.firstIndex), lod.indexCount, lod.error };
+
+            for (u32 m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; ++m)
+            {
+                const MeshOptimizer::Meshlet& source = _mesh.m_meshlets[m];
+                MeshCacheFormat::Meshlet meshlet{};
+                memcpy(meshlet.center, source.center, sizeof(meshlet.center));
+                meshlet.radius = source.radius;
+                memcpy(meshlet.coneAxis, source.coneAxis, sizeof(meshlet.coneAxis));
+                meshlet.coneCutoff = source.coneCutoff;
+                meshlet.firstIndex = converted.firstIndex + (source.firstIndex - subMesh.firstIndex);
+                meshlet.indexCount = source.indexCount;
+                meshlet.subMesh = (u16)_converted.subMeshes.size();
+                meshlet.firstLod = (u8)l;
+                meshlet.lastLod = (u8)(l + 1 == subMesh.lodCount ? MeshCacheFormat::MaxLodCount - 1 : l);
+                _converted.meshlets.push_back(meshlet);
+            }
+        }
+        _converted.subMeshes.push_back(converted);
+    }
+}
+
+void MeshBuilder::pool(FBXScene& _fbx, u32 _mesh, ConvertedMesh& _converted)
+{
+    FBXMesh& mesh = _fbx.meshes[_mesh];
+    i32 vertexOffset = (i32)vertexCount();
+    if (m_vertexFormat == VertexFormat::Packed16)
+        m_packedVertices.insert(m_packedVertices.end(), _converted.packedVertices.begin(), _converted.packedVertices.end());
+    else
+        m_vertices.insert(m_vertices.end(), mesh.m_vertices.begin(), mesh.m_vertices.end());
+
+    // a 4 bytes aligned base keeps every range aligned on its index size
+    size_t indexBase = (m_indexData.size() + sizeof(u32) - 1) / sizeof(u32) * sizeof(u32);
+    m_indexData.resize(indexBase + _converted.indexData.size());
+    memcpy(m_indexData.data() + indexBase, _converted.indexData.data(), _converted.indexData.size());
+
+    // a scene without placements draws every mesh once, where it was modeled
+    u32 firstInstance = (u32)m_instances.size();
+    auto instances = std::equal_range(_fbx.instances.begin(), _fbx.instances.end(), FBXInstance{ _mesh }, [](const FBXInstance& _a, const FBXInstance& _b) { return _a.mesh < _b.mesh; });
+    if (instances.first == instances.second)
+        m_instances.push_back(toInstance(glm::mat4(1.0f)));
+    for (auto it = instances.first; it != instances.second; ++it)
+        m_instances.push_back(toInstance(it->transform));
+    u32 instanceCount = (u32)m_instances.size() - firstInstance;
+
+    u32 subMeshBase = (u32)m_subMeshes.size();
+    u32 meshletBase = (u32)m_meshlets.size();
+    for (MeshCacheFormat::Meshlet& meshlet : _converted.meshlets)
+    {
+        meshlet.firstIndex += (u32)(indexBase / _converted.subMeshes[meshlet.subMesh].indexSize);
+        meshlet.vertexOffset = vertexOffset;
+        meshlet.subMesh = (u16)(meshlet.subMesh + subMeshBase);
+        m_meshlets.push_back(meshlet);
+    }
+    for (MeshCacheFormat::SubMesh& subMesh : _converted.subMeshes)
+    {
+        u32 indexBaseUnits = (u32)(indexBase / subMesh.indexSize);
+        subMesh.firstIndex += indexBaseUnits;
+        for (u32 l = 0; l < subMesh.lodCount; ++l)
+            subMesh.lods[l].firstIndex += indexBaseUnits;
+        subMesh.vertexOffset = vertexOffset;
+        subMesh.firstMeshlet += meshletBase;
+        subMesh.firstInstance = firstInstance;
+        subMesh.instanceCount = instanceCount;
+        m_indexCount += subMesh.indexCount;
+        m_subMeshes16 += subMesh.indexSize == sizeof(u16) ? 1 : 0;
+        m_subMeshes.push_back(subMesh);
+    }
+
+    // the pool owns the mesh now
+    mesh = FBXMesh{};
+    _converted = ConvertedMesh{};
+}
+
+void MeshBuilder::addMesh(FBXScene& _fbx, u32 _mesh)
+{
+    ConvertedMesh converted;
+    convert(_fbx.meshes[_mesh], converted);
+    converted.ready = true;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_convertedMeshes.empty())
+        m_convertedMeshes.resize(_fbx.meshes.size());
+    m_convertedMeshes[_mesh] = std::move(converted);
+    for (; m_nextPooledMesh < m_convertedMeshes.size() && m_convertedMeshes[m_nextPooledMesh].ready; ++m_nextPooledMesh)
+        pool(_fbx, m_nextPooledMesh, m_convertedMeshes[m_nextPooledMesh]);
+}
+
+void MeshBuilder::addMeshes(FBXScene& _fbx)
+{
+    for (u32 m = 0; m < (u32)_fbx.meshes.size(); ++m)
+        addMesh(_fbx, m);
+}
+
+MeshCacheData MeshBuilder::cacheData(bool _compress) const
+{
+    MeshCacheData data;
+    data.vertices = vertexData();
+    data.vertexCount = vertexCount();
+    data.indices = m_indexData.data();
+    data.indexCount = m_indexCount;
+    data.indexDataSize = (u32)m_indexData.size();
+    data.subMeshes = m_subMeshes;
+    data.meshlets = m_meshlets;
+    data.instances = m_instances;
+    data.compress = _compress;
+    return data;
+}
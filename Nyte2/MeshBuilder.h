@@ -0,0 +1,64 @@
+#pragma once
+
+// stl
+#include <vector>
+#include <string>
+#include <mutex>
+
+#include "Common.h"
+#include "VertexModel.h"
+#include "FBXHelper.h"
+#include "MeshCache.h"
+
+// Pools the meshes of an imported scene in the layout the mesh cache stores and the engine uploads:
+// one vertex range per mesh, submesh index ranges with their own index size, meshlets and LODs rebased on the pool,
+// the instances of every mesh next to each other.
+// Shared by the engine import path and the asset cooker.
+class MeshBuilder
+{
+public:
+    explicit MeshBuilder(VertexFormat _vertexFormat) : m_vertexFormat(_vertexFormat) {}
+
+    // Cache variant and vertex layout of a format, shared by the cache files and the archive entries
+    static std::string variant(VertexFormat _vertexFormat) { return _vertexFormat == VertexFormat::Packed16 ? "packed" : ""; }
+    static MeshCacheFormat::Layout layout(VertexFormat _vertexFormat);
+
+    // Convert _fbx.meshes[_mesh], thread safe and in any order (meant for the FBXHelper::loadFBX callback).
+    // Meshes join the pool in mesh order, the FBXMesh data is released once pooled.
+    void addMesh(FBXScene& _fbx, u32 _mesh);
+    // Convert and pool every mesh of an already imported scene
+    void addMeshes(FBXScene& _fbx);
+
+    u32 vertexCount() const { return (u32)(m_vertexFormat == VertexFormat::Packed16 ? m_packedVertices.size() : m_vertices.size()); }
+    const void* vertexData() const { return m_vertexFormat == VertexFormat::Packed16 ? (const void*)m_packedVertices.data() : (const void*)m_vertices.data(); }
+
+    // Points into the builder, valid as long as it lives
+    MeshCacheData cacheData(bool _compress) const;
+
+    std::vector<Vertex> m_vertices; // Float32
+    std::vector<VertexPacked> m_packedVertices; // Packed16
+    std::vector<u8> m_indexData; // 16 and 32 bit ranges, each aligned on its own index size
+    u32 m_indexCount = 0;
+    std::vector<MeshCacheFormat::SubMesh> m_subMeshes;
+    std::vector<MeshCacheFormat::Meshlet> m_meshlets;
+    std::vector<MeshCacheFormat::Instance> m_instances; // in mesh order
+    u32 m_subMeshes16 = 0; // submeshes with 16 bit indices
+
+private:
+    struct ConvertedMesh
+    {
+        std::vector<VertexPacked> packedVertices; // Float32 vertices are pooled as welded
+        std::vector<u8> indexData;
+        std::vector<MeshCacheFormat::SubMesh> subMeshes; // firstIndex relative to indexData, vertexOffset 0
+        std::vector<MeshCacheFormat::Meshlet> meshlets; // firstIndex relative to indexData, vertexOffset 0, subMesh in subMeshes
+        bool ready = false;
+    };
+    void convert(const FBXMesh& _mesh, ConvertedMesh& _converted) const;
+    void pool(FBXScene& _fbx, u32 _mesh, ConvertedMesh& _converted); // m_mutex held
+
+    VertexFormat m_vertexFormat;
+
+    std::mutex m_mutex;
+    std::vector<ConvertedMesh> m_convertedMeshes;
+    u32 m_nextPooledMesh = 0;
+};
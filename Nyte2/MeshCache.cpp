@@ -0,0 +1,380 @@
+#include "MeshCache.h"
+#include "MeshCodec.h"
+#include "JobSystem.h"
+
+// openFBX
+#include "libdeflate.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+
+using namespace MeshCacheFormat;
+
+namespace
+{
+    // Decompressor and inflate scratch of a worker thread, reused by every chunk it decodes instead of one alloc/free per chunk
+    struct ChunkDecoder
+    {
+        libdeflate_decompressor* m_decompressor = libdeflate_alloc_decompressor();
+        std::vector<u8> m_transformed; // grows to the largest chunk, chunks are ChunkSize bytes at most
+        ~ChunkDecoder() { libdeflate_free_decompressor(m_decompressor); }
+    };
+
+    // Chunk table of a compressed section, nullptr when the table doesn't fit in the section
+    const Chunk* chunkTable(const MeshCacheView& _view, const Section& _section, const CompressedSection*& _compressed)
+    {
+        _compressed = (const CompressedSection*)_view.sectionData(_section);
+        if (_section.size < sizeof(CompressedSection)
+            || _section.size < sizeof(CompressedSection) + sizeof(Chunk) * (u64)_compressed->chunkCount)
+            return nullptr;
+        return (const Chunk*)(_compressed + 1);
+    }
+
+    bool validSection(const MeshCacheView& _view, const Section* _section, u64 _rawSize)
+    {
+        if (!_section)
+            return false;
+        if (!(_section->flags & SectionFlags::Compressed))
+            return _section->size == _rawSize;
+
+        const CompressedSection* compressed = nullptr;
+        const Chunk* chunks = chunkTable(_view, *_section, compressed);
+        if (!chunks || compressed->rawSize != _rawSize || compressed->codec > Codec::IndexDeltas)
+            return false;
+        for (u32 c = 0; c < compressed->chunkCount; ++c)
+        {
+            const Chunk& chunk = chunks[c];
+            if (chunk.offset + chunk.size > _section->size || chunk.rawOffset + chunk.rawSize > _rawSize
+                || chunk.elementSize == 0 || chunk.rawSize % chunk.elementSize != 0
+                || (compressed->codec == Codec::IndexDeltas && chunk.elementSize != sizeof(u16) && chunk.elementSize != sizeof(u32)))
+                return false;
+        }
+        return true;
+    }
+
+    // One chunk per ChunkSize bytes of every range, ranges are [rawOffset, rawOffset + size) of elementSize elements
+    struct ChunkRange
+    {
+        u64 rawOffset;
+        u64 size;
+        u32 elementSize;
+    };
+    std::vector<u8> compressSection(const u8* _raw, u64 _rawSize, Codec _codec, const std::vector<ChunkRange>& _ranges, JobSystem* _jobSystem)
+    {
+        std::vector<Chunk> chunks;
+        for (const ChunkRange& range : _ranges)
+        {
+            u64 chunkSize = ChunkSize / range.elementSize * range.elementSize;
+            for (u64 offset = 0; offset < range.size; offset += chunkSize)
+                chunks.push_back({ range.rawOffset + offset, (u32)std::min(chunkSize, range.size - offset), range.elementSize, 0, 0 });
+        }
+
+        std::vector<std::vector<u8>> streams(chunks.size());
+        auto encodeJob = [&](u32 _chunk) {
+            const Chunk& chunk = chunks[_chunk];
+            std::vector<u8> transformed(chunk.rawSize);
+            size_t count = chunk.rawSize / chunk.elementSize;
+            if (_codec == Codec::IndexDeltas)
+                MeshCodec::encodeIndices(transformed.data(), _raw + chunk.rawOffset, count, chunk.elementSize);
+            else
+                MeshCodec::transposeBytes(transformed.data(), _raw + chunk.rawOffset, count, chunk.elementSize);
+            MeshCodec::deflate(streams[_chunk], transformed.data(), transformed.size());
+        };
+        if (_jobSystem)
+            _jobSystem->parallelFor((u32)chunks.size(), encodeJob);
+        else
+            for (u32 c = 0; c < (u32)chunks.size(); ++c)
+                encodeJob(c);
+
+        u64 offset = sizeof(CompressedSection) + sizeof(Chunk) * chunks.size();
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            chunks[c].offset = offset;
+            chunks[c].size = streams[c].size();
+            offset += streams[c].size();
+        }
+
+        std::vector<u8> payload(offset);
+        CompressedSection compressed{ _rawSize, (u32)_codec, (u32)chunks.size() };
+        memcpy(payload.data(), &compressed, sizeof(CompressedSection));
+        memcpy(payload.data() + sizeof(CompressedSection), chunks.data(), sizeof(Chunk) * chunks.size());
+        for (size_t c = 0; c < chunks.size(); ++c)
+            memcpy(payload.data() + chunks[c].offset, streams[c].data(), streams[c].size());
+        return payload;
+    }
+}
+
+const Section* MeshCacheView::findSection(SectionType _type) const
+{
+    if (!m_header)
+        return nullptr;
+
+    for (u32 i = 0; i < m_header->sectionCount; ++i)
+    {
+        if (m_sections[i].type == _type)
+            return &m_sections[i];
+    }
+    return nullptr;
+}
+
+u64 MeshCacheView::sectionRawSize(const Section& _section) const
+{
+    if (!(_section.flags & SectionFlags::Compressed))
+        return _section.size;
+    return ((const CompressedSection*)sectionData(_section))->rawSize;
+}
+
+const SubMesh* MeshCacheView::subMeshes() const
+{
+    const Section* section = findSection(SectionType::SubMeshes);
+    return section ? (const SubMesh*)sectionData(*section) : nullptr;
+}
+
+const Meshlet* MeshCacheView::meshlets() const
+{
+    const Section* section = findSection(SectionType::Meshlets);
+    return section ? (const Meshlet*)sectionData(*section) : nullptr;
+}
+
+const Instance* MeshCacheView::instances() const
+{
+    const Section* section = findSection(SectionType::Instances);
+    return section ? (const Instance*)sectionData(*section) : nullptr;
+}
+
+Layout MeshCache::makeLayout(const VkVertexInputBindingDescription& _binding, const VkVertexInputAttributeDescription* _attributes, u32 _attributeCount)
+{
+    if (_attributeCount > MaxAttributes)
+        throw std::runtime_error("Too many vertex attributes for the mesh cache layout.");
+
+    Layout layout{};
+    layout.stride = _binding.stride;
+    layout.attributeCount = _attributeCount;
+    for (u32 i = 0; i < _attributeCount; ++i)
+    {
+        layout.attributes[i].location = _attributes[i].location;
+        layout.attributes[i].format = (u32)_attributes[i].format;
+        layout.attributes[i].offset = _attributes[i].offset;
+    }
+    return layout;
+}
+
+u64 MeshCache::layoutId(const Layout& _layout)
+{
+    // Layout is zero initialized, unused attributes don't change the id
+    return FileHelper::hash64(&_layout, sizeof(Layout), Version);
+}
+
+bool MeshCache::open(MeshCacheView& _view, const std::string& _cachePath, u64 _sourceHash, const Layout& _layout)
+{
+    _view = MeshCacheView{};
+
+    MappedFile file;
+    try
+    {
+        file.map(_cachePath);
+    }
+    catch (const std::exception&)
+    {
+        return false; // no cache yet
+    }
+
+    if (!open(_view, file.data(), file.size(), _sourceHash, _layout))
+        return false;
+    _view.m_file = std::move(file); // moving the mapping keeps the view pointers valid
+    return true;
+}
+
+bool MeshCache::open(MeshCacheView& _view, const octet* _data, size_t _size, u64 _sourceHash, const Layout& _layout)
+{
+    _view = MeshCacheView{};
+
+    size_t fileSize = _size;
+    if (!_data || fileSize < sizeof(Header))
+        return false;
+
+    const Header* header = (const Header*)_data;
+    if (header->magic != Magic || header->version != Version)
+    {
+        std::cout << "\t\t mesh cache: outdated format\n";
+        return false;
+    }
+    if (header->layoutId != layoutId(_layout) || memcmp(&header->layout, &_layout, sizeof(Layout)) != 0)
+    {
+        std::cout << "\t\t mesh cache: vertex layout changed\n";
+        return false;
+    }
+    if (header->sourceHash != _sourceHash)
+    {
+        std::cout << "\t\t mesh cache: source changed\n";
+        return false;
+    }
+
+    size_t tableEnd = sizeof(Header) + sizeof(Section) * (size_t)header->sectionCount;
+    if (tableEnd > fileSize)
+        return false;
+
+    const Section* sections = (const Section*)(_data + sizeof(Header));
+    for (u32 i = 0; i < header->sectionCount; ++i)
+    {
+        if (sections[i].offset % SectionAlignment != 0 || sections[i].offset + sections[i].size > fileSize)
+            return false;
+    }
+
+    _view.m_data = _data;
+    _view.m_size = _size;
+    _view.m_header = header;
+    _view.m_sections = sections;
+
+    const Section* vertices = _view.findSection(SectionType::Vertices);
+    const Section* indices = _view.findSection(SectionType::Indices);
+    const Section* subMeshes = _view.findSection(SectionType::SubMeshes);
+    const Section* meshlets = _view.findSection(SectionType::Meshlets);
+    const Section* instances = _view.findSection(SectionType::Instances);
+    // submeshes, meshlets and instances are read in place, they are never compressed
+    if (!validSection(_view, vertices, (u64)header->vertexCount * header->layout.stride)
+        || !validSection(_view, indices, header->indexDataSize)
+        || !subMeshes || subMeshes->flags != 0 || subMeshes->size != (u64)header->subMeshCount * sizeof(SubMesh)
+        || !meshlets || meshlets->flags != 0 || meshlets->size != (u64)header->meshletCount * sizeof(Meshlet)
+        || !instances || instances->flags != 0 || instances->size != (u64)header->instanceCount * sizeof(Instance))
+    {
+        _view = MeshCacheView{};
+        return false;
+    }
+
+    return true;
+}
+
+void MeshCache::readSection(const MeshCacheView& _view, SectionType _type, void* _destination, JobSystem* _jobSystem, MeshCacheReadStatistics* _statistics)
+{
+    const Section* section = _view.findSection(_type);
+    if (!section)
+        throw std::runtime_error("Missing mesh cache section.");
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    if (!(section->flags & SectionFlags::Compressed))
+    {
+        memcpy(_destination, _view.sectionData(*section), (size_t)section->size);
+    }
+    else
+    {
+        const CompressedSection* compressed = nullptr;
+        const Chunk* chunks = chunkTable(_view, *section, compressed);
+        const u8* sectionBytes = (const u8*)_view.sectionData(*section);
+
+        // inflate to a scratch buffer, the inverse transform writes the destination
+        auto decodeJob = [&](u32 _chunk) {
+            const Chunk& chunk = chunks[_chunk];
+            thread_local ChunkDecoder decoder;
+            if (!decoder.m_decompressor)
+                throw std::runtime_error("Failed to allocate a mesh cache decompressor.");
+            std::vector<u8>& transformed = decoder.m_transformed;
+            if (transformed.size() < chunk.rawSize)
+                transformed.resize(chunk.rawSize);
+            size_t decodedSize = 0;
+            libdeflate_result result = libdeflate_deflate_decompress(decoder.m_decompressor, sectionBytes + chunk.offset, (size_t)chunk.size, transformed.data(), (size_t)chunk.rawSize, &decodedSize);
+            if (result != LIBDEFLATE_SUCCESS || decodedSize != chunk.rawSize)
+                throw std::runtime_error("Corrupted mesh cache chunk.");
+
+            u8* destination = (u8*)_destination + chunk.rawOffset;
+            size_t count = chunk.rawSize / chunk.elementSize;
+            if (compressed->codec == Codec::IndexDeltas)
+                MeshCodec::decodeIndices(destination, transformed.data(), count, chunk.elementSize);
+            else
+                MeshCodec::untransposeBytes(destination, transformed.data(), count, chunk.elementSize);
+        };
+        if (_jobSystem)
+            _jobSystem->parallelFor(compressed->chunkCount, decodeJob);
+        else
+            for (u32 c = 0; c < compressed->chunkCount; ++c)
+                decodeJob(c);
+    }
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    if (_statistics)
+    {
+        _statistics->storedSize += section->size;
+        _statistics->rawSize += _view.sectionRawSize(*section);
+        _statistics->milliseconds += std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count();
+    }
+}
+
+void MeshCache::serialize(std::vector<u8>& _image, u64 _sourceHash, const Layout& _layout, const MeshCacheData& _data, JobSystem* _jobSystem)
+{
+    struct Payload
+    {
+        SectionType type;
+        const void* data;
+        u64 size;
+        u32 flags = 0;
+    };
+    std::vector<Payload> payloads = {
+        { SectionType::Vertices, _data.vertices, (u64)_data.vertexCount * _layout.stride },
+        { SectionType::Indices, _data.indices, _data.indexDataSize },
+        { SectionType::SubMeshes, _data.subMeshes.data(), (u64)_data.subMeshes.size() * sizeof(SubMesh) },
+        { SectionType::Meshlets, _data.meshlets.data(), (u64)_data.meshlets.size() * sizeof(Meshlet) },
+        { SectionType::Instances, _data.instances.data(), (u64)_data.instances.size() * sizeof(Instance) },
+    };
+
+    // index chunks follow the submesh ranges, each range has its own index size
+    std::vector<u8> compressedVertices, compressedIndices;
+    if (_data.compress)
+    {
+        compressedVertices = compressSection((const u8*)_data.vertices, payloads[0].size, Codec::BytePlanes, { { 0, payloads[0].size, _layout.stride } }, _jobSystem);
+        std::vector<ChunkRange> indexRanges;
+        for (const SubMesh& subMesh : _data.subMeshes)
+            indexRanges.push_back({ (u64)subMesh.firstIndex * subMesh.indexSize, (u64)subMesh.indexCount * subMesh.indexSize, subMesh.indexSize });
+        compressedIndices = compressSection((const u8*)_data.indices, payloads[1].size, Codec::IndexDeltas, indexRanges, _jobSystem);
+
+        payloads[0] = { SectionType::Vertices, compressedVertices.data(), compressedVertices.size(), SectionFlags::Compressed };
+        payloads[1] = { SectionType::Indices, compressedIndices.data(), compressedIndices.size(), SectionFlags::Compressed };
+    }
+
+    Header header{};
+    header.magic = Magic;
+    header.version = Version;
+    header.sourceHash = _sourceHash;
+    header.layoutId = layoutId(_layout);
+    header.layout = _layout;
+    header.vertexCount = _data.vertexCount;
+    header.indexCount = _data.indexCount;
+    header.indexDataSize = _data.indexDataSize;
+    header.subMeshCount = (u32)_data.subMeshes.size();
+    header.meshletCount = (u32)_data.meshlets.size();
+    header.instanceCount = (u32)_data.instances.size();
+    header.sectionCount = (u32)payloads.size();
+
+    auto align = [](u64 _offset) { return (_offset + SectionAlignment - 1) & ~(SectionAlignment - 1); };
+
+    std::vector<Section> sections;
+    u64 offset = align(sizeof(Header) + sizeof(Section) * payloads.size());
+    for (const Payload& payload : payloads)
+    {
+        sections.push_back({ payload.type, payload.flags, offset, payload.size });
+        offset = align(offset + payload.size);
+    }
+
+    // padding stays zeroed
+    _image.assign(offset, 0);
+    memcpy(_image.data(), &header, sizeof(Header));
+    memcpy(_image.data() + sizeof(Header), sections.data(), sizeof(Section) * sections.size());
+    for (size_t i = 0; i < payloads.size(); ++i)
+        memcpy(_image.data() + sections[i].offset, payloads[i].data, payloads[i].size);
+}
+
+bool MeshCache::write(const std::string& _cachePath, u64 _sourceHash, const Layout& _layout, const MeshCacheData& _data, JobSystem* _jobSystem)
+{
+    std::vector<u8> image;
+    serialize(image, _sourceHash, _layout, _data, _jobSystem);
+    return writeImage(_cachePath, image);
+}
+
+bool MeshCache::writeImage(const std::string& _cachePath, const std::vector<u8>& _image)
+{
+    return FileHelper::writeFile(_cachePath, _image.data(), _image.size());
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+// stl
+#include <string>
+#include <vector>
+
+// vulkan
+#include "vulkan/vulkan_core.h"
+
+#include "Common.h"
+#include "FileHelper.h"
+
+class JobSystem;
+
+// Binary mesh cache written next to the source asset (<source>[.<variant>].meshcache).
+//
+//  MeshCacheHeader
+//  MeshCacheSection[sectionCount]
+//  payload sections, each aligned on SectionAlignment
+//
+// Compressed sections hold a CompressedSection, its Chunk table and one raw deflate stream per chunk.
+// Chunks are independent so they decode in parallel, straight into the destination.
+//
+// The cache is stale as soon as the version, the vertex layout or the source content hash differ.
+namespace MeshCacheFormat
+{
+    static constexpr u32 Magic = 0x4D43594E; // "NYCM"
+    static constexpr u32 Version = 9; // 2: optimized index and vertex order, 3: submesh position dequantization, 4: per submesh index size, 5: meshlets, 6: LODs, 7: compressed sections, 8: tangents, 9: instances
+    static constexpr u32 MaxAttributes = 8;
+    static constexpr u32 MaxLodCount = 5;
+    static constexpr u64 SectionAlignment = 64;
+    static constexpr u32 ChunkSize = 256 * 1024; // raw bytes per compressed chunk, at most
+
+    enum SectionType : u32
+    {
+        Vertices = 0,
+        Indices,
+        SubMeshes,
+        Meshlets,
+        Instances,
+    };
+
+    struct Attribute
+    {
+        u32 location;
+        u32 format; // VkFormat
+        u32 offset;
+    };
+
+    struct Layout
+    {
+        u32 stride = 0;
+        u32 attributeCount = 0;
+        Attribute attributes[MaxAttributes]{};
+    };
+
+    enum SectionFlags : u32
+    {
+        Compressed = 1 << 0,
+    };
+
+    // Transform applied to a chunk before deflate
+    enum Codec : u32
+    {
+        BytePlanes = 0, // vertices, see MeshCodec::transposeBytes
+        IndexDeltas, // indices, see MeshCodec::encodeIndices
+    };
+
+    struct Section
+    {
+        u32 type; // SectionType
+        u32 flags; // SectionFlags
+        u64 offset; // from the start of the file
+        u64 size; // stored size
+    };
+
+    struct CompressedSection
+    {
+        u64 rawSize;
+        u32 codec; // Codec
+        u32 chunkCount;
+    };
+
+    struct Chunk
+    {
+        u64 rawOffset; // in the decoded section
+        u32 rawSize;
+        u32 elementSize; // vertex stride or index size
+        u64 offset; // deflate stream, from the start of the section
+        u64 size;
+    };
+
+    // Index sub-range of a submesh, LOD 0 is the full resolution one
+    struct Lod
+    {
+        u32 firstIndex; // absolute, in the submesh index size units
+        u32 indexCount;
+        float error; // distance to LOD 0, in position units
+    };
+
+    struct SubMesh
+    {
+        u32 firstIndex; // in indexSize units, byte offset = firstIndex * indexSize
+        u32 indexCount; // every LOD
+        i32 vertexOffset;
+        u32 vertexCount;
+        i32 materialSlot;
+        u32 indexSize; // 2 or 4 bytes
+        float positionScale[3]; // packed vertex formats: position = stored * scale + offset
+        float positionOffset[3];
+        u32 firstMeshlet;
+        u32 meshletCount;
+        u32 lodCount;
+        Lod lods[MaxLodCount];
+        u32 firstInstance; // placements of the submesh mesh, shared by all its submeshes
+        u32 instanceCount;
+    };
+
+    // Uploaded as is to the cluster culling storage buffer (std430, matches cluster_cull.comp)
+    struct Meshlet
+    {
+        float center[3]; // bounding sphere
+        float radius;
+        float coneAxis[3]; // back facing normal cone
+        float coneCutoff;
+        u32 firstIndex; // absolute, in the submesh index size units
+        u32 indexCount;
+        i32 vertexOffset;
+        u16 subMesh;
+        u8 firstLod; // drawn while the selected LOD is in [firstLod, lastLod]
+        u8 lastLod;
+    };
+    static_assert(sizeof(Meshlet) == 48, "Meshlet is read as std430 by cluster_cull.comp");
+
+    // Placement of a mesh in the scene, uploaded with its normal matrix (Engine InstanceTransform)
+    struct Instance
+    {
+        float rows[3][4]; // affine model transform, row major
+    };
+    static_assert(sizeof(Instance) == 48, "Instance is read in place from the cache");
+
+    struct Header
+    {
+        u32 magic;
+        u32 version;
+        u64 sourceHash;
+        u64 layoutId;
+        Layout layout;
+        u32 vertexCount;
+        u32 indexCount;
+        u32 indexDataSize; // bytes, submeshes mix 16 and 32 bit index ranges
+        u32 subMeshCount;
+        u32 sectionCount;
+        u32 meshletCount;
+        u32 instanceCount;
+    };
+};
+
+// Read only view on a cache image, either a mapped cache file or a blob of a mapped asset archive.
+// Pointers stay valid as long as the view lives (and the archive for archive blobs).
+struct MeshCacheView
+{
+    MappedFile m_file; // empty for archive blobs
+    const octet* m_data = nullptr;
+    size_t m_size = 0;
+    const MeshCacheFormat::Header* m_header = nullptr;
+    const MeshCacheFormat::Section* m_sections = nullptr;
+
+    const MeshCacheFormat::Section* findSection(MeshCacheFormat::SectionType _type) const;
+    const void* sectionData(const MeshCacheFormat::Section& _section) const { return m_data + _section.offset; }
+    u64 sectionRawSize(const MeshCacheFormat::Section& _section) const;
+
+    const MeshCacheFormat::SubMesh* subMeshes() const;
+    u32 subMeshCount() const { return m_header ? m_header->subMeshCount : 0; }
+
+    const MeshCacheFormat::Meshlet* meshlets() const;
+    u32 meshletCount() const { return m_header ? m_header->meshletCount : 0; }
+
+    const MeshCacheFormat::Instance* instances() const;
+    u32 instanceCount() const { return m_header ? m_header->instanceCount : 0; }
+};
+
+// What gets written in a cache, pointers are only read during MeshCache::write
+struct MeshCacheData
+{
+    const void* vertices = nullptr;
+    u32 vertexCount = 0;
+
+    const void* indices = nullptr;
+    u32 indexCount = 0;
+    u32 indexDataSize = 0; // bytes
+
+    std::vector<MeshCacheFormat::SubMesh> subMeshes;
+    std::vector<MeshCacheFormat::Meshlet> meshlets;
+    std::vector<MeshCacheFormat::Instance> instances; // sorted by mesh, see SubMesh::firstInstance
+
+    bool compress = false; // vertices and indices, submeshes, meshlets and instances stay raw so they can be read in place
+};
+
+struct MeshCacheReadStatistics
+{
+    u64 storedSize = 0;
+    u64 rawSize = 0;
+    float milliseconds = 0.0f;
+
+    float ratio() const { return storedSize ? (float)rawSize / storedSize : 0.0f; }
+    float gigabytesPerSecond() const { return milliseconds > 0.0f ? rawSize / (milliseconds * 1e6f) : 0.0f; }
+
+    MeshCacheReadStatistics& operator+=(const MeshCacheReadStatistics& _other)
+    {
+        storedSize += _other.storedSize;
+        rawSize += _other.rawSize;
+        milliseconds += _other.milliseconds;
+        return *this;
+    }
+};
+
+class MeshCache
+{
+public:
+    // _variant tells apart the caches of one source imported with different settings (e.g. vertex formats)
+    static std::string getCachePath(const std::string& _sourcePath, const std::string& _variant = "") { return _sourcePath + (_variant.empty() ? "" : "." + _variant) + ".meshcache"; }
+
+    static MeshCacheFormat::Layout makeLayout(const VkVertexInputBindingDescription& _binding, const VkVertexInputAttributeDescription* _attributes, u32 _attributeCount);
+    static u64 layoutId(const MeshCacheFormat::Layout& _layout);
+
+    // Map _cachePath and check it against the expected source hash and vertex layout.
+    // Returns false when the cache is missing, corrupted or stale.
+    static bool open(MeshCacheView& _view, const std::string& _cachePath, u64 _sourceHash, const MeshCacheFormat::Layout& _layout);
+    // Same checks on a cache image already in memory, _data has to outlive _view
+    static bool open(MeshCacheView& _view, const octet* _data, size_t _size, u64 _sourceHash, const MeshCacheFormat::Layout& _layout);
+
+    // Copy a section to _destination (sectionRawSize bytes), compressed chunks are decoded on _jobSystem.
+    // Throws when a compressed chunk is corrupted.
+    static void readSection(const MeshCacheView& _view, MeshCacheFormat::SectionType _type, void* _destination, JobSystem* _jobSystem = nullptr, MeshCacheReadStatistics* _statistics = nullptr);
+
+    // Whole cache image, as written by write. Compressed chunks are encoded on _jobSystem.
+    static void serialize(std::vector<u8>& _image, u64 _sourceHash, const MeshCacheFormat::Layout& _layout, const MeshCacheData& _data, JobSystem* _jobSystem = nullptr);
+    // Write the whole cache in one go, returns false if the file can't be written.
+    // Compressed chunks are encoded on _jobSystem.
+    static bool write(const std::string& _cachePath, u64 _sourceHash, const MeshCacheFormat::Layout& _layout, const MeshCacheData& _data, JobSystem* _jobSystem = nullptr);
+    // Write an image built by serialize, returns false if the file can't be written
+    static bool writeImage(const std::string& _cachePath, const std::vector<u8>& _image);
+};
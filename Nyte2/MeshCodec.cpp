@@ -0,0 +1,329 @@
+#include "MeshCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define NYTE_MESH_CODEC_SSE2 1
+#endif
+
+namespace
+{
+#if NYTE_MESH_CODEC_SSE2
+    // Four rounds of interleaving leave column c in row bitreverse(c)
+    void transpose16x16(const __m128i _rows[16], __m128i _columns[16])
+    {
+        static constexpr u32 BitReverse4[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+        __m128i a[16], b[16];
+        for (u32 i = 0; i < 16; ++i)
+            a[i] = _rows[i];
+        for (u32 j = 0; j < 8; ++j) { b[j] = _mm_unpacklo_epi8(a[2 * j], a[2 * j + 1]); b[j + 8] = _mm_unpackhi_epi8(a[2 * j], a[2 * j + 1]); }
+        for (u32 j = 0; j < 8; ++j) { a[j] = _mm_unpacklo_epi16(b[2 * j], b[2 * j + 1]); a[j + 8] = _mm_unpackhi_epi16(b[2 * j], b[2 * j + 1]); }
+        for (u32 j = 0; j < 8; ++j) { b[j] = _mm_unpacklo_epi32(a[2 * j], a[2 * j + 1]); b[j + 8] = _mm_unpackhi_epi32(a[2 * j], a[2 * j + 1]); }
+        for (u32 j = 0; j < 8; ++j) { a[j] = _mm_unpacklo_epi64(b[2 * j], b[2 * j + 1]); a[j + 8] = _mm_unpackhi_epi64(b[2 * j], b[2 * j + 1]); }
+        for (u32 c = 0; c < 16; ++c)
+            _columns[c] = a[BitReverse4[c]];
+    }
+#endif
+
+    template<typename T>
+    T zigzag(T _delta) { return (T)((_delta << 1) ^ (T)(0 - (_delta >> (sizeof(T) * 8 - 1)))); }
+    template<typename T>
+    T unzigzag(T _value) { return (T)((_value >> 1) ^ (T)(0 - (_value & 1))); }
+
+    // LSB first bit stream, Huffman codes are stored reversed so they come out MSB first
+    struct BitWriter
+    {
+        std::vector<u8>& m_out;
+        u64 m_bits = 0;
+        u32 m_count = 0;
+
+        void put(u32 _bits, u32 _count)
+        {
+            m_bits |= (u64)_bits << m_count;
+            m_count += _count;
+            while (m_count >= 8)
+            {
+                m_out.push_back((u8)m_bits);
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+        }
+        void flush()
+        {
+            if (m_count > 0)
+                m_out.push_back((u8)m_bits);
+            m_bits = 0;
+            m_count = 0;
+        }
+    };
+
+    u32 reverseBits(u32 _code, u32 _length)
+    {
+        u32 reversed = 0;
+        for (u32 i = 0; i < _length; ++i)
+            reversed |= ((_code >> i) & 1) << (_length - 1 - i);
+        return reversed;
+    }
+
+    // RFC 1951 3.2.5 / 3.2.6
+    constexpr u16 LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr u8 LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    constexpr u16 DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    constexpr u8 DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    struct FixedHuffman
+    {
+        u16 literalCodes[288];
+        u8 literalLengths[288];
+        u8 distanceCodes[30];
+
+        FixedHuffman()
+        {
+            for (u32 v = 0; v < 288; ++v)
+            {
+                u32 code, length;
+                if (v < 144) { code = 0x30 + v; length = 8; }
+                else if (v < 256) { code = 0x190 + (v - 144); length = 9; }
+                else if (v < 280) { code = v - 256; length = 7; }
+                else { code = 0xC0 + (v - 280); length = 8; }
+                literalCodes[v] = (u16)reverseBits(code, length);
+                literalLengths[v] = (u8)length;
+            }
+            for (u32 d = 0; d < 30; ++d)
+                distanceCodes[d] = (u8)reverseBits(d, 5);
+        }
+    };
+
+    constexpr u32 WindowSize = 1 << 15;
+    constexpr u32 HashBits = 15;
+    constexpr u32 MaxChainLength = 32;
+    constexpr u32 MinMatch = 3;
+    constexpr u32 MaxMatch = 258;
+
+    u32 hash3(const u8* _p) { return ((u32)_p[0] << 16 | (u32)_p[1] << 8 | _p[2]) * 2654435761u >> (32 - HashBits); }
+}
+
+void MeshCodec::transposeBytes(u8* _destination, const u8* _source, size_t _count, size_t _elementSize)
+{
+    for (size_t i = 0; i < _count; ++i)
+    {
+        for (size_t k = 0; k < _elementSize; ++k)
+            _destination[k * _count + i] = _source[i * _elementSize + k];
+    }
+}
+
+void MeshCodec::untransposeBytes(u8* _destination, const u8* _source, size_t _count, size_t _elementSize)
+{
+    size_t i = 0;
+#if NYTE_MESH_CODEC_SSE2
+    if (_elementSize % 16 == 0)
+    {
+        __m128i planes[16], elements[16];
+        for (; i + 16 <= _count; i += 16)
+        {
+            for (size_t k = 0; k < _elementSize; k += 16)
+            {
+                for (u32 p = 0; p < 16; ++p)
+                    planes[p] = _mm_loadu_si128((const __m128i*)(_source + (k + p) * _count + i));
+                transpose16x16(planes, elements);
+                for (u32 e = 0; e < 16; ++e)
+                    _mm_storeu_si128((__m128i*)(_destination + (i + e) * _elementSize + k), elements[e]);
+            }
+        }
+    }
+#endif
+    for (; i < _count; ++i)
+    {
+        for (size_t k = 0; k < _elementSize; ++k)
+            _destination[i * _elementSize + k] = _source[k * _count + i];
+    }
+}
+
+void MeshCodec::encodeIndices(u8* _destination, const void* _indices, size_t _count, u32 _indexSize)
+{
+    if (_indexSize == sizeof(u16))
+    {
+        std::vector<u16> deltas(_count);
+        const u16* indices = (const u16*)_indices;
+        u16 previous = 0;
+        for (size_t i = 0; i < _count; ++i)
+        {
+            deltas[i] = zigzag<u16>((u16)(indices[i] - previous));
+            previous = indices[i];
+        }
+        transposeBytes(_destination, (const u8*)deltas.data(), _count, sizeof(u16));
+    }
+    else
+    {
+        std::vector<u32> deltas(_count);
+        const u32* indices = (const u32*)_indices;
+        u32 previous = 0;
+        for (size_t i = 0; i < _count; ++i)
+        {
+            deltas[i] = zigzag<u32>(indices[i] - previous);
+            previous = indices[i];
+        }
+        transposeBytes(_destination, (const u8*)deltas.data(), _count, sizeof(u32));
+    }
+}
+
+void MeshCodec::decodeIndices(void* _indices, const u8* _source, size_t _count, u32 _indexSize)
+{
+    size_t i = 0;
+    if (_indexSize == sizeof(u16))
+    {
+        u16* indices = (u16*)_indices;
+        const u8* plane0 = _source;
+        const u8* plane1 = _source + _count;
+        u16 previous = 0;
+#if NYTE_MESH_CODEC_SSE2
+        __m128i running = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        for (; i + 16 <= _count; i += 16)
+        {
+            __m128i low = _mm_loadu_si128((const __m128i*)(plane0 + i));
+            __m128i high = _mm_loadu_si128((const __m128i*)(plane1 + i));
+            __m128i values[2] = { _mm_unpacklo_epi8(low, high), _mm_unpackhi_epi8(low, high) };
+            for (u32 v = 0; v < 2; ++v)
+            {
+                __m128i d = _mm_xor_si128(_mm_srli_epi16(values[v], 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(values[v], one)));
+                d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+                d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+                d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+                d = _mm_add_epi16(d, running);
+                _mm_storeu_si128((__m128i*)(indices + i + v * 8), d);
+                running = _mm_shufflehi_epi16(d, 0xFF);
+                running = _mm_unpackhi_epi64(running, running);
+            }
+        }
+        if (i > 0)
+            previous = indices[i - 1];
+#endif
+        for (; i < _count; ++i)
+        {
+            previous = (u16)(previous + unzigzag<u16>((u16)(plane0[i] | plane1[i] << 8)));
+            indices[i] = previous;
+        }
+    }
+    else
+    {
+        u32* indices = (u32*)_indices;
+        const u8* planes[4] = { _source, _source + _count, _source + 2 * _count, _source + 3 * _count };
+        u32 previous = 0;
+#if NYTE_MESH_CODEC_SSE2
+        __m128i running = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi32(1);
+        for (; i + 16 <= _count; i += 16)
+        {
+            __m128i p0 = _mm_loadu_si128((const __m128i*)(planes[0] + i));
+            __m128i p1 = _mm_loadu_si128((const __m128i*)(planes[1] + i));
+            __m128i p2 = _mm_loadu_si128((const __m128i*)(planes[2] + i));
+            __m128i p3 = _mm_loadu_si128((const __m128i*)(planes[3] + i));
+            __m128i low01 = _mm_unpacklo_epi8(p0, p1), high01 = _mm_unpackhi_epi8(p0, p1);
+            __m128i low23 = _mm_unpacklo_epi8(p2, p3), high23 = _mm_unpackhi_epi8(p2, p3);
+            __m128i values[4] = { _mm_unpacklo_epi16(low01, low23), _mm_unpackhi_epi16(low01, low23), _mm_unpacklo_epi16(high01, high23), _mm_unpackhi_epi16(high01, high23) };
+            for (u32 v = 0; v < 4; ++v)
+            {
+                __m128i d = _mm_xor_si128(_mm_srli_epi32(values[v], 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(values[v], one)));
+                d = _mm_add_epi32(d, _mm_slli_si128(d, 4));
+                d = _mm_add_epi32(d, _mm_slli_si128(d, 8));
+                d = _mm_add_epi32(d, running);
+                _mm_storeu_si128((__m128i*)(indices + i + v * 4), d);
+                running = _mm_shuffle_epi32(d, 0xFF);
+            }
+        }
+        if (i > 0)
+            previous = indices[i - 1];
+#endif
+        for (; i < _count; ++i)
+        {
+            u32 value = (u32)planes[0][i] | (u32)planes[1][i] << 8 | (u32)planes[2][i] << 16 | (u32)planes[3][i] << 24;
+            previous += unzigzag<u32>(value);
+            indices[i] = previous;
+        }
+    }
+}
+
+void MeshCodec::deflate(std::vector<u8>& _destination, const u8* _source, size_t _size)
+{
+    static const FixedHuffman huffman;
+
+    _destination.clear();
+    _destination.reserve(_size / 2 + 64);
+    BitWriter writer{ _destination };
+    writer.put(1, 1); // BFINAL, the whole input is one block
+    writer.put(1, 2); // BTYPE 01, fixed Huffman codes
+
+    auto putLiteral = [&](u32 _value) { writer.put(huffman.literalCodes[_value], huffman.literalLengths[_value]); };
+
+    std::vector<i32> head((size_t)1 << HashBits, -1);
+    std::vector<i32> previous(WindowSize, -1);
+    auto insert = [&](size_t _position) {
+        u32 h = hash3(_source + _position);
+        previous[_position & (WindowSize - 1)] = head[h];
+        head[h] = (i32)_position;
+    };
+
+    size_t position = 0;
+    while (position < _size)
+    {
+        u32 bestLength = 0;
+        u32 bestDistance = 0;
+        if (position + MinMatch <= _size)
+        {
+            u32 maxLength = (u32)std::min<size_t>(MaxMatch, _size - position);
+            i32 candidate = head[hash3(_source + position)];
+            for (u32 chain = 0; chain < MaxChainLength && candidate >= 0 && position - candidate <= WindowSize; ++chain)
+            {
+                const u8* a = _source + candidate;
+                const u8* b = _source + position;
+                if (a[bestLength] == b[bestLength])
+                {
+                    u32 length = 0;
+                    while (length < maxLength && a[length] == b[length])
+                        ++length;
+                    if (length > bestLength)
+                    {
+                        bestLength = length;
+                        bestDistance = (u32)(position - candidate);
+                        if (length == maxLength)
+                            break;
+                    }
+                }
+                i32 next = previous[candidate & (WindowSize - 1)];
+                if (next >= candidate)
+                    break; // overwritten slot, the chain left the window
+                candidate = next;
+            }
+        }
+
+        if (bestLength >= MinMatch)
+        {
+            u32 lengthCode = (u32)(std::upper_bound(LengthBase, LengthBase + 29, (u16)bestLength) - LengthBase) - 1;
+            putLiteral(257 + lengthCode);
+            writer.put(bestLength - LengthBase[lengthCode], LengthExtra[lengthCode]);
+            u32 distanceCode = (u32)(std::upper_bound(DistanceBase, DistanceBase + 30, (u16)bestDistance) - DistanceBase) - 1;
+            writer.put(huffman.distanceCodes[distanceCode], 5);
+            writer.put(bestDistance - DistanceBase[distanceCode], DistanceExtra[distanceCode]);
+
+            for (u32 k = 0; k < bestLength; ++k, ++position)
+            {
+                if (position + MinMatch <= _size)
+                    insert(position);
+            }
+        }
+        else
+        {
+            putLiteral(_source[position]);
+            if (position + MinMatch <= _size)
+                insert(position);
+            ++position;
+        }
+    }
+
+    putLiteral(256); // end of block
+    writer.flush();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// stl
+#include <cstddef>
+#include <vector>
+
+#include "Common.h"
+
+// Reversible transforms run on mesh cache sections before deflate, and the deflate writer itself.
+// Vertices are split in byte planes so the slowly varying bytes (exponents, high bits) end up next to each other,
+// indices are delta and zigzag coded first so most of their high planes are zeros.
+class MeshCodec
+{
+public:
+    // _destination[k * _count + i] = byte k of element i
+    static void transposeBytes(u8* _destination, const u8* _source, size_t _count, size_t _elementSize);
+    // Inverse of transposeBytes, SSE2 16x16 byte transposes when _elementSize is a multiple of 16
+    static void untransposeBytes(u8* _destination, const u8* _source, size_t _count, size_t _elementSize);
+
+    // Zigzag coded delta to the previous index (0 before the first one), written as byte planes.
+    // _indexSize is 2 or 4, _destination holds _count * _indexSize bytes.
+    static void encodeIndices(u8* _destination, const void* _indices, size_t _count, u32 _indexSize);
+    // Inverse of encodeIndices, SSE2 zigzag decode and prefix sum
+    static void decodeIndices(void* _indices, const u8* _source, size_t _count, u32 _indexSize);
+
+    // Raw deflate stream (RFC 1951) with greedy LZ77 matching and fixed Huffman codes.
+    // The libdeflate bundled with openFBX only decompresses, this is the writer side.
+    static void deflate(std::vector<u8>& _destination, const u8* _source, size_t _size);
+};
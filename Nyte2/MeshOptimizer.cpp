@@ -0,0 +1,740 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    constexpr u32 InvalidIndex = ~0u;
+
+    // Forsyth scoring parameters
+    constexpr float CacheDecayPower = 1.5f;
+    constexpr float LastTriangleScore = 0.75f;
+    constexpr float ValenceBoostScale = 2.0f;
+    constexpr float ValenceBoostPower = 0.5f;
+    constexpr u32 MaxValenceScore = 32;
+
+    struct ScoreTables
+    {
+        float cache[MeshOptimizer::VertexCacheSize];
+        float valence[MaxValenceScore];
+
+        ScoreTables()
+        {
+            for (u32 i = 0; i < MeshOptimizer::VertexCacheSize; ++i)
+            {
+                // the last triangle's vertices get a fixed score so the next triangle doesn't just reuse the same edge
+                if (i < 3)
+                    cache[i] = LastTriangleScore;
+                else
+                    cache[i] = powf(1.0f - (float)(i - 3) / (MeshOptimizer::VertexCacheSize - 3), CacheDecayPower);
+            }
+            valence[0] = 0.0f;
+            for (u32 i = 1; i < MaxValenceScore; ++i)
+                valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+        }
+    };
+
+    float vertexScore(const ScoreTables& _tables, i32 _cachePosition, u32 _liveTriangles)
+    {
+        // no triangle left to emit, the vertex is useless
+        if (_liveTriangles == 0)
+            return -1.0f;
+
+        float score = _cachePosition >= 0 ? _tables.cache[_cachePosition] : 0.0f;
+        score += _liveTriangles < MaxValenceScore ? _tables.valence[_liveTriangles] : ValenceBoostScale * powf((float)_liveTriangles, -ValenceBoostPower);
+        return score;
+    }
+
+    // Index of the cluster each triangle starts, the order is the one of the index buffer
+    void buildClusters(const u32* _indices, size_t _triangleCount, size_t _vertexCount, float _threshold, std::vector<u32>& _clusterStarts)
+    {
+        // FIFO cache simulation, a vertex is cached while (time - timestamp) < cache size
+        std::vector<u32> timestamps(_vertexCount, 0);
+        u32 time = MeshOptimizer::StatisticsCacheSize + 1;
+
+        std::vector<u8> misses(_triangleCount);
+        std::vector<u32> hardStarts;
+        for (size_t t = 0; t < _triangleCount; ++t)
+        {
+            u8 triangleMisses = 0;
+            for (u32 k = 0; k < 3; ++k)
+            {
+                u32 vertex = _indices[t * 3 + k];
+                if (time - timestamps[vertex] > MeshOptimizer::StatisticsCacheSize)
+                {
+                    timestamps[vertex] = time++;
+                    ++triangleMisses;
+                }
+            }
+            misses[t] = triangleMisses;
+
+            // nothing shared with the previous triangles, the cache optimizer jumped somewhere else
+            if (t == 0 || triangleMisses == 3)
+                hardStarts.push_back((u32)t);
+        }
+        hardStarts.push_back((u32)_triangleCount);
+
+        // soft boundaries inside a hard cluster once the running ACMR is close enough to the cluster's
+        _clusterStarts.clear();
+        for (size_t h = 0; h + 1 < hardStarts.size(); ++h)
+        {
+            u32 begin = hardStarts[h];
+            u32 end = hardStarts[h + 1];
+
+            u32 clusterMisses = 0;
+            for (u32 t = begin; t < end; ++t)
+                clusterMisses += misses[t];
+            float limit = _threshold * clusterMisses / (end - begin);
+
+            u32 start = begin;
+            u32 runningMisses = 0;
+            _clusterStarts.push_back(begin);
+            for (u32 t = begin; t < end; ++t)
+            {
+                runningMisses += misses[t];
+                u32 runningTriangles = t - start + 1;
+                if (t + 1 < end && runningTriangles >= 8 && (float)runningMisses / runningTriangles <= limit)
+                {
+                    start = t + 1;
+                    runningMisses = 0;
+                    _clusterStarts.push_back(start);
+                }
+            }
+        }
+    }
+}
+
+MeshOptimizer::VertexCacheStatistics& MeshOptimizer::VertexCacheStatistics::operator+=(const VertexCacheStatistics& _other)
+{
+    vertexTransforms += _other.vertexTransforms;
+    triangleCount += _other.triangleCount;
+    vertexCount += _other.vertexCount;
+    return *this;
+}
+
+MeshOptimizer::VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const u32* _indices, size_t _indexCount, size_t _vertexCount, u32 _cacheSize)
+{
+    VertexCacheStatistics statistics;
+    statistics.triangleCount = (u32)(_indexCount / 3);
+
+    std::vector<u32> timestamps(_vertexCount, 0);
+    std::vector<u8> referenced(_vertexCount, 0);
+    u32 time = _cacheSize + 1;
+    for (size_t i = 0; i < _indexCount; ++i)
+    {
+        u32 vertex = _indices[i];
+        if (time - timestamps[vertex] > _cacheSize)
+        {
+            timestamps[vertex] = time++;
+            ++statistics.vertexTransforms;
+        }
+        if (!referenced[vertex])
+        {
+            referenced[vertex] = 1;
+            ++statistics.vertexCount;
+        }
+    }
+    return statistics;
+}
+
+void MeshOptimizer::optimizeVertexCache(u32* _indices, size_t _indexCount, size_t _vertexCount)
+{
+    static const ScoreTables tables;
+
+    size_t triangleCount = _indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangles adjacency, the live triangles of a vertex are kept at the front of its range
+    std::vector<u32> liveTriangles(_vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        ++liveTriangles[_indices[i]];
+
+    std::vector<u32> adjacencyOffsets(_vertexCount + 1, 0);
+    for (size_t v = 0; v < _vertexCount; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+    std::vector<u32> adjacency(triangleCount * 3);
+    {
+        std::vector<u32> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[cursors[_indices[i]]++] = (u32)(i / 3);
+    }
+
+    std::vector<i32> cachePositions(_vertexCount, -1);
+    std::vector<float> vertexScores(_vertexCount);
+    for (size_t v = 0; v < _vertexCount; ++v)
+        vertexScores[v] = vertexScore(tables, -1, liveTriangles[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<u8> emitted(triangleCount, 0);
+    u32 bestTriangle = 0;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const u32* triangle = _indices + t * 3;
+        triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+        if (triangleScores[t] > triangleScores[bestTriangle])
+            bestTriangle = (u32)t;
+    }
+
+    std::vector<u32> output(triangleCount * 3);
+    u32 cache[VertexCacheSize + 3];
+    u32 newCache[VertexCacheSize + 3];
+    u32 cacheCount = 0;
+    size_t scanCursor = 0;
+
+    for (size_t outputTriangle = 0; outputTriangle < triangleCount; ++outputTriangle)
+    {
+        // nothing adjacent to the cache, take the next triangle in input order
+        if (bestTriangle == InvalidIndex)
+        {
+            while (emitted[scanCursor])
+                ++scanCursor;
+            bestTriangle = (u32)scanCursor;
+        }
+
+        const u32 a = _indices[bestTriangle * 3 + 0];
+        const u32 b = _indices[bestTriangle * 3 + 1];
+        const u32 c = _indices[bestTriangle * 3 + 2];
+        output[outputTriangle * 3 + 0] = a;
+        output[outputTriangle * 3 + 1] = b;
+        output[outputTriangle * 3 + 2] = c;
+        emitted[bestTriangle] = 1;
+
+        for (u32 vertex : { a, b, c })
+        {
+            u32* triangles = adjacency.data() + adjacencyOffsets[vertex];
+            u32 count = liveTriangles[vertex];
+            for (u32 i = 0; i < count; ++i)
+            {
+                if (triangles[i] == bestTriangle)
+                {
+                    triangles[i] = triangles[count - 1];
+                    break;
+                }
+            }
+            --liveTriangles[vertex];
+        }
+
+        // the emitted vertices move to the front, the others shift back
+        u32 newCacheCount = 0;
+        newCache[newCacheCount++] = a;
+        newCache[newCacheCount++] = b;
+        newCache[newCacheCount++] = c;
+        for (u32 i = 0; i < cacheCount; ++i)
+        {
+            u32 vertex = cache[i];
+            if (vertex != a && vertex != b && vertex != c)
+                newCache[newCacheCount++] = vertex;
+        }
+        newCacheCount = std::min(newCacheCount, VertexCacheSize + 3);
+
+        for (u32 i = 0; i < newCacheCount; ++i)
+        {
+            u32 vertex = newCache[i];
+            cachePositions[vertex] = i < VertexCacheSize ? (i32)i : -1;
+
+            float score = vertexScore(tables, cachePositions[vertex], liveTriangles[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            const u32* triangles = adjacency.data() + adjacencyOffsets[vertex];
+            for (u32 t = 0; t < liveTriangles[vertex]; ++t)
+                triangleScores[triangles[t]] += delta;
+        }
+
+        // vertices pushed out of the cache were scored above, they don't stay in it
+        cacheCount = std::min(newCacheCount, VertexCacheSize);
+        memcpy(cache, newCache, cacheCount * sizeof(u32));
+
+        bestTriangle = InvalidIndex;
+        float bestScore = 0.0f;
+        for (u32 i = 0; i < cacheCount; ++i)
+        {
+            u32 vertex = cache[i];
+            const u32* triangles = adjacency.data() + adjacencyOffsets[vertex];
+            for (u32 t = 0; t < liveTriangles[vertex]; ++t)
+            {
+                if (bestTriangle == InvalidIndex || triangleScores[triangles[t]] > bestScore)
+                {
+                    bestTriangle = triangles[t];
+                    bestScore = triangleScores[triangles[t]];
+                }
+            }
+        }
+    }
+
+    memcpy(_indices, output.data(), output.size() * sizeof(u32));
+}
+
+void MeshOptimizer::optimizeOverdraw(u32* _indices, size_t _indexCount, const float* _positions, size_t _positionStride, size_t _vertexCount, float _threshold)
+{
+    size_t triangleCount = _indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    std::vector<u32> clusterStarts;
+    buildClusters(_indices, triangleCount, _vertexCount, _threshold, clusterStarts);
+    if (clusterStarts.size() < 2)
+        return;
+
+    auto position = [&](u32 _vertex) { return (const float*)((const u8*)_positions + (size_t)_vertex * _positionStride); };
+
+    // area weighted centroid and normal of every cluster and of the whole mesh
+    struct Cluster
+    {
+        float centroid[3];
+        float normal[3];
+        float area;
+    };
+    std::vector<Cluster> clusters(clusterStarts.size());
+    float meshCentroid[3] = {};
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        size_t begin = clusterStarts[c];
+        size_t end = c + 1 < clusters.size() ? clusterStarts[c + 1] : triangleCount;
+
+        Cluster& cluster = clusters[c];
+        cluster = Cluster{};
+        for (size_t t = begin; t < end; ++t)
+        {
+            const float* p0 = position(_indices[t * 3 + 0]);
+            const float* p1 = position(_indices[t * 3 + 1]);
+            const float* p2 = position(_indices[t * 3 + 2]);
+
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (u32 k = 0; k < 3; ++k)
+            {
+                cluster.centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+                cluster.normal[k] += n[k];
+            }
+            cluster.area += area;
+        }
+
+        for (u32 k = 0; k < 3; ++k)
+            meshCentroid[k] += cluster.centroid[k];
+        meshArea += cluster.area;
+
+        if (cluster.area > 0.0f)
+        {
+            for (u32 k = 0; k < 3; ++k)
+                cluster.centroid[k] /= cluster.area;
+        }
+        float length = sqrtf(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+        if (length > 0.0f)
+        {
+            for (u32 k = 0; k < 3; ++k)
+                cluster.normal[k] /= length;
+        }
+    }
+
+    if (meshArea > 0.0f)
+    {
+        for (u32 k = 0; k < 3; ++k)
+            meshCentroid[k] /= meshArea;
+    }
+
+    // clusters facing away from the mesh center are likely in front, draw them first
+    std::vector<float> sortKeys(clusters.size());
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        const Cluster& cluster = clusters[c];
+        sortKeys[c] = (cluster.centroid[0] - meshCentroid[0]) * cluster.normal[0]
+            + (cluster.centroid[1] - meshCentroid[1]) * cluster.normal[1]
+            + (cluster.centroid[2] - meshCentroid[2]) * cluster.normal[2];
+    }
+
+    std::vector<u32> order(clusters.size());
+    for (u32 c = 0; c < order.size(); ++c)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](u32 _a, u32 _b) { return sortKeys[_a] > sortKeys[_b]; });
+
+    std::vector<u32> output;
+    output.reserve(triangleCount * 3);
+    for (u32 c : order)
+    {
+        size_t begin = clusterStarts[c];
+        size_t end = c + 1 < clusters.size() ? clusterStarts[c + 1] : triangleCount;
+        output.insert(output.end(), _indices + begin * 3, _indices + end * 3);
+    }
+
+    memcpy(_indices, output.data(), output.size() * sizeof(u32));
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(void* _vertices, size_t _vertexCount, size_t _vertexSize, u32* _indices, size_t _indexCount)
+{
+    std::vector<u32> remap(_vertexCount, InvalidIndex);
+    u32 nextVertex = 0;
+    for (size_t i = 0; i < _indexCount; ++i)
+    {
+        u32& vertex = remap[_indices[i]];
+        if (vertex == InvalidIndex)
+            vertex = nextVertex++;
+        _indices[i] = vertex;
+    }
+
+    std::vector<u8> source((const u8*)_vertices, (const u8*)_vertices + _vertexCount * _vertexSize);
+    for (size_t v = 0; v < _vertexCount; ++v)
+    {
+        if (remap[v] != InvalidIndex)
+            memcpy((u8*)_vertices + (size_t)remap[v] * _vertexSize, source.data() + v * _vertexSize, _vertexSize);
+    }
+    return nextVertex;
+}
+
+void MeshOptimizer::buildMeshlets(const u32* _indices, size_t _indexCount, const float* _positions, size_t _positionStride, size_t _vertexCount, std::vector<Meshlet>& _meshlets, u32 _maxVertices, u32 _maxTriangles)
+{
+    auto position = [&](u32 _vertex) { return (const float*)((const u8*)_positions + (size_t)_vertex * _positionStride); };
+
+    // vertex -> last meshlet it was counted in, avoids clearing a set for every meshlet
+    std::vector<u32> vertexMeshlet(_vertexCount, InvalidIndex);
+    std::vector<u32> meshletVertices;
+    meshletVertices.reserve(_maxVertices);
+
+    auto finishMeshlet = [&](Meshlet& _meshlet) {
+        // bounding sphere: box center, radius to the farthest vertex
+        float boundsMin[3] = { position(meshletVertices[0])[0], position(meshletVertices[0])[1], position(meshletVertices[0])[2] };
+        float boundsMax[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+        for (u32 vertex : meshletVertices)
+        {
+            const float* p = position(vertex);
+            for (u32 k = 0; k < 3; ++k)
+            {
+                boundsMin[k] = std::min(boundsMin[k], p[k]);
+                boundsMax[k] = std::max(boundsMax[k], p[k]);
+            }
+        }
+        float radiusSquared = 0.0f;
+        for (u32 k = 0; k < 3; ++k)
+            _meshlet.center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+        for (u32 vertex : meshletVertices)
+        {
+            const float* p = position(vertex);
+            float d[3] = { p[0] - _meshlet.center[0], p[1] - _meshlet.center[1], p[2] - _meshlet.center[2] };
+            radiusSquared = std::max(radiusSquared, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        }
+        _meshlet.radius = sqrtf(radiusSquared);
+
+        // normal cone: average of the unit triangle normals, its spread gives the back facing cutoff
+        std::vector<float> normals;
+        normals.reserve(_meshlet.indexCount);
+        float axis[3] = {};
+        for (u32 i = _meshlet.firstIndex; i < _meshlet.firstIndex + _meshlet.indexCount; i += 3)
+        {
+            const float* p0 = position(_indices[i + 0]);
+            const float* p1 = position(_indices[i + 1]);
+            const float* p2 = position(_indices[i + 2]);
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length == 0.0f)
+                continue; // degenerate triangles are never visible
+            for (u32 k = 0; k < 3; ++k)
+            {
+                normals.push_back(n[k] / length);
+                axis[k] += n[k] / length;
+            }
+        }
+
+        float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        _meshlet.coneCutoff = 1.0f;
+        if (axisLength > 0.0f)
+        {
+            for (u32 k = 0; k < 3; ++k)
+                _meshlet.coneAxis[k] = axis[k] / axisLength;
+
+            float minDot = 1.0f;
+            for (size_t n = 0; n < normals.size(); n += 3)
+                minDot = std::min(minDot, normals[n + 0] * _meshlet.coneAxis[0] + normals[n + 1] * _meshlet.coneAxis[1] + normals[n + 2] * _meshlet.coneAxis[2]);
+
+            // a cone wider than ~84 degrees can't be back facing as a whole
+            if (minDot > 0.1f)
+                _meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+        }
+
+        _meshlets.push_back(_meshlet);
+    };
+
+    Meshlet meshlet;
+    for (size_t i = 0; i + 2 < _indexCount; i += 3)
+    {
+        u32 newVertices = 0;
+        for (u32 k = 0; k < 3; ++k)
+        {
+            if (vertexMeshlet[_indices[i + k]] != (u32)_meshlets.size())
+                ++newVertices;
+        }
+
+        if (meshlet.indexCount > 0 && (meshletVertices.size() + newVertices > _maxVertices || meshlet.indexCount / 3 >= _maxTriangles))
+        {
+            finishMeshlet(meshlet);
+            meshlet = Meshlet{};
+            meshlet.firstIndex = (u32)i;
+            meshletVertices.clear();
+        }
+
+        for (u32 k = 0; k < 3; ++k)
+        {
+            u32 vertex = _indices[i + k];
+            if (vertexMeshlet[vertex] != (u32)_meshlets.size())
+            {
+                vertexMeshlet[vertex] = (u32)_meshlets.size();
+                meshletVertices.push_back(vertex);
+            }
+        }
+        meshlet.indexCount += 3;
+    }
+
+    if (meshlet.indexCount > 0)
+        finishMeshlet(meshlet);
+}
+
+namespace
+{
+    // Sum of squared distances to a set of planes, area weighted (Garland & Heckbert)
+    struct Quadric
+    {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+        double c = 0.0;
+        double weight = 0.0;
+
+        void addPlane(const double _n[3], double _d, double _weight)
+        {
+            a00 += _weight * _n[0] * _n[0]; a01 += _weight * _n[0] * _n[1]; a02 += _weight * _n[0] * _n[2];
+            a11 += _weight * _n[1] * _n[1]; a12 += _weight * _n[1] * _n[2]; a22 += _weight * _n[2] * _n[2];
+            b0 += _weight * _n[0] * _d; b1 += _weight * _n[1] * _d; b2 += _weight * _n[2] * _d;
+            c += _weight * _d * _d;
+            weight += _weight;
+        }
+
+        Quadric& operator+=(const Quadric& _other)
+        {
+            a00 += _other.a00; a01 += _other.a01; a02 += _other.a02;
+            a11 += _other.a11; a12 += _other.a12; a22 += _other.a22;
+            b0 += _other.b0; b1 += _other.b1; b2 += _other.b2;
+            c += _other.c;
+            weight += _other.weight;
+            return *this;
+        }
+
+        // mean squared distance of _p to the planes
+        double error(const float* _p) const
+        {
+            double x = _p[0], y = _p[1], z = _p[2];
+            double e = a00 * x * x + a11 * y * y + a22 * z * z
+                + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                + 2.0 * (b0 * x + b1 * y + b2 * z)
+                + c;
+            return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        u32 from;
+        u32 to;
+        double error;
+    };
+
+    void triangleNormal(const float* _p0, const float* _p1, const float* _p2, double _n[3])
+    {
+        double e1[3] = { (double)_p1[0] - _p0[0], (double)_p1[1] - _p0[1], (double)_p1[2] - _p0[2] };
+        double e2[3] = { (double)_p2[0] - _p0[0], (double)_p2[1] - _p0[1], (double)_p2[2] - _p0[2] };
+        _n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        _n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        _n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+}
+
+size_t MeshOptimizer::simplify(u32* _destination, const u32* _indices, size_t _indexCount, const float* _positions, size_t _positionStride, size_t _vertexCount, size_t _targetIndexCount, float _maxError, float* _resultError)
+{
+    auto position = [&](u32 _vertex) { return (const float*)((const u8*)_positions + (size_t)_vertex * _positionStride); };
+
+    // vertices sharing a position (attribute seams) are merged on their first occurrence
+    std::vector<u32> sorted(_vertexCount);
+    for (u32 v = 0; v < (u32)_vertexCount; ++v)
+        sorted[v] = v;
+    std::sort(sorted.begin(), sorted.end(), [&](u32 _a, u32 _b) { return memcmp(position(_a), position(_b), 3 * sizeof(float)) < 0; });
+
+    std::vector<u32> wedge(_vertexCount);
+    std::vector<u8> locked(_vertexCount, 0);
+    for (size_t i = 0; i < _vertexCount;)
+    {
+        size_t j = i + 1;
+        while (j < _vertexCount && memcmp(position(sorted[i]), position(sorted[j]), 3 * sizeof(float)) == 0)
+            ++j;
+        for (size_t k = i; k < j; ++k)
+        {
+            wedge[sorted[k]] = sorted[i];
+            locked[sorted[k]] = j - i > 1; // seams keep their vertices, collapsing them would tear the attributes
+        }
+        i = j;
+    }
+
+    // open borders are locked too, a directed edge without its twin is on the border
+    std::vector<u64> edges;
+    edges.reserve(_indexCount);
+    for (size_t i = 0; i + 2 < _indexCount; i += 3)
+    {
+        for (u32 k = 0; k < 3; ++k)
+            edges.push_back(((u64)wedge[_indices[i + k]] << 32) | wedge[_indices[i + (k + 1) % 3]]);
+    }
+    std::sort(edges.begin(), edges.end());
+    for (u64 edge : edges)
+    {
+        u32 a = (u32)(edge >> 32);
+        u32 b = (u32)edge;
+        if (!std::binary_search(edges.begin(), edges.end(), ((u64)b << 32) | a))
+        {
+            locked[a] = 1;
+            locked[b] = 1;
+        }
+    }
+
+    std::vector<Quadric> quadrics(_vertexCount);
+    for (size_t i = 0; i + 2 < _indexCount; i += 3)
+    {
+        const float* p0 = position(_indices[i + 0]);
+        double n[3];
+        triangleNormal(p0, position(_indices[i + 1]), position(_indices[i + 2]), n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0)
+            continue;
+        n[0] /= length; n[1] /= length; n[2] /= length;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for (u32 k = 0; k < 3; ++k)
+            quadrics[_indices[i + k]].addPlane(n, d, length * 0.5);
+    }
+
+    size_t indexCount = _indexCount - _indexCount % 3;
+    memcpy(_destination, _indices, indexCount * sizeof(u32));
+
+    double maxError = (double)_maxError * _maxError;
+    double resultError = 0.0;
+    std::vector<u32> triangleOffsets(_vertexCount + 1);
+    std::vector<u32> vertexTriangles;
+    std::vector<Collapse> collapses;
+    std::vector<u32> collapseTarget(_vertexCount);
+    std::vector<u8> touched(_vertexCount);
+
+    // half edge collapses onto existing vertices, in passes of independent collapses sorted by error
+    while (indexCount > _targetIndexCount)
+    {
+        size_t triangleCount = indexCount / 3;
+
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (size_t i = 0; i < indexCount; ++i)
+            ++triangleOffsets[_destination[i] + 1];
+        for (size_t v = 0; v < _vertexCount; ++v)
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        vertexTriangles.resize(indexCount);
+        std::vector<u32> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i)
+            vertexTriangles[fill[_destination[i]]++] = (u32)(i / 3);
+
+        collapses.clear();
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            for (u32 k = 0; k < 3; ++k)
+            {
+                u32 a = _destination[i + k];
+                u32 b = _destination[i + (k + 1) % 3];
+                if (a > b)
+                    continue; // interior edges are seen from both of their triangles, borders are locked
+                if (!locked[a])
+                {
+                    Quadric q = quadrics[a];
+                    q += quadrics[b];
+                    collapses.push_back({ a, b, q.error(position(b)) });
+                }
+                if (!locked[b])
+                {
+                    Quadric q = quadrics[b];
+                    q += quadrics[a];
+                    collapses.push_back({ b, a, q.error(position(a)) });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& _a, const Collapse& _b) { return _a.error < _b.error; });
+
+        // a collapse removes two triangles on a closed surface
+        size_t collapseLimit = std::max<size_t>((triangleCount - _targetIndexCount / 3) / 2, 1);
+        size_t collapseCount = 0;
+        for (u32 v = 0; v < (u32)_vertexCount; ++v)
+            collapseTarget[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapseCount >= collapseLimit || collapse.error > maxError)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // reject the collapse when a remaining triangle around 'from' would flip
+            bool flips = false;
+            for (u32 t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; ++t)
+            {
+                const u32* triangle = _destination + (size_t)vertexTriangles[t] * 3;
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    continue;
+
+                const float* before[3] = { position(triangle[0]), position(triangle[1]), position(triangle[2]) };
+                const float* after[3] = { before[0], before[1], before[2] };
+                for (u32 k = 0; k < 3; ++k)
+                {
+                    if (triangle[k] == collapse.from)
+                        after[k] = position(collapse.to);
+                }
+                double n0[3], n1[3];
+                triangleNormal(before[0], before[1], before[2], n0);
+                triangleNormal(after[0], after[1], after[2], n1);
+                flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0;
+            }
+            if (flips)
+                continue;
+
+            // the triangles around 'from' change, keep their vertices out of this pass
+            for (u32 t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; ++t)
+            {
+                const u32* triangle = _destination + (size_t)vertexTriangles[t] * 3;
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+            collapseTarget[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            resultError = std::max(resultError, collapse.error);
+            ++collapseCount;
+        }
+        if (collapseCount == 0)
+            break;
+
+        size_t writeIndex = 0;
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            u32 a = collapseTarget[_destination[i + 0]];
+            u32 b = collapseTarget[_destination[i + 1]];
+            u32 c = collapseTarget[_destination[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            _destination[writeIndex++] = a;
+            _destination[writeIndex++] = b;
+            _destination[writeIndex++] = c;
+        }
+        indexCount = writeIndex;
+    }
+
+    if (_resultError)
+        *_resultError = (float)sqrt(resultError);
+    return indexCount;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// stl
+#include <cstddef>
+#include <vector>
+
+#include "Common.h"
+
+// Index and vertex reordering passes run on imported meshes before they are cached.
+// Every pass works on a triangle list, indices are relative to the vertex array they are given.
+class MeshOptimizer
+{
+public:
+    static constexpr u32 VertexCacheSize = 32; // cache modelled by optimizeVertexCache
+    static constexpr u32 StatisticsCacheSize = 16; // FIFO used to report ACMR/ATVR
+    static constexpr u32 MeshletMaxVertices = 64;
+    static constexpr u32 MeshletMaxTriangles = 124;
+
+    // Consecutive triangle range of the index buffer with its culling bounds
+    struct Meshlet
+    {
+        u32 firstIndex = 0;
+        u32 indexCount = 0;
+        float center[3]{};
+        float radius = 0.0f;
+        float coneAxis[3]{};
+        float coneCutoff = 1.0f; // back facing when dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius, 1 never culls
+    };
+
+    struct VertexCacheStatistics
+    {
+        u32 vertexTransforms = 0; // cache misses
+        u32 triangleCount = 0;
+        u32 vertexCount = 0;
+
+        float acmr() const { return triangleCount ? (float)vertexTransforms / triangleCount : 0.0f; } // average cache miss ratio, transforms per triangle
+        float atvr() const { return vertexCount ? (float)vertexTransforms / vertexCount : 0.0f; } // average transform to vertex ratio, 1.0 is optimal
+
+        VertexCacheStatistics& operator+=(const VertexCacheStatistics& _other);
+    };
+
+    // Simulate a FIFO post transform cache over the index buffer
+    static VertexCacheStatistics analyzeVertexCache(const u32* _indices, size_t _indexCount, size_t _vertexCount, u32 _cacheSize = StatisticsCacheSize);
+
+    // Reorder triangles for post transform cache reuse (Forsyth, linear speed vertex cache optimisation)
+    static void optimizeVertexCache(u32* _indices, size_t _indexCount, size_t _vertexCount);
+
+    // Split the cache optimized order into clusters and sort them so outward facing clusters are drawn first.
+    // _threshold bounds the ACMR loss allowed by the extra cluster splits (1.05 = 5%).
+    static void optimizeOverdraw(u32* _indices, size_t _indexCount, const float* _positions, size_t _positionStride, size_t _vertexCount, float _threshold = 1.05f);
+
+    // Reorder vertices by first use in the index buffer and rewrite the indices.
+    // Unreferenced vertices are dropped, returns the new vertex count.
+    static size_t optimizeVertexFetch(void* _vertices, size_t _vertexCount, size_t _vertexSize, u32* _indices, size_t _indexCount);
+
+    // Quadric error edge collapse down to _targetIndexCount indices, written to _destination (_indexCount capacity).
+    // Collapses move a vertex onto one of its neighbours so the vertex array is left untouched and shared by every result.
+    // Attribute seams and open borders are locked. Stops early once a collapse would exceed _maxError (distance, in position units).
+    // Returns the index count, _resultError gets the largest error of the applied collapses.
+    static size_t simplify(u32* _destination, const u32* _indices, size_t _indexCount, const float* _positions, size_t _positionStride, size_t _vertexCount,
+        size_t _targetIndexCount, float _maxError, float* _resultError = nullptr);
+
+    // Split the index buffer in order into meshlets of at most _maxVertices unique vertices and _maxTriangles triangles.
+    // Run it on the final index order, the cache optimized order keeps the meshlets compact.
+    static void buildMeshlets(const u32* _indices, size_t _indexCount, const float* _positions, size_t _positionStride, size_t _vertexCount, std::vector<Meshlet>& _meshlets,
+        u32 _maxVertices = MeshletMaxVertices, u32 _maxTriangles = MeshletMaxTriangles);
+};
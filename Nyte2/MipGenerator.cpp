@@ -0,0 +1,348 @@
+#include "MipGenerator.h"
+#include "JobSystem.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+// AVX2 picked at runtime, the engine still runs on CPUs without it
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#define NYTE_MIP_GENERATOR_AVX2 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NYTE_TARGET_AVX2
+#else
+#define NYTE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    constexpr u32 EncodeTableSize = 16384; // linear -> sRGB steps, fine enough for the dark end of the curve
+    constexpr u32 MaxTaps = 16; // Kaiser from a 3 texel level to 1: 14
+    constexpr float KaiserRadius = 2.0f; // in destination texels
+    constexpr float KaiserAlpha = 4.0f;
+    constexpr float Pi = 3.14159265358979f;
+    constexpr u32 BandRows = 16; // destination rows of a job
+
+    struct Tables
+    {
+        float srgbDecode[4 * 256]; // by channel, alpha is linear
+        float linearDecode[4 * 256];
+        u8 encode[EncodeTableSize + 4]; // padded for the 32 bit gathers
+
+        Tables()
+        {
+            for (u32 i = 0; i < 256; ++i)
+            {
+                float c = i / 255.0f;
+                for (u32 channel = 0; channel < 4; ++channel)
+                {
+                    srgbDecode[channel * 256 + i] = channel < 3 ? (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f)) : c;
+                    linearDecode[channel * 256 + i] = c;
+                }
+            }
+            for (u32 i = 0; i < EncodeTableSize; ++i)
+            {
+                float l = i / (float)(EncodeTableSize - 1);
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                encode[i] = (u8)std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f);
+            }
+            memset(encode + EncodeTableSize, 0, 4);
+        }
+    };
+    const Tables& tables()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    // Source texels and weights of one destination texel along an axis, indices clamped to the edge
+    struct Taps
+    {
+        u32 count;
+        u32 index[MaxTaps];
+        float weight[MaxTaps];
+    };
+
+    float sinc(float _x)
+    {
+        return std::abs(_x) < 1e-5f ? 1.0f : std::sin(Pi * _x) / (Pi * _x);
+    }
+
+    float besselI0(float _x)
+    {
+        float sum = 1.0f;
+        float term = 1.0f;
+        for (u32 k = 1; k < 20; ++k)
+        {
+            float half = _x / (2.0f * k);
+            term *= half * half;
+            sum += term;
+        }
+        return sum;
+    }
+
+    // _x in [-1, 1]
+    float kaiser(float _x)
+    {
+        return besselI0(KaiserAlpha * std::sqrt(std::max(1.0f - _x * _x, 0.0f))) / besselI0(KaiserAlpha);
+    }
+
+    std::vector<Taps> buildTaps(MipGenerator::Filter _filter, u32 _source, u32 _destination)
+    {
+        std::vector<Taps> taps(_destination);
+        for (u32 x = 0; x < _destination; ++x)
+        {
+            Taps& tap = taps[x];
+            tap.count = 0;
+            if (_filter == MipGenerator::Box)
+            {
+                u32 x0 = std::min(x * 2, _source - 1);
+                u32 x1 = x + 1 == _destination ? _source : x0 + 2;
+                for (u32 s = x0; s < x1; ++s)
+                {
+                    tap.index[tap.count] = s;
+                    tap.weight[tap.count++] = 1.0f / (x1 - x0);
+                }
+                continue;
+            }
+
+            // Sinc cut off at the destination rate, centered on the destination texel
+            float scale = (float)_source / _destination;
+            float center = (x + 0.5f) * scale;
+            float radius = KaiserRadius * scale;
+            float sum = 0.0f;
+            for (i32 s = (i32)std::floor(center - radius); s <= (i32)std::ceil(center + radius); ++s)
+            {
+                float t = s + 0.5f - center;
+                if (std::abs(t) >= radius)
+                    continue;
+                float weight = sinc(t / scale) * kaiser(t / radius);
+                tap.index[tap.count] = (u32)std::clamp(s, 0, (i32)_source - 1);
+                tap.weight[tap.count++] = weight;
+                sum += weight;
+            }
+            for (u32 t = 0; t < tap.count; ++t)
+                tap.weight[t] /= sum;
+        }
+        return taps;
+    }
+
+    // Row passes, _texels are 4 floats each
+    void decodeRow(float* _texels, const u8* _source, u32 _count, const float* _decode)
+    {
+        for (u32 i = 0; i < _count * 4; ++i)
+            _texels[i] = _decode[(i & 3) * 256 + _source[i]];
+    }
+
+    void filterRow(float* _destination, const float* _texels, const Taps* _taps, u32 _count)
+    {
+        for (u32 x = 0; x < _count; ++x, _destination += 4)
+        {
+            const Taps& taps = _taps[x];
+            float sum[4] = {};
+            for (u32 t = 0; t < taps.count; ++t)
+            {
+                const float* texel = _texels + (size_t)taps.index[t] * 4;
+                for (u32 c = 0; c < 4; ++c)
+                    sum[c] += taps.weight[t] * texel[c];
+            }
+            memcpy(_destination, sum, sizeof(sum));
+        }
+    }
+
+    void accumulateRow(float* _sum, const float* _row, float _weight, u32 _count)
+    {
+        for (u32 i = 0; i < _count * 4; ++i)
+            _sum[i] += _weight * _row[i];
+    }
+
+    void encodeRow(u8* _destination, const float* _texels, u32 _count, bool _srgb)
+    {
+        const Tables& encodeTables = tables();
+        for (u32 i = 0; i < _count * 4; ++i)
+        {
+            float value = std::clamp(_texels[i], 0.0f, 1.0f); // Kaiser lobes overshoot
+            _destination[i] = _srgb && (i & 3) != 3 ? encodeTables.encode[(u32)(value * (EncodeTableSize - 1) + 0.5f)] : (u8)(value * 255.0f + 0.5f);
+        }
+    }
+
+#if NYTE_MIP_GENERATOR_AVX2
+    bool hasAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6; // OSXSAVE, AVX
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    // 2 texels at a time, one gather per 8 channels
+    NYTE_TARGET_AVX2 void decodeRowAvx2(float* _texels, const u8* _source, u32 _count, const float* _decode)
+    {
+        const __m256i channels = _mm256_setr_epi32(0, 256, 512, 768, 0, 256, 512, 768);
+        u32 i = 0;
+        for (; i + 8 <= _count * 4; i += 8)
+        {
+            __m256i values = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(_source + i)));
+            _mm256_storeu_ps(_texels + i, _mm256_i32gather_ps(_decode, _mm256_add_epi32(values, channels), 4));
+        }
+        decodeRow(_texels + i, _source + i, _count - i / 4, _decode);
+    }
+
+    // Neighbour texels share their tap count (all but the last one of a box filter), 2 per register
+    NYTE_TARGET_AVX2 void filterRowAvx2(float* _destination, const float* _texels, const Taps* _taps, u32 _count)
+    {
+        u32 x = 0;
+        for (; x + 2 <= _count; x += 2)
+        {
+            const Taps& left = _taps[x];
+            const Taps& right = _taps[x + 1];
+            if (left.count != right.count)
+            {
+                filterRow(_destination + (size_t)x * 4, _texels, _taps + x, 2);
+                continue;
+            }
+            __m256 sum = _mm256_setzero_ps();
+            for (u32 t = 0; t < left.count; ++t)
+            {
+                __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(_texels + (size_t)left.index[t] * 4)), _mm_loadu_ps(_texels + (size_t)right.index[t] * 4), 1);
+                __m256 weights = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(left.weight[t])), _mm_set1_ps(right.weight[t]), 1);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(texels, weights));
+            }
+            _mm256_storeu_ps(_destination + (size_t)x * 4, sum);
+        }
+        filterRow(_destination + (size_t)x * 4, _texels, _taps + x, _count - x);
+    }
+
+    NYTE_TARGET_AVX2 void accumulateRowAvx2(float* _sum, const float* _row, float _weight, u32 _count)
+    {
+        const __m256 weight = _mm256_set1_ps(_weight);
+        u32 i = 0;
+        for (; i + 8 <= _count * 4; i += 8)
+            _mm256_storeu_ps(_sum + i, _mm256_add_ps(_mm256_loadu_ps(_sum + i), _mm256_mul_ps(_mm256_loadu_ps(_row + i), weight)));
+        accumulateRow(_sum + i, _row + i, _weight, _count - i / 4);
+    }
+
+    // sRGB channels are looked up with a gather, alpha and data channels rounded
+    NYTE_TARGET_AVX2 void encodeRowAvx2(u8* _destination, const float* _texels, u32 _count, bool _srgb)
+    {
+        const float steps = (float)(EncodeTableSize - 1);
+        const __m256 scale = _srgb ? _mm256_setr_ps(steps, steps, steps, 255.0f, steps, steps, steps, 255.0f) : _mm256_set1_ps(255.0f);
+        const __m256i alpha = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+        const int* encode = (const int*)tables().encode;
+        u32 x = 0;
+        for (; x + 2 <= _count; x += 2)
+        {
+            __m256 texels = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(_texels + (size_t)x * 4), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+            __m256i values = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(texels, scale), _mm256_set1_ps(0.5f)));
+            if (_srgb)
+            {
+                __m256i encoded = _mm256_and_si256(_mm256_i32gather_epi32(encode, values, 1), _mm256_set1_epi32(0xFF));
+                values = _mm256_blendv_epi8(encoded, values, alpha);
+            }
+            // 32 -> 8 bits, the 4 channels of a texel end up in the low bytes of each 128 bit lane
+            __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(values, values), _mm256_setzero_si256());
+            i32 texel0 = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+            i32 texel1 = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+            memcpy(_destination + (size_t)x * 4, &texel0, 4);
+            memcpy(_destination + (size_t)x * 4 + 4, &texel1, 4);
+        }
+        encodeRow(_destination + (size_t)x * 4, _texels + (size_t)x * 4, _count - x, _srgb);
+    }
+#endif
+
+    struct RowPasses
+    {
+        void (*decode)(float*, const u8*, u32, const float*);
+        void (*filter)(float*, const float*, const Taps*, u32);
+        void (*accumulate)(float*, const float*, float, u32);
+        void (*encode)(u8*, const float*, u32, bool);
+    };
+    const RowPasses& rowPasses()
+    {
+#if NYTE_MIP_GENERATOR_AVX2
+        static const RowPasses passes = hasAvx2() ? RowPasses{ decodeRowAvx2, filterRowAvx2, accumulateRowAvx2, encodeRowAvx2 } : RowPasses{ decodeRow, filterRow, accumulateRow, encodeRow };
+#else
+        static const RowPasses passes{ decodeRow, filterRow, accumulateRow, encodeRow };
+#endif
+        return passes;
+    }
+}
+
+u32 MipGenerator::mipLevelCount(u32 _width, u32 _height)
+{
+    u32 levels = 1;
+    for (u32 size = std::max(_width, _height); size > 1; size >>= 1)
+        ++levels;
+    return levels;
+}
+
+void MipGenerator::downsample(u8* _destination, const u8* _source, u32 _width, u32 _height, bool _srgb, Filter _filter, JobSystem* _jobSystem)
+{
+    const RowPasses& passes = rowPasses();
+    const float* decode = _srgb ? tables().srgbDecode : tables().linearDecode;
+    u32 width = mipSize(_width, 1);
+    u32 height = mipSize(_height, 1);
+    std::vector<Taps> columns = buildTaps(_filter, _width, width);
+    std::vector<Taps> rows = buildTaps(_filter, _height, height);
+
+    // Separable: the source rows a band reads are filtered horizontally once, then combined into each destination row
+    auto band = [&](u32 _band)
+    {
+        u32 y0 = _band * BandRows;
+        u32 y1 = std::min(y0 + BandRows, height);
+        u32 first = _height;
+        u32 last = 0;
+        for (u32 y = y0; y < y1; ++y)
+        {
+            for (u32 t = 0; t < rows[y].count; ++t)
+            {
+                first = std::min(first, rows[y].index[t]);
+                last = std::max(last, rows[y].index[t]);
+            }
+        }
+
+        std::vector<float> decoded((size_t)_width * 4);
+        std::vector<float> filtered((size_t)(last - first + 1) * width * 4);
+        for (u32 sy = first; sy <= last; ++sy)
+        {
+            passes.decode(decoded.data(), _source + (size_t)sy * _width * 4, _width, decode);
+            passes.filter(filtered.data() + (size_t)(sy - first) * width * 4, decoded.data(), columns.data(), width);
+        }
+
+        std::vector<float> sum((size_t)width * 4);
+        for (u32 y = y0; y < y1; ++y)
+        {
+            std::fill(sum.begin(), sum.end(), 0.0f);
+            for (u32 t = 0; t < rows[y].count; ++t)
+                passes.accumulate(sum.data(), filtered.data() + (size_t)(rows[y].index[t] - first) * width * 4, rows[y].weight[t], width);
+            passes.encode(_destination + (size_t)y * width * 4, sum.data(), width, _srgb);
+        }
+    };
+
+    u32 bandCount = (height + BandRows - 1) / BandRows;
+    if (_jobSystem && bandCount > 1)
+        _jobSystem->parallelFor(bandCount, band);
+    else
+    {
+        for (u32 b = 0; b < bandCount; ++b)
+            band(b);
+    }
+}
+
+void MipGenerator::generate(u8* const* _levels, u32 _width, u32 _height, u32 _levelCount, bool _srgb, Filter _filter, JobSystem* _jobSystem)
+{
+    for (u32 level = 1; level < _levelCount; ++level)
+        downsample(_levels[level], _levels[level - 1], mipSize(_width, level - 1), mipSize(_height, level - 1), _srgb, _filter, _jobSystem);
+}
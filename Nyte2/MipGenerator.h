@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Common.h"
+
+class JobSystem;
+
+// CPU mip chains of RGBA8 images, built offline by NyteCook and at load time so the GPU only uploads them.
+// sRGB color is filtered in linear space, alpha and the channels of data textures (normals, roughness...) as is.
+// Rows are split across the job system, AVX2 is used when the CPU has it.
+class MipGenerator
+{
+public:
+    enum Filter : u32
+    {
+        Box = 0, // 2x2 average, an odd last row/column is folded into the previous one
+        Kaiser, // Kaiser windowed sinc over 8 texels each way, keeps distant textures sharp
+    };
+
+    static u32 mipLevelCount(u32 _width, u32 _height);
+    static u32 mipSize(u32 _size, u32 _level) { return _size >> _level ? _size >> _level : 1; }
+
+    // One level into the next (max(width / 2, 1) x max(height / 2, 1))
+    static void downsample(u8* _destination, const u8* _source, u32 _width, u32 _height, bool _srgb = true, Filter _filter = Box, JobSystem* _jobSystem = nullptr);
+    // Levels 1 to _levelCount - 1, each from the previous one. _levels[l] holds mipSize(_width, l) x mipSize(_height, l) texels, level 0 filled.
+    static void generate(u8* const* _levels, u32 _width, u32 _height, u32 _levelCount, bool _srgb, Filter _filter, JobSystem* _jobSystem = nullptr);
+};
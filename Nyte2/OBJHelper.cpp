@@ -0,0 +1,484 @@
+#include "OBJHelper.h"
+#include "FileHelper.h"
+#include "JobSystem.h"
+#include "VertexWelder.h"
+#include <unordered_map>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <charconv>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <cmath>
+
+namespace
+{
+    constexpr size_t MinChunkSize = 256 * 1024; // smaller chunks cost more in jobs than they save
+    constexpr u32 ChunksPerThread = 4; // line lengths vary, more chunks than threads balances them
+
+    enum StatementType : u32
+    {
+        Object,
+        UseMaterial,
+        MaterialLibrary,
+    };
+
+    // Statements splitting the faces, in file order. firstCorner is the chunk corner count when it was read.
+    struct Statement
+    {
+        StatementType type;
+        u32 firstCorner;
+        std::string name;
+    };
+
+    struct Chunk
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+
+        // counted by the first pass, the bases are the counts of the chunks before
+        u32 positionCount = 0, normalCount = 0, uvCount = 0;
+        u32 positionBase = 0, normalBase = 0, uvBase = 0;
+
+        std::vector<VertexWelder::Key> corners; // triangles, polygons are fan triangulated
+        std::vector<Statement> statements;
+    };
+
+    // Corners of one submesh, read from consecutive corners of a chunk
+    struct CornerRun
+    {
+        u32 chunk;
+        u32 firstCorner;
+        u32 cornerCount;
+    };
+    struct ObjSubMesh
+    {
+        int materialIndex;
+        std::vector<CornerRun> runs;
+    };
+    struct ObjMesh
+    {
+        std::vector<ObjSubMesh> subMeshes;
+        u32 cornerCount = 0;
+    };
+
+    inline bool isSpace(char _c) { return _c == ' ' || _c == '\t'; }
+
+    inline const char* skipSpaces(const char* _p, const char* _end)
+    {
+        while (_p < _end && isSpace(*_p))
+            ++_p;
+        return _p;
+    }
+
+    inline const char* lineEnd(const char* _p, const char* _end)
+    {
+        const char* end = (const char*)memchr(_p, '\n', _end - _p);
+        return end ? end : _end;
+    }
+
+    // Keyword at _p followed by a space
+    inline bool keyword(const char* _p, const char* _end, const char* _keyword, size_t _length)
+    {
+        return (size_t)(_end - _p) > _length && memcmp(_p, _keyword, _length) == 0 && isSpace(_p[_length]);
+    }
+
+    // Rest of the line without the trailing spaces and '\r'
+    inline std::string lineArgument(const char* _p, const char* _end)
+    {
+        _p = skipSpaces(_p, _end);
+        while (_end > _p && (isSpace(_end[-1]) || _end[-1] == '\r'))
+            --_end;
+        return std::string(_p, _end);
+    }
+
+    inline const char* parseFloat(const char* _p, const char* _end, float& _value)
+    {
+        _p = skipSpaces(_p, _end);
+        if (_p < _end && *_p == '+')
+            ++_p;
+        std::from_chars_result result = std::from_chars(_p, _end, _value);
+        if (result.ec != std::errc{})
+            _value = 0.0f;
+        return result.ptr;
+    }
+
+    // 1 based index, negative ones count back from the last element read. 0 when the index is missing.
+    inline const char* parseIndex(const char* _p, const char* _end, i64& _index)
+    {
+        _index = 0;
+        std::from_chars_result result = std::from_chars(_p, _end, _index);
+        return result.ptr;
+    }
+
+    inline i32 resolveIndex(i64 _index, u32 _readCount, u32 _totalCount)
+    {
+        if (_index == 0)
+            return -1;
+        i64 index = _index > 0 ? _index - 1 : (i64)_readCount + _index;
+        if (index < 0 || index >= (i64)_totalCount)
+            throw std::runtime_error("Invalid obj face index");
+        return (i32)index;
+    }
+
+    void countElements(Chunk& _chunk)
+    {
+        for (const char* line = _chunk.begin; line < _chunk.end;)
+        {
+            const char* end = lineEnd(line, _chunk.end);
+            const char* p = skipSpaces(line, end);
+            if (end - p > 1 && p[0] == 'v')
+            {
+                if (isSpace(p[1]))
+                    ++_chunk.positionCount;
+                else if (p[1] == 'n' && keyword(p, end, "vn", 2))
+                    ++_chunk.normalCount;
+                else if (p[1] == 't' && keyword(p, end, "vt", 2))
+                    ++_chunk.uvCount;
+            }
+            line = end + 1;
+        }
+    }
+
+    void parseChunk(Chunk& _chunk, std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs)
+    {
+        u32 positionCount = _chunk.positionBase, normalCount = _chunk.normalBase, uvCount = _chunk.uvBase;
+        std::vector<VertexWelder::Key> polygon;
+
+        for (const char* line = _chunk.begin; line < _chunk.end;)
+        {
+            const char* end = lineEnd(line, _chunk.end);
+            const char* p = skipSpaces(line, end);
+            line = end + 1;
+            if (p == end)
+                continue;
+
+            if (p[0] == 'v' && end - p > 1)
+            {
+                if (isSpace(p[1]))
+                {
+                    glm::vec3& position = _positions[positionCount++];
+                    p = parseFloat(p + 1, end, position.x);
+                    p = parseFloat(p, end, position.y);
+                    parseFloat(p, end, position.z);
+                }
+                else if (keyword(p, end, "vn", 2))
+                {
+                    glm::vec3& normal = _normals[normalCount++];
+                    p = parseFloat(p + 2, end, normal.x);
+                    p = parseFloat(p, end, normal.y);
+                    parseFloat(p, end, normal.z);
+                }
+                else if (keyword(p, end, "vt", 2))
+                {
+                    // a third w coordinate is ignored
+                    glm::vec2& uv = _uvs[uvCount++];
+                    p = parseFloat(p + 2, end, uv.x);
+                    parseFloat(p, end, uv.y);
+                }
+            }
+            else if (keyword(p, end, "f", 1))
+            {
+                // v, v/vt, v//vn or v/vt/vn per corner
+                polygon.clear();
+                for (p = skipSpaces(p + 1, end); p < end && *p != '\r'; p = skipSpaces(p, end))
+                {
+                    i64 position, uv = 0, normal = 0;
+                    p = parseIndex(p, end, position);
+                    if (p < end && *p == '/')
+                    {
+                        p = parseIndex(p + 1, end, uv);
+                        if (p < end && *p == '/')
+                            p = parseIndex(p + 1, end, normal);
+                    }
+                    if (position == 0)
+                        throw std::runtime_error("Invalid obj face");
+
+                    VertexWelder::Key corner;
+                    corner.position = resolveIndex(position, positionCount, (u32)_positions.size());
+                    corner.normal = resolveIndex(normal, normalCount, (u32)_normals.size());
+                    corner.uv = resolveIndex(uv, uvCount, (u32)_uvs.size());
+                    polygon.push_back(corner);
+                }
+                for (size_t c = 2; c < polygon.size(); ++c)
+                {
+                    _chunk.corners.push_back(polygon[0]);
+                    _chunk.corners.push_back(polygon[c - 1]);
+                    _chunk.corners.push_back(polygon[c]);
+                }
+            }
+            else if (keyword(p, end, "o", 1))
+                _chunk.statements.push_back({ Object, (u32)_chunk.corners.size(), lineArgument(p + 1, end) });
+            else if (keyword(p, end, "usemtl", 6))
+                _chunk.statements.push_back({ UseMaterial, (u32)_chunk.corners.size(), lineArgument(p + 6, end) });
+            else if (keyword(p, end, "mtllib", 6))
+                _chunk.statements.push_back({ MaterialLibrary, (u32)_chunk.corners.size(), lineArgument(p + 6, end) });
+            // comments, groups, smoothing groups, lines and points are skipped
+        }
+    }
+
+    // Smooth normals for the corners exported without "vn": face normals weighted by the corner angle, summed per position
+    // so uv seams don't split the shading. _keys is the welded triangle list, _firstCorners the corner of every vertex.
+    void generateNormals(const std::vector<VertexWelder::Key>& _keys, const std::vector<glm::vec3>& _positions, const std::vector<u32>& _firstCorners, std::vector<FBXVertex>& _vertices)
+    {
+        std::unordered_map<i32, u32> positionSlots;
+        positionSlots.reserve(_vertices.size());
+        std::vector<u32> cornerSlots(_keys.size());
+        for (size_t c = 0; c < _keys.size(); ++c)
+            cornerSlots[c] = positionSlots.try_emplace(_keys[c].position, (u32)positionSlots.size()).first->second;
+
+        std::vector<glm::vec3> sums(positionSlots.size(), glm::vec3(0.0f));
+        for (size_t t = 0; t + 2 < _keys.size(); t += 3)
+        {
+            glm::vec3 corners[3] = { _positions[_keys[t].position], _positions[_keys[t + 1].position], _positions[_keys[t + 2].position] };
+            glm::vec3 faceNormal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            float length = glm::length(faceNormal);
+            if (!(length > 0.0f))
+                continue;
+            faceNormal /= length;
+
+            for (u32 c = 0; c < 3; ++c)
+            {
+                glm::vec3 edge1 = corners[(c + 1) % 3] - corners[c];
+                glm::vec3 edge2 = corners[(c + 2) % 3] - corners[c];
+                float lengths = glm::length(edge1) * glm::length(edge2);
+                float angle = lengths > 0.0f ? std::acos(glm::clamp(glm::dot(edge1, edge2) / lengths, -1.0f, 1.0f)) : 0.0f;
+                sums[cornerSlots[t + c]] += faceNormal * angle;
+            }
+        }
+
+        for (size_t v = 0; v < _vertices.size(); ++v)
+        {
+            u32 corner = _firstCorners[v];
+            if (_keys[corner].normal >= 0)
+                continue;
+            glm::vec3 sum = sums[cornerSlots[corner]];
+            float length = glm::length(sum);
+            _vertices[v].normal = length > 0.0f ? sum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+    }
+}
+
+void OBJHelper::loadMaterialLibrary(const std::string& _mtlPath, std::vector<FBXMaterial>& _materials)
+{
+    std::ifstream file(_mtlPath);
+    if (!file.is_open())
+    {
+        std::cout << "\t\t missing material library " << _mtlPath << "\n";
+        return;
+    }
+    std::filesystem::path directory = std::filesystem::path(_mtlPath).parent_path();
+
+    // map options (-bm 1.0, ...) are skipped, the file name is the last argument
+    auto texturePath = [&](const std::string& _arguments) {
+        size_t start = _arguments.find_last_of(" \t");
+        std::string fileName = start == std::string::npos ? _arguments : _arguments.substr(start + 1);
+        return fileName.empty() ? fileName : (directory / fileName).generic_string();
+    };
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const char* begin = line.data();
+        const char* end = begin + line.size();
+        const char* p = skipSpaces(begin, end);
+
+        if (keyword(p, end, "newmtl", 6))
+        {
+            _materials.emplace_back();
+            _materials.back().name = lineArgument(p + 6, end);
+            continue;
+        }
+        if (_materials.empty())
+            continue;
+
+        FBXMaterial& material = _materials.back();
+        if (keyword(p, end, "map_Kd", 6))
+            material.diffuse = texturePath(lineArgument(p + 6, end));
+        else if (keyword(p, end, "map_Bump", 8) || keyword(p, end, "map_bump", 8))
+            material.normal = texturePath(lineArgument(p + 8, end));
+        else if (keyword(p, end, "bump", 4) || keyword(p, end, "norm", 4))
+            material.normal = texturePath(lineArgument(p + 4, end));
+        else if (keyword(p, end, "map_Ks", 6))
+            material.specular = texturePath(lineArgument(p + 6, end));
+        else if (keyword(p, end, "map_Ns", 6))
+            material.glossiness = texturePath(lineArgument(p + 6, end));
+    }
+}
+
+void OBJHelper::loadOBJ(FBXScene& _scene, JobSystem* _jobSystem, const std::function<void(u32)>& _meshReady)
+{
+    MappedFile file = FileHelper::mapFile(_scene.filePath);
+    const char* data = file.data();
+    const char* dataEnd = data + file.size();
+
+    u32 threadCount = _jobSystem ? _jobSystem->getThreadCount() : 1;
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    // Line aligned chunks
+    size_t chunkSize = std::max(MinChunkSize, file.size() / ((size_t)threadCount * ChunksPerThread) + 1);
+    std::vector<Chunk> chunks;
+    for (const char* begin = data; begin < dataEnd;)
+    {
+        const char* end = begin + std::min(chunkSize, (size_t)(dataEnd - begin));
+        end = end < dataEnd ? lineEnd(end, dataEnd) : dataEnd;
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = end;
+        begin = end + 1;
+    }
+    u32 chunkCount = (u32)chunks.size();
+
+    auto forEachChunk = [&](const std::function<void(u32)>& _job) {
+        if (_jobSystem)
+            _jobSystem->parallelFor(chunkCount, _job);
+        else
+            for (u32 c = 0; c < chunkCount; ++c)
+                _job(c);
+    };
+
+    // First pass counts the elements so the second one writes them in place, negative indices need the global counts too
+    forEachChunk([&](u32 _chunk) { countElements(chunks[_chunk]); });
+
+    u32 positionCount = 0, normalCount = 0, uvCount = 0;
+    for (Chunk& chunk : chunks)
+    {
+        chunk.positionBase = positionCount;
+        chunk.normalBase = normalCount;
+        chunk.uvBase = uvCount;
+        positionCount += chunk.positionCount;
+        normalCount += chunk.normalCount;
+        uvCount += chunk.uvCount;
+    }
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec3> normals(normalCount);
+    std::vector<glm::vec2> uvs(uvCount);
+
+    forEachChunk([&](u32 _chunk) { parseChunk(chunks[_chunk], positions, normals, uvs); });
+
+    float parseTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+    std::cout << "\t\t obj parse " << parseTime << "ms (" << chunkCount << " chunks, " << threadCount << " thread" << (threadCount > 1 ? "s" : "") << ")\n";
+
+    // Objects and materials in file order, faces before the first "o" go to an unnamed object
+    std::filesystem::path directory = std::filesystem::path(_scene.filePath).parent_path();
+    std::vector<FBXMaterial> libraryMaterials;
+    std::unordered_map<std::string, int> materialIndices;
+    std::vector<ObjMesh> objMeshes(1);
+    int materialIndex = -1;
+
+    auto addRun = [&](u32 _chunk, u32 _firstCorner, u32 _lastCorner) {
+        if (_lastCorner == _firstCorner)
+            return;
+        ObjMesh& objMesh = objMeshes.back();
+        auto subMesh = std::find_if(objMesh.subMeshes.begin(), objMesh.subMeshes.end(), [&](const ObjSubMesh& _subMesh) { return _subMesh.materialIndex == materialIndex; });
+        if (subMesh == objMesh.subMeshes.end())
+            subMesh = objMesh.subMeshes.insert(objMesh.subMeshes.end(), ObjSubMesh{ materialIndex });
+        subMesh->runs.push_back({ _chunk, _firstCorner, _lastCorner - _firstCorner });
+        objMesh.cornerCount += _lastCorner - _firstCorner;
+    };
+
+    for (u32 c = 0; c < chunkCount; ++c)
+    {
+        const Chunk& chunk = chunks[c];
+        u32 corner = 0;
+        for (const Statement& statement : chunk.statements)
+        {
+            addRun(c, corner, statement.firstCorner);
+            corner = statement.firstCorner;
+
+            if (statement.type == Object)
+            {
+                if (objMeshes.back().cornerCount > 0)
+                    objMeshes.emplace_back();
+            }
+            else if (statement.type == MaterialLibrary)
+                loadMaterialLibrary((directory / statement.name).generic_string(), libraryMaterials);
+            else
+            {
+                auto it = materialIndices.find(statement.name);
+                if (it == materialIndices.end())
+                {
+                    // materials are declared by mtllib before they are used
+                    auto material = std::find_if(libraryMaterials.begin(), libraryMaterials.end(), [&](const FBXMaterial& _material) { return _material.name == statement.name; });
+                    FBXMaterial fbxMaterial;
+                    if (material != libraryMaterials.end())
+                        fbxMaterial = *material;
+                    fbxMaterial.name = statement.name;
+                    _scene.materials.push_back(fbxMaterial);
+                    it = materialIndices.emplace(statement.name, (int)_scene.materials.size() - 1).first;
+                }
+                materialIndex = it->second;
+            }
+        }
+        addRun(c, corner, (u32)chunk.corners.size());
+    }
+    if (objMeshes.back().cornerCount == 0)
+        objMeshes.pop_back();
+
+    u32 meshCount = (u32)objMeshes.size();
+    _scene.meshes.resize(meshCount);
+    // OBJ has no node hierarchy, every object is placed once where it was modeled
+    for (u32 m = 0; m < meshCount; ++m)
+        _scene.instances.push_back({ m, glm::mat4(1.0f) });
+    std::vector<FBXHelper::MeshStatistics> statistics(meshCount);
+    auto importStartTime = std::chrono::high_resolution_clock::now();
+
+    auto importJob = [&](u32 _mesh) {
+        const ObjMesh& objMesh = objMeshes[_mesh];
+        FBXMesh& fbxMesh = _scene.meshes[_mesh];
+        FBXHelper::MeshStatistics& meshStatistics = statistics[_mesh];
+        auto weldStartTime = std::chrono::high_resolution_clock::now();
+
+        // corners grouped by submesh, the welded indices are already in submesh order
+        std::vector<VertexWelder::Key> keys;
+        keys.reserve(objMesh.cornerCount);
+        for (const ObjSubMesh& objSubMesh : objMesh.subMeshes)
+        {
+            FBXSubMesh subMesh;
+            subMesh.firstIndex = (u32)keys.size();
+            for (const CornerRun& run : objSubMesh.runs)
+            {
+                const VertexWelder::Key* corners = chunks[run.chunk].corners.data() + run.firstCorner;
+                keys.insert(keys.end(), corners, corners + run.cornerCount);
+            }
+            subMesh.indexCount = (u32)keys.size() - subMesh.firstIndex;
+            subMesh.materialIndex = objSubMesh.materialIndex;
+            subMesh.lods[0].firstIndex = subMesh.firstIndex;
+            subMesh.lods[0].indexCount = subMesh.indexCount;
+            fbxMesh.m_subMeshes.push_back(subMesh);
+        }
+
+        std::vector<u32> firstCorners;
+        VertexWelder::weld(keys.data(), (u32)keys.size(), fbxMesh.m_indices, firstCorners, _jobSystem);
+
+        fbxMesh.m_vertices.resize(firstCorners.size());
+        for (size_t v = 0; v < firstCorners.size(); ++v)
+        {
+            const VertexWelder::Key& key = keys[firstCorners[v]];
+            FBXVertex& vertex = fbxMesh.m_vertices[v];
+            vertex.pos = positions[key.position];
+            vertex.normal = key.normal >= 0 ? normals[key.normal] : glm::vec3(0.0f);
+            vertex.texCoords = key.uv >= 0 ? uvs[key.uv] : glm::vec2(0.0f);
+        }
+        // before the tangents, they are built on the vertex normals
+        if (std::any_of(keys.begin(), keys.end(), [](const VertexWelder::Key& _key) { return _key.normal < 0; }))
+            generateNormals(keys, positions, firstCorners, fbxMesh.m_vertices);
+        meshStatistics.corners = (u32)keys.size();
+        meshStatistics.vertices = (u32)fbxMesh.m_vertices.size();
+        meshStatistics.weldTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - weldStartTime).count();
+
+        FBXHelper::finishMesh(fbxMesh, meshStatistics, _jobSystem);
+        if (_meshReady)
+            _meshReady(_mesh);
+    };
+    if (_jobSystem)
+        _jobSystem->parallelFor(meshCount, importJob);
+    else
+        for (u32 m = 0; m < meshCount; ++m)
+            importJob(m);
+
+    float importTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - importStartTime).count();
+    FBXHelper::logStatistics(statistics, importTime);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// stl
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "Common.h"
+#include "FBXHelper.h"
+
+class JobSystem;
+
+// Wavefront OBJ import into the FBX import structures, the meshes go through the same optimize, LODs, meshlets and mesh cache path.
+// The file is parsed in line aligned chunks, one job per chunk, then every object is welded on its v/vt/vn indices as its own job.
+// Each "o" starts a mesh, each material used by it a submesh. Texture coordinates are kept as stored, like the FBX ones.
+// Corners without "vn" get smooth normals generated from the faces, weighted by the corner angles.
+class OBJHelper
+{
+public:
+    // Same contract as FBXHelper::loadFBX, nullptr parses on the calling thread
+    static void loadOBJ(FBXScene& _scene, JobSystem* _jobSystem = nullptr, const std::function<void(u32)>& _meshReady = nullptr);
+
+    // Texture maps of every material of a .mtl file, appended to _materials. Paths are resolved from the .mtl directory.
+    static void loadMaterialLibrary(const std::string& _mtlPath, std::vector<FBXMaterial>& _materials);
+};
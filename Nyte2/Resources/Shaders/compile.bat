@@ -12,6 +12,17 @@ for %%f in (*.glsl) do (
     @echo ------------------------------------------
 )
 
+for %%f in (*.comp) do (
+    @echo Compiling %%~nf.comp compute stage
+    %Vulkan_SDK%/Bin/glslc.exe %%~nf.comp -o %%~nf_cs.spv -D_COMPUTE_SHADER=1
+    @echo ------------------------------------------
+)
+
+@REM Vertex format variants
+@echo Compiling offscreen_gbuffer.glsl packed vertex stage
+%Vulkan_SDK%/Bin/glslc.exe offscreen_gbuffer.glsl -o offscreen_gbuffer_packed_vs.spv -D_VERTEX_SHADER=1 -D_PACKED_VERTEX=1
+@echo ------------------------------------------
+
 
 
 
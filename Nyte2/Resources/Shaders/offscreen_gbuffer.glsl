@@ -11,25 +11,91 @@ layout(set = 0, binding = 0) uniform UniformBufferObject
     mat4 proj;
 } ubo_MVP;
 
+// Engine InstanceTransform
+struct Instance
+{
+    vec4 rows[3]; // affine, row major
+    vec4 normalRows[3]; // inverse transpose, row major. normalRows[0].w: determinant sign
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Instances
+{
+    Instance instances[];
+} sb_Instances;
+
+// Written by cluster_cull.comp, the draw firstInstance points at the meshlet slots
+layout(std430, set = 1, binding = 1) readonly buffer VisibleInstances
+{
+    uint visibleInstances[];
+} sb_VisibleInstances;
+
+#if _PACKED_VERTEX
+// VertexPacked: unorm16 position with the tangent in w, octahedral snorm16 normal, half float uv
+layout(push_constant) uniform PushConstants
+{
+    vec4 positionScale;
+    vec4 positionOffset;
+} pc_Dequant;
+
+layout(location = 0) in vec4 inPackedPosition;
+layout(location = 1) in vec2 inPackedNormal;
+layout(location = 2) in vec2 inTexCoords;
+
+vec3 decodeOctahedral(vec2 _e)
+{
+    vec3 n = vec3(_e, 1.0 - abs(_e.x) - abs(_e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// VertexPacked::encodeTangent: 15 bit angle in the basis of the normal (VertexPacked::tangentBasis), bitangent sign in the top bit
+vec4 decodeTangent(vec3 _normal, float _encoded)
+{
+    uint bits = uint(_encoded * 65535.0 + 0.5);
+    float angle = float(bits & 0x7FFFu) * (6.28318531 / 32767.0) - 3.14159265;
+
+    float s = _normal.z >= 0.0 ? 1.0 : -1.0;
+    float a = -1.0 / (s + _normal.z);
+    float b = _normal.x * _normal.y * a;
+    vec3 b1 = vec3(1.0 + s * _normal.x * _normal.x * a, s * b, -s * _normal.x);
+    vec3 b2 = vec3(b, s + _normal.y * _normal.y * a, -_normal.y);
+    return vec4(cos(angle) * b1 + sin(angle) * b2, (bits & 0x8000u) != 0u ? -1.0 : 1.0);
+}
+#else
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoords;
+layout(location = 3) in vec4 inTangent; // w: bitangent sign
+#endif
 
 layout(location = 0) out vec3 outWorldPos;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec2 outTexCoords;
+layout(location = 3) out vec4 outTangent;
 
 out gl_PerVertex {
     vec4 gl_Position;
 };
 
 void main() {
-    mat4 mvp = ubo_MVP.proj * ubo_MVP.view * ubo_MVP.model;
-    gl_Position = mvp * vec4(inPosition, 1.0);
+#if _PACKED_VERTEX
+    vec3 inPosition = inPackedPosition.xyz * pc_Dequant.positionScale.xyz + pc_Dequant.positionOffset.xyz;
+    vec3 inNormal = decodeOctahedral(inPackedNormal);
+    vec4 inTangent = decodeTangent(inNormal, inPackedPosition.w);
+#endif
+    Instance instance = sb_Instances.instances[sb_VisibleInstances.visibleInstances[gl_InstanceIndex]];
+    mat4 model = ubo_MVP.model * transpose(mat4(instance.rows[0], instance.rows[1], instance.rows[2], vec4(0.0, 0.0, 0.0, 1.0)));
+
+    outWorldPos = (model * vec4(inPosition, 1.0)).xyz;
+    gl_Position = ubo_MVP.proj * ubo_MVP.view * vec4(outWorldPos, 1.0);
 
-    outWorldPos = (ubo_MVP.model * vec4(inPosition, 1.0)).xyz;
-    //outNormal = (mvp * vec4(inNormal, 1.0)).xyz;
-    outNormal = (ubo_MVP.model * vec4(inNormal, 1.0)).xyz;
+    // directions, the model translation must not apply. Node transforms may scale non uniformly, normals take the inverse transpose
+    // precomputed per instance (ubo_MVP.model only rotates). Mirrored instances flip the bitangent.
+    mat3 normalMatrix = mat3(ubo_MVP.model) * transpose(mat3(instance.normalRows[0].xyz, instance.normalRows[1].xyz, instance.normalRows[2].xyz));
+    outNormal = normalize(normalMatrix * inNormal);
+    outTangent = vec4(normalize(mat3(model) * inTangent.xyz), inTangent.w * instance.normalRows[0].w);
     outTexCoords = vec2(inTexCoords.x, 1.0f-inTexCoords.y);
 }
 #endif
@@ -47,6 +113,7 @@ layout(set = 0, binding = 4) uniform sampler2D glossinessSampler;
 layout(location = 0) in vec3 inWorldPos;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoords;
+layout(location = 3) in vec4 inTangent;
 
 layout(location = 0) out vec4 outWorldPos;
 layout(location = 1) out vec4 outColor;
@@ -58,13 +125,14 @@ void main() {
 
     outColor = texture(diffuseSampler, inTexCoords);
 
-    vec3 N = normalize(inNormal);
-	vec3 T = normalize(cross(N, vec3(0.0f, 0.0f, 1.0f)));
-	vec3 B = normalize(cross(N, T));
-    //T = normalize(cross(B, T));
-	mat3 TBN = mat3(T, B, N);
-	outNormal = vec4(normalize(TBN * texture(normalSampler, inTexCoords).xyz), 1.0f);
-    //outNormal = vec4(N*0.5f + 0.5f, 1.0f);
+    // Tangent frame from the vertices (TangentGenerator), MikkTSpace reconstruction: unnormalized interpolated vectors, one normalize at the end
+    vec3 B = inTangent.w * cross(inNormal, inTangent.xyz);
+    // two channel normal maps (BC5): z rebuilt from x and y
+    vec3 tangentNormal;
+    tangentNormal.xy = texture(normalSampler, inTexCoords).xy * 2.0f - 1.0f;
+    tangentNormal.z = sqrt(max(1.0f - dot(tangentNormal.xy, tangentNormal.xy), 0.0f));
+    outNormal = vec4(normalize(tangentNormal.x * inTangent.xyz + tangentNormal.y * B + tangentNormal.z * inNormal), 1.0f);
+    //outNormal = vec4(normalize(inNormal)*0.5f + 0.5f, 1.0f);
 
     outSpecGloss.rgb = texture(specularSampler, inTexCoords).rbg;
     outSpecGloss.a = texture(glossinessSampler, inTexCoords).r;
@@ -0,0 +1,162 @@
+#include "TangentGenerator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace
+{
+    constexpr u32 ChunkSize = 16 * 1024; // triangles or vertices per job
+    constexpr float DegenerateUvArea = 1e-20f; // twice the signed uv area, below it the triangle has no uv gradient
+
+    void parallelRun(JobSystem* _jobSystem, u32 _count, const std::function<void(u32)>& _job)
+    {
+        if (_jobSystem)
+        {
+            _jobSystem->parallelFor(_count, _job);
+            return;
+        }
+        for (u32 i = 0; i < _count; ++i)
+            _job(i);
+    }
+
+    inline glm::vec3 safeNormalize(const glm::vec3& _v)
+    {
+        float lengthSquared = glm::dot(_v, _v);
+        return lengthSquared > 1e-30f ? _v / std::sqrt(lengthSquared) : glm::vec3(0.0f);
+    }
+
+    inline glm::vec3 projectOnPlane(const glm::vec3& _v, const glm::vec3& _normal)
+    {
+        return _v - _normal * glm::dot(_normal, _v);
+    }
+
+    // Summed corner tangents -> unit tangent orthogonal to the normal, bitangent sign from the uv winding
+    glm::vec4 finalTangent(const glm::vec3& _sum, const glm::vec3& _normal, i8 _winding)
+    {
+        glm::vec3 normal = safeNormalize(_normal);
+        glm::vec3 tangent = safeNormalize(projectOnPlane(_sum, normal));
+        if (tangent == glm::vec3(0.0f))
+        {
+            // a zero normal decodes as +z in the packed format
+            glm::vec3 bitangent;
+            VertexPacked::tangentBasis(normal == glm::vec3(0.0f) ? glm::vec3(0.0f, 0.0f, 1.0f) : normal, tangent, bitangent);
+        }
+        return glm::vec4(tangent, _winding < 0 ? -1.0f : 1.0f);
+    }
+}
+
+u32 TangentGenerator::generate(std::vector<Vertex>& _vertices, std::vector<u32>& _indices, JobSystem* _jobSystem)
+{
+    u32 vertexCount = (u32)_vertices.size();
+    u32 cornerCount = (u32)_indices.size() / 3 * 3;
+    u32 triangleCount = cornerCount / 3;
+
+    // Per triangle uv winding (+1, -1, 0 without uv gradient) and per corner contribution
+    std::vector<i8> windings(triangleCount);
+    std::vector<glm::vec3> cornerTangents(cornerCount);
+    u32 triangleChunkCount = (triangleCount + ChunkSize - 1) / ChunkSize;
+    parallelRun(_jobSystem, triangleChunkCount, [&](u32 _chunk) {
+        u32 end = std::min(triangleCount, (_chunk + 1) * ChunkSize);
+        for (u32 t = _chunk * ChunkSize; t < end; ++t)
+        {
+            const Vertex* corners[3] = { &_vertices[_indices[t * 3 + 0]], &_vertices[_indices[t * 3 + 1]], &_vertices[_indices[t * 3 + 2]] };
+            glm::vec3 edge1 = corners[1]->pos - corners[0]->pos;
+            glm::vec3 edge2 = corners[2]->pos - corners[0]->pos;
+            glm::vec2 uvEdge1 = corners[1]->texCoords - corners[0]->texCoords;
+            glm::vec2 uvEdge2 = corners[2]->texCoords - corners[0]->texCoords;
+
+            // direction of increasing u, flipped with the winding so mirrored triangles agree on the tangent
+            float signedUvArea = uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x;
+            glm::vec3 tangent = safeNormalize(uvEdge2.y * edge1 - uvEdge1.y * edge2);
+            i8 winding = 0;
+            if (std::abs(signedUvArea) > DegenerateUvArea && tangent != glm::vec3(0.0f))
+            {
+                winding = signedUvArea > 0.0f ? 1 : -1;
+                tangent *= (float)winding;
+            }
+            windings[t] = winding;
+
+            for (u32 c = 0; c < 3; ++c)
+            {
+                glm::vec3& cornerTangent = cornerTangents[t * 3 + c];
+                if (winding == 0)
+                {
+                    cornerTangent = glm::vec3(0.0f);
+                    continue;
+                }
+                const Vertex& vertex = *corners[c];
+                glm::vec3 normal = safeNormalize(vertex.normal);
+                glm::vec3 next = safeNormalize(projectOnPlane(corners[(c + 1) % 3]->pos - vertex.pos, normal));
+                glm::vec3 previous = safeNormalize(projectOnPlane(corners[(c + 2) % 3]->pos - vertex.pos, normal));
+                float angle = std::acos(glm::clamp(glm::dot(next, previous), -1.0f, 1.0f));
+                cornerTangent = safeNormalize(projectOnPlane(tangent, normal)) * angle;
+            }
+        }
+    });
+
+    // Corners of every vertex, in corner order so the result doesn't depend on the job order
+    std::vector<u32> cornerOffsets(vertexCount + 1, 0);
+    for (u32 c = 0; c < cornerCount; ++c)
+        ++cornerOffsets[_indices[c] + 1];
+    for (u32 v = 0; v < vertexCount; ++v)
+        cornerOffsets[v + 1] += cornerOffsets[v];
+    std::vector<u32> vertexCorners(cornerCount);
+    {
+        std::vector<u32> cursors(cornerOffsets.begin(), cornerOffsets.end() - 1);
+        for (u32 c = 0; c < cornerCount; ++c)
+            vertexCorners[cursors[_indices[c]]++] = c;
+    }
+
+    // The winding of the first corner with a uv gradient keeps the vertex, corners of the other winding go to a split copy
+    std::vector<i8> vertexWindings(vertexCount);
+    std::vector<glm::vec3> splitSums(vertexCount);
+    std::vector<u8> splits(vertexCount);
+    u32 vertexChunkCount = (vertexCount + ChunkSize - 1) / ChunkSize;
+    parallelRun(_jobSystem, vertexChunkCount, [&](u32 _chunk) {
+        u32 end = std::min(vertexCount, (_chunk + 1) * ChunkSize);
+        for (u32 v = _chunk * ChunkSize; v < end; ++v)
+        {
+            i8 winding = 0;
+            glm::vec3 sums[2] = { glm::vec3(0.0f), glm::vec3(0.0f) };
+            bool split = false;
+            for (u32 i = cornerOffsets[v]; i < cornerOffsets[v + 1]; ++i)
+            {
+                u32 corner = vertexCorners[i];
+                i8 cornerWinding = windings[corner / 3];
+                if (cornerWinding == 0)
+                    continue;
+                if (winding == 0)
+                    winding = cornerWinding;
+                bool other = cornerWinding != winding;
+                split |= other;
+                sums[other ? 1 : 0] += cornerTangents[corner];
+            }
+            vertexWindings[v] = winding;
+            splitSums[v] = sums[1];
+            splits[v] = split;
+            _vertices[v].tangent = finalTangent(sums[0], _vertices[v].normal, winding);
+        }
+    });
+
+    u32 splitCount = 0;
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        if (!splits[v])
+            continue;
+
+        Vertex vertex = _vertices[v];
+        vertex.tangent = finalTangent(splitSums[v], vertex.normal, -vertexWindings[v]);
+        u32 splitVertex = (u32)_vertices.size();
+        _vertices.push_back(vertex);
+        for (u32 i = cornerOffsets[v]; i < cornerOffsets[v + 1]; ++i)
+        {
+            u32 corner = vertexCorners[i];
+            if (windings[corner / 3] == -vertexWindings[v])
+                _indices[corner] = splitVertex;
+        }
+        ++splitCount;
+    }
+    return splitCount;
+}
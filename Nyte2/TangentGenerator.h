@@ -0,0 +1,20 @@
+#pragma once
+
+// stl
+#include <vector>
+
+#include "Common.h"
+#include "VertexModel.h"
+
+class JobSystem;
+
+// MikkTSpace style tangent frames of a welded triangle list, generated at import so the G-buffer pass doesn't build them per fragment.
+// Every corner adds the uv tangent of its triangle, projected on the vertex normal plane and weighted by the corner angle.
+// Triangles of opposite uv winding (mirrored uvs) don't share a frame, their vertices are split.
+class TangentGenerator
+{
+public:
+    // Fills Vertex::tangent, w is the bitangent sign. Split vertices are appended and their corners remapped in _indices.
+    // Vertices without a usable uv gradient take tangentBasis of their normal. Returns the split vertex count.
+    static u32 generate(std::vector<Vertex>& _vertices, std::vector<u32>& _indices, JobSystem* _jobSystem = nullptr);
+};
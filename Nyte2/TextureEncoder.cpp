@@ -0,0 +1,633 @@
+#include "TextureEncoder.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define NYTE_TEXTURE_ENCODER_SSE2 1
+#endif
+
+namespace
+{
+    constexpr u32 PowerIterations = 8; // principal axis of the block, converges well before for the usual 2 color blocks
+    constexpr u32 BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 }; // 4 bit indices, out of 64
+    constexpr u32 BC7Weights2[4] = { 0, 21, 43, 64 }; // 2 bit indices
+
+    // Texels of one block by channel, the SIMD loops take 4 texels at a time
+    struct Block
+    {
+        alignas(16) float channels[4][16];
+    };
+
+    // 128 bit block, written from the least significant bit
+    struct BitWriter
+    {
+        u64 bits[2] = {};
+        u32 position = 0;
+
+        void write(u32 _value, u32 _count)
+        {
+            for (u32 b = 0; b < _count; ++b, ++position)
+            {
+                if ((_value >> b) & 1)
+                    bits[position >> 6] |= 1ull << (position & 63);
+            }
+        }
+    };
+
+    // Nearest palette entry of every texel over the first _channelCount channels, returns the summed squared error
+    float selectIndices(const Block& _block, const float (*_palette)[4], u32 _paletteSize, u32 _channelCount, u8* _indices)
+    {
+#if NYTE_TEXTURE_ENCODER_SSE2
+        __m128 total = _mm_setzero_ps();
+        for (u32 t = 0; t < 16; t += 4)
+        {
+            __m128 texels[4];
+            for (u32 c = 0; c < _channelCount; ++c)
+                texels[c] = _mm_load_ps(&_block.channels[c][t]);
+
+            __m128 best = _mm_set1_ps(FLT_MAX);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (u32 p = 0; p < _paletteSize; ++p)
+            {
+                __m128 error = _mm_setzero_ps();
+                for (u32 c = 0; c < _channelCount; ++c)
+                {
+                    __m128 difference = _mm_sub_ps(texels[c], _mm_set1_ps(_palette[p][c]));
+                    error = _mm_add_ps(error, _mm_mul_ps(difference, difference));
+                }
+                // ties keep the lower index, like the scalar loop
+                __m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, best));
+                best = _mm_min_ps(error, best);
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((int)p)), _mm_andnot_si128(closer, bestIndex));
+            }
+
+            alignas(16) u32 indices[4];
+            _mm_store_si128((__m128i*)indices, bestIndex);
+            for (u32 i = 0; i < 4; ++i)
+                _indices[t + i] = (u8)indices[i];
+            total = _mm_add_ps(total, best);
+        }
+        alignas(16) float totals[4];
+        _mm_store_ps(totals, total);
+        return totals[0] + totals[1] + totals[2] + totals[3];
+#else
+        float total = 0.0f;
+        for (u32 t = 0; t < 16; ++t)
+        {
+            float best = FLT_MAX;
+            for (u32 p = 0; p < _paletteSize; ++p)
+            {
+                float error = 0.0f;
+                for (u32 c = 0; c < _channelCount; ++c)
+                {
+                    float difference = _block.channels[c][t] - _palette[p][c];
+                    error += difference * difference;
+                }
+                if (error < best)
+                {
+                    best = error;
+                    _indices[t] = (u8)p;
+                }
+            }
+            total += best;
+        }
+        return total;
+#endif
+    }
+
+    // Ends of the principal axis of the first _channelCount channels, at the extreme projections of the texels
+    void principalEndpoints(const Block& _block, u32 _channelCount, float* _low, float* _high)
+    {
+        float mean[4] = {};
+        for (u32 c = 0; c < _channelCount; ++c)
+        {
+            for (u32 t = 0; t < 16; ++t)
+                mean[c] += _block.channels[c][t];
+            mean[c] /= 16.0f;
+        }
+
+        float covariance[4][4] = {};
+        for (u32 t = 0; t < 16; ++t)
+        {
+            float d[4];
+            for (u32 c = 0; c < _channelCount; ++c)
+                d[c] = _block.channels[c][t] - mean[c];
+            for (u32 i = 0; i < _channelCount; ++i)
+            {
+                for (u32 j = 0; j < _channelCount; ++j)
+                    covariance[i][j] += d[i] * d[j];
+            }
+        }
+
+        // power iteration from the row of the channel that varies the most
+        u32 widest = 0;
+        for (u32 c = 1; c < _channelCount; ++c)
+        {
+            if (covariance[c][c] > covariance[widest][widest])
+                widest = c;
+        }
+        float axis[4] = {};
+        for (u32 c = 0; c < _channelCount; ++c)
+            axis[c] = covariance[widest][c];
+        for (u32 i = 0; i < PowerIterations; ++i)
+        {
+            float next[4] = {};
+            float largest = 0.0f;
+            for (u32 r = 0; r < _channelCount; ++r)
+            {
+                for (u32 c = 0; c < _channelCount; ++c)
+                    next[r] += covariance[r][c] * axis[c];
+                largest = std::max(largest, std::abs(next[r]));
+            }
+            if (largest < 1e-12f)
+                break;
+            for (u32 c = 0; c < _channelCount; ++c)
+                axis[c] = next[c] / largest;
+        }
+
+        float length = 0.0f;
+        for (u32 c = 0; c < _channelCount; ++c)
+            length += axis[c] * axis[c];
+        length = std::sqrt(length);
+
+        // flat block, both ends on the mean
+        float lowest = 0.0f, highest = 0.0f;
+        if (length > 1e-6f)
+        {
+            for (u32 c = 0; c < _channelCount; ++c)
+                axis[c] /= length;
+            lowest = FLT_MAX;
+            highest = -FLT_MAX;
+            for (u32 t = 0; t < 16; ++t)
+            {
+                float projection = 0.0f;
+                for (u32 c = 0; c < _channelCount; ++c)
+                    projection += (_block.channels[c][t] - mean[c]) * axis[c];
+                lowest = std::min(lowest, projection);
+                highest = std::max(highest, projection);
+            }
+        }
+        for (u32 c = 0; c < _channelCount; ++c)
+        {
+            _low[c] = std::clamp(mean[c] + axis[c] * lowest, 0.0f, 255.0f);
+            _high[c] = std::clamp(mean[c] + axis[c] * highest, 0.0f, 255.0f);
+        }
+    }
+
+    // Least squares endpoints of texels decoded as _low + _weights[t] * (_high - _low), false when the weights can't tell the ends apart
+    bool fitEndpoints(const Block& _block, u32 _channelCount, const float* _weights, float* _low, float* _high)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (u32 t = 0; t < 16; ++t)
+        {
+            float b = _weights[t];
+            float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (u32 c = 0; c < _channelCount; ++c)
+            {
+                ax[c] += a * _block.channels[c][t];
+                bx[c] += b * _block.channels[c][t];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            return false;
+        for (u32 c = 0; c < _channelCount; ++c)
+        {
+            _low[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+            _high[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+#pragma region BC1
+    u16 packRgb565(const float* _color)
+    {
+        u32 r = (u32)(_color[0] * (31.0f / 255.0f) + 0.5f);
+        u32 g = (u32)(_color[1] * (63.0f / 255.0f) + 0.5f);
+        u32 b = (u32)(_color[2] * (31.0f / 255.0f) + 0.5f);
+        return (u16)((r << 11) | (g << 5) | b);
+    }
+
+    // Expanded like the hardware does, high bits replicated
+    void unpackRgb565(u16 _color, float* _rgb)
+    {
+        u32 r = (_color >> 11) & 31, g = (_color >> 5) & 63, b = _color & 31;
+        _rgb[0] = (float)((r << 3) | (r >> 2));
+        _rgb[1] = (float)((g << 2) | (g >> 4));
+        _rgb[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    // Four color mode: the ends, then 1/3 and 2/3 of the way
+    void paletteBC1(u16 _color0, u16 _color1, float (*_palette)[4])
+    {
+        unpackRgb565(_color0, _palette[0]);
+        unpackRgb565(_color1, _palette[1]);
+        for (u32 c = 0; c < 3; ++c)
+        {
+            _palette[2][c] = (2.0f * _palette[0][c] + _palette[1][c]) / 3.0f;
+            _palette[3][c] = (_palette[0][c] + 2.0f * _palette[1][c]) / 3.0f;
+        }
+    }
+
+    void encodeBC1(const Block& _block, u8* _destination)
+    {
+        static constexpr float Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f }; // toward color1, by index
+
+        float low[4], high[4];
+        principalEndpoints(_block, 3, low, high);
+        u16 color0 = packRgb565(high);
+        u16 color1 = packRgb565(low);
+        float palette[4][4];
+        u8 indices[16];
+        paletteBC1(color0, color1, palette);
+        float error = selectIndices(_block, palette, 4, 3, indices);
+
+        float weights[16];
+        for (u32 t = 0; t < 16; ++t)
+            weights[t] = Weights[indices[t]];
+        float fit0[4], fit1[4];
+        if (fitEndpoints(_block, 3, weights, fit0, fit1))
+        {
+            u16 fitColor0 = packRgb565(fit0);
+            u16 fitColor1 = packRgb565(fit1);
+            u8 fitIndices[16];
+            paletteBC1(fitColor0, fitColor1, palette);
+            float fitError = selectIndices(_block, palette, 4, 3, fitIndices);
+            if (fitError < error)
+            {
+                color0 = fitColor0;
+                color1 = fitColor1;
+                memcpy(indices, fitIndices, sizeof(indices));
+            }
+        }
+
+        // color0 > color1 selects the four color mode, equal ends decode every index 0 to color0
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+            for (u8& index : indices)
+                index ^= 1;
+        }
+        else if (color0 == color1)
+            memset(indices, 0, sizeof(indices));
+
+        u32 bits = 0;
+        for (u32 t = 0; t < 16; ++t)
+            bits |= (u32)indices[t] << (t * 2);
+        memcpy(_destination, &color0, 2);
+        memcpy(_destination + 2, &color1, 2);
+        memcpy(_destination + 4, &bits, 4);
+    }
+#pragma endregion BC1
+
+#pragma region BC4
+    // red0 > red1: 6 steps between the ends. Otherwise 4 steps, then 0 and 255.
+    void paletteBC4(u8 _red0, u8 _red1, float (*_palette)[4])
+    {
+        _palette[0][0] = _red0;
+        _palette[1][0] = _red1;
+        if (_red0 > _red1)
+        {
+            for (u32 i = 2; i < 8; ++i)
+                _palette[i][0] = ((8 - i) * _red0 + (i - 1) * _red1) / 7.0f;
+            return;
+        }
+        for (u32 i = 2; i < 6; ++i)
+            _palette[i][0] = ((6 - i) * _red0 + (i - 1) * _red1) / 5.0f;
+        _palette[6][0] = 0.0f;
+        _palette[7][0] = 255.0f;
+    }
+
+    float tryBC4(const Block& _single, u8 _red0, u8 _red1, u8* _indices)
+    {
+        float palette[8][4];
+        paletteBC4(_red0, _red1, palette);
+        return selectIndices(_single, palette, 8, 1, _indices);
+    }
+
+    void encodeBC4(const Block& _block, u32 _channel, u8* _destination)
+    {
+        Block single;
+        memcpy(single.channels[0], _block.channels[_channel], sizeof(single.channels[0]));
+        const float* values = single.channels[0];
+
+        float lowest = *std::min_element(values, values + 16);
+        float highest = *std::max_element(values, values + 16);
+        u8 red0 = (u8)(highest + 0.5f);
+        u8 red1 = (u8)(lowest + 0.5f);
+        u8 indices[16] = {};
+        float error = 0.0f;
+        if (red0 != red1)
+        {
+            error = tryBC4(single, red0, red1, indices);
+
+            // refit the ends on the indices, kept in the 8 level mode
+            float weights[16];
+            for (u32 t = 0; t < 16; ++t)
+                weights[t] = indices[t] == 0 ? 0.0f : indices[t] == 1 ? 1.0f : (indices[t] - 1) / 7.0f;
+            float fit0, fit1;
+            if (fitEndpoints(single, 1, weights, &fit0, &fit1))
+            {
+                u8 fitRed0 = (u8)(std::max(fit0, fit1) + 0.5f);
+                u8 fitRed1 = (u8)(std::min(fit0, fit1) + 0.5f);
+                u8 fitIndices[16];
+                float fitError = fitRed0 != fitRed1 ? tryBC4(single, fitRed0, fitRed1, fitIndices) : FLT_MAX;
+                if (fitError < error)
+                {
+                    error = fitError;
+                    red0 = fitRed0;
+                    red1 = fitRed1;
+                    memcpy(indices, fitIndices, sizeof(indices));
+                }
+            }
+
+            // blocks reaching 0 or 255 may do better with the explicit extremes of the 6 level mode
+            float innerLowest = 255.0f, innerHighest = 0.0f;
+            for (u32 t = 0; t < 16; ++t)
+            {
+                if (values[t] == 0.0f || values[t] == 255.0f)
+                    continue;
+                innerLowest = std::min(innerLowest, values[t]);
+                innerHighest = std::max(innerHighest, values[t]);
+            }
+            if ((lowest == 0.0f || highest == 255.0f) && innerLowest <= innerHighest)
+            {
+                u8 extremeRed0 = (u8)(innerLowest + 0.5f);
+                u8 extremeRed1 = (u8)(innerHighest + 0.5f);
+                u8 extremeIndices[16];
+                float extremeError = tryBC4(single, extremeRed0, extremeRed1, extremeIndices);
+                if (extremeError < error)
+                {
+                    red0 = extremeRed0;
+                    red1 = extremeRed1;
+                    memcpy(indices, extremeIndices, sizeof(indices));
+                }
+            }
+        }
+
+        u64 bits = 0;
+        for (u32 t = 0; t < 16; ++t)
+            bits |= (u64)indices[t] << (t * 3);
+        _destination[0] = red0;
+        _destination[1] = red1;
+        for (u32 i = 0; i < 6; ++i)
+            _destination[2 + i] = (u8)(bits >> (i * 8));
+    }
+#pragma endregion BC4
+
+#pragma region BC7
+    // 8 bit endpoint -> 7 bit channels and the p-bit they share, the closest pair
+    void quantizeBC7Endpoint(const float* _endpoint, u8* _values, u8& _pBit)
+    {
+        float bestError = FLT_MAX;
+        for (u8 pBit = 0; pBit < 2; ++pBit)
+        {
+            u8 values[4];
+            float error = 0.0f;
+            for (u32 c = 0; c < 4; ++c)
+            {
+                values[c] = (u8)std::clamp((int)std::lround((_endpoint[c] - pBit) * 0.5f), 0, 127);
+                float difference = (float)((values[c] << 1) | pBit) - _endpoint[c];
+                error += difference * difference;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                memcpy(_values, values, 4);
+                _pBit = pBit;
+            }
+        }
+    }
+
+    struct EndpointsBC7
+    {
+        u8 values[2][4]; // 7 bit RGBA
+        u8 pBits[2];
+    };
+
+    float tryBC7(const Block& _block, const float* _endpoint0, const float* _endpoint1, EndpointsBC7& _endpoints, u8* _indices)
+    {
+        quantizeBC7Endpoint(_endpoint0, _endpoints.values[0], _endpoints.pBits[0]);
+        quantizeBC7Endpoint(_endpoint1, _endpoints.values[1], _endpoints.pBits[1]);
+
+        float palette[16][4];
+        for (u32 c = 0; c < 4; ++c)
+        {
+            u32 end0 = (_endpoints.values[0][c] << 1) | _endpoints.pBits[0];
+            u32 end1 = (_endpoints.values[1][c] << 1) | _endpoints.pBits[1];
+            for (u32 i = 0; i < 16; ++i)
+                palette[i][c] = (float)(((64 - BC7Weights[i]) * end0 + BC7Weights[i] * end1 + 32) >> 6);
+        }
+        return selectIndices(_block, palette, 16, 4, _indices);
+    }
+
+    // Mode 6: one RGBA line, 7 bit endpoints with a p-bit, 4 bit indices
+    float encodeBC7Mode6(const Block& _block, BitWriter& _writer)
+    {
+        float low[4], high[4];
+        principalEndpoints(_block, 4, low, high);
+        EndpointsBC7 endpoints;
+        u8 indices[16];
+        float error = tryBC7(_block, low, high, endpoints, indices);
+
+        float weights[16];
+        for (u32 t = 0; t < 16; ++t)
+            weights[t] = BC7Weights[indices[t]] / 64.0f;
+        if (fitEndpoints(_block, 4, weights, low, high))
+        {
+            EndpointsBC7 fitted;
+            u8 fitIndices[16];
+            float fitError = tryBC7(_block, low, high, fitted, fitIndices);
+            if (fitError < error)
+            {
+                error = fitError;
+                endpoints = fitted;
+                memcpy(indices, fitIndices, sizeof(indices));
+            }
+        }
+
+        // the first index is stored without its high bit
+        if (indices[0] & 8)
+        {
+            std::swap(endpoints.values[0], endpoints.values[1]);
+            std::swap(endpoints.pBits[0], endpoints.pBits[1]);
+            for (u8& index : indices)
+                index = 15 - index;
+        }
+
+        // 7 mode bits, R0 R1 G0 G1 B0 B1 A0 A1 on 7 bits, 2 p-bits, 63 index bits
+        _writer.write(1 << 6, 7);
+        for (u32 c = 0; c < 4; ++c)
+        {
+            _writer.write(endpoints.values[0][c], 7);
+            _writer.write(endpoints.values[1][c], 7);
+        }
+        _writer.write(endpoints.pBits[0], 1);
+        _writer.write(endpoints.pBits[1], 1);
+        _writer.write(indices[0], 3);
+        for (u32 t = 1; t < 16; ++t)
+            _writer.write(indices[t], 4);
+        return error;
+    }
+
+    float tryBC7Mode5Color(const Block& _block, const float* _endpoint0, const float* _endpoint1, u8 (*_values)[3], u8* _indices)
+    {
+        float palette[4][4];
+        u32 ends[2][3];
+        for (u32 c = 0; c < 3; ++c)
+        {
+            _values[0][c] = (u8)(_endpoint0[c] * (127.0f / 255.0f) + 0.5f);
+            _values[1][c] = (u8)(_endpoint1[c] * (127.0f / 255.0f) + 0.5f);
+            ends[0][c] = (_values[0][c] << 1) | (_values[0][c] >> 6);
+            ends[1][c] = (_values[1][c] << 1) | (_values[1][c] >> 6);
+            for (u32 i = 0; i < 4; ++i)
+                palette[i][c] = (float)(((64 - BC7Weights2[i]) * ends[0][c] + BC7Weights2[i] * ends[1][c] + 32) >> 6);
+        }
+        return selectIndices(_block, palette, 4, 3, _indices);
+    }
+
+    // Mode 5: RGB on 7 bit endpoints and alpha on 8 bit endpoints, 2 bit indices each. Blocks whose alpha doesn't follow the color.
+    float encodeBC7Mode5(const Block& _block, BitWriter& _writer)
+    {
+        float low[4], high[4];
+        principalEndpoints(_block, 3, low, high);
+        u8 colors[2][3];
+        u8 colorIndices[16];
+        float colorError = tryBC7Mode5Color(_block, low, high, colors, colorIndices);
+
+        float weights[16];
+        for (u32 t = 0; t < 16; ++t)
+            weights[t] = BC7Weights2[colorIndices[t]] / 64.0f;
+        if (fitEndpoints(_block, 3, weights, low, high))
+        {
+            u8 fitColors[2][3];
+            u8 fitIndices[16];
+            float fitError = tryBC7Mode5Color(_block, low, high, fitColors, fitIndices);
+            if (fitError < colorError)
+            {
+                colorError = fitError;
+                memcpy(colors, fitColors, sizeof(colors));
+                memcpy(colorIndices, fitIndices, sizeof(colorIndices));
+            }
+        }
+
+        Block alpha;
+        memcpy(alpha.channels[0], _block.channels[3], sizeof(alpha.channels[0]));
+        u8 alphas[2] = { (u8)*std::min_element(alpha.channels[0], alpha.channels[0] + 16), (u8)*std::max_element(alpha.channels[0], alpha.channels[0] + 16) };
+        float alphaPalette[4][4];
+        for (u32 i = 0; i < 4; ++i)
+            alphaPalette[i][0] = (float)(((64 - BC7Weights2[i]) * alphas[0] + BC7Weights2[i] * alphas[1] + 32) >> 6);
+        u8 alphaIndices[16];
+        float alphaError = selectIndices(alpha, alphaPalette, 4, 1, alphaIndices);
+
+        // both first indices are stored without their high bit
+        if (colorIndices[0] & 2)
+        {
+            std::swap(colors[0], colors[1]);
+            for (u8& index : colorIndices)
+                index = 3 - index;
+        }
+        if (alphaIndices[0] & 2)
+        {
+            std::swap(alphas[0], alphas[1]);
+            for (u8& index : alphaIndices)
+                index = 3 - index;
+        }
+
+        // 6 mode bits, no rotation, R0 R1 G0 G1 B0 B1 on 7 bits, A0 A1 on 8 bits, 31 color and 31 alpha index bits
+        _writer.write(1 << 5, 6);
+        _writer.write(0, 2);
+        for (u32 c = 0; c < 3; ++c)
+        {
+            _writer.write(colors[0][c], 7);
+            _writer.write(colors[1][c], 7);
+        }
+        _writer.write(alphas[0], 8);
+        _writer.write(alphas[1], 8);
+        _writer.write(colorIndices[0], 1);
+        for (u32 t = 1; t < 16; ++t)
+            _writer.write(colorIndices[t], 2);
+        _writer.write(alphaIndices[0], 1);
+        for (u32 t = 1; t < 16; ++t)
+            _writer.write(alphaIndices[t], 2);
+        return colorError + alphaError;
+    }
+
+    void encodeBC7(const Block& _block, u8* _destination)
+    {
+        BitWriter writer;
+        float error = encodeBC7Mode6(_block, writer);
+
+        const float* alpha = _block.channels[3];
+        if (*std::min_element(alpha, alpha + 16) != *std::max_element(alpha, alpha + 16))
+        {
+            BitWriter separateAlpha;
+            if (encodeBC7Mode5(_block, separateAlpha) < error)
+                writer = separateAlpha;
+        }
+        memcpy(_destination, writer.bits, 16);
+    }
+#pragma endregion BC7
+
+    void encodeBlock(TextureEncoder::Format _format, const Block& _block, u8* _destination)
+    {
+        switch (_format)
+        {
+        case TextureEncoder::BC1: encodeBC1(_block, _destination); break;
+        case TextureEncoder::BC4: encodeBC4(_block, 0, _destination); break;
+        case TextureEncoder::BC5: encodeBC4(_block, 0, _destination); encodeBC4(_block, 1, _destination + 8); break;
+        case TextureEncoder::BC7: encodeBC7(_block, _destination); break;
+        }
+    }
+}
+
+void TextureEncoder::encode(Format _format, const u8* _rgba, u32 _width, u32 _height, u8* _destination, JobSystem* _jobSystem)
+{
+    u32 blocksX = (_width + 3) / 4;
+    u32 blocksY = (_height + 3) / 4;
+    auto encodeRow = [&](u32 _row) {
+        u8* destination = _destination + (size_t)_row * blocksX * blockBytes(_format);
+        for (u32 blockX = 0; blockX < blocksX; ++blockX, destination += blockBytes(_format))
+        {
+            Block block;
+            for (u32 t = 0; t < 16; ++t)
+            {
+                u32 x = std::min(blockX * 4 + (t & 3), _width - 1);
+                u32 y = std::min(_row * 4 + (t >> 2), _height - 1);
+                const u8* texel = _rgba + ((size_t)y * _width + x) * 4;
+                for (u32 c = 0; c < 4; ++c)
+                    block.channels[c][t] = texel[c];
+            }
+            ::encodeBlock(_format, block, destination);
+        }
+    };
+
+    if (!_jobSystem)
+    {
+        for (u32 row = 0; row < blocksY; ++row)
+            encodeRow(row);
+        return;
+    }
+    _jobSystem->parallelFor(blocksY, encodeRow);
+}
+
+void TextureEncoder::encodeBlock(Format _format, const u8* _texels, u8* _destination)
+{
+    Block block;
+    for (u32 t = 0; t < 16; ++t)
+    {
+        for (u32 c = 0; c < 4; ++c)
+            block.channels[c][t] = _texels[t * 4 + c];
+    }
+    ::encodeBlock(_format, block, _destination);
+}
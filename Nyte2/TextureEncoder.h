@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Common.h"
+
+class JobSystem;
+
+// CPU block compression of RGBA8 levels into the BC formats the engine samples, 4x4 texel blocks:
+//  BC1: opaque RGB, 8 bytes a block
+//  BC4: red only, 8 bytes
+//  BC5: red and green, two BC4 blocks
+//  BC7: RGBA, 16 bytes. Mode 6 (one RGBA line, 16 levels), or mode 5 (RGB and alpha apart) when it fits the block better.
+// Endpoints come from the principal axis of the block, refined once by least squares against the chosen indices.
+class TextureEncoder
+{
+public:
+    enum Format : u32
+    {
+        BC1 = 0,
+        BC4,
+        BC5,
+        BC7,
+    };
+
+    static u32 blockBytes(Format _format) { return _format == BC1 || _format == BC4 ? 8 : 16; }
+    static u64 encodedSize(Format _format, u32 _width, u32 _height) { return (u64)((_width + 3) / 4) * ((_height + 3) / 4) * blockBytes(_format); }
+
+    // Rows of blocks are encoded in parallel when a job system is given.
+    // Blocks crossing the right or bottom edge repeat the last column/row.
+    static void encode(Format _format, const u8* _rgba, u32 _width, u32 _height, u8* _destination, JobSystem* _jobSystem = nullptr);
+    // _texels: 16 RGBA8 texels in row order
+    static void encodeBlock(Format _format, const u8* _texels, u8* _destination);
+};
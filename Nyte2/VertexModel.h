@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <vector>
 #include <array>
+#include <cstring>
+#include <cmath>
 
 // vulkan
 #include "vulkan/vulkan_core.h"
@@ -15,6 +17,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include "Common.h"
 #include "Math.h"
@@ -23,6 +27,7 @@ struct Vertex {
     glm::vec3 pos;
     glm::vec3 normal;
     glm::vec2 texCoords;
+    glm::vec4 tangent; // xyz unit tangent, w bitangent sign: bitangent = w * cross(normal, tangent)
 
     static VkVertexInputBindingDescription getBindingDescription()
     {
@@ -33,7 +38,7 @@ struct Vertex {
         return bindingDescription;
     }
 
-    using VertexInputAttributDescriptions = std::array<VkVertexInputAttributeDescription, 3>;
+    using VertexInputAttributDescriptions = std::array<VkVertexInputAttributeDescription, 4>;
     static VertexInputAttributDescriptions getAttributeDescriptions()
     {
         VertexInputAttributDescriptions attributeDescriptions{};
@@ -56,14 +61,139 @@ struct Vertex {
         attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT; // = vec2
         attributeDescriptions[2].offset = offsetof(Vertex, texCoords);
 
+        // inTangent
+        attributeDescriptions[3].binding = 0;
+        attributeDescriptions[3].location = 3;
+        attributeDescriptions[3].format = VK_FORMAT_R32G32B32A32_SFLOAT; // = vec4
+        attributeDescriptions[3].offset = offsetof(Vertex, tangent);
+
         return attributeDescriptions;
     }
 
     bool operator==(const Vertex& _other) const 
     {
-        return pos == _other.pos && normal == _other.normal && texCoords == _other.texCoords;
+        return pos == _other.pos && normal == _other.normal && texCoords == _other.texCoords && tangent == _other.tangent;
+    }
+};
+
+enum class VertexFormat : u32
+{
+    Float32 = 0,    // Vertex, 48 bytes
+    Packed16,       // VertexPacked, 16 bytes
+};
+
+// 16 bytes vertex: unorm16 position dequantized with a per mesh scale/offset, octahedral snorm16 normal, half float uv.
+// The tangent lives in the position w: its angle in the tangentBasis of the normal, and the bitangent sign.
+struct VertexPacked {
+    u16 pos[4]; // xyz + encodeTangent
+    i16 normal[2];
+    u16 texCoords[2];
+
+    static VkVertexInputBindingDescription getBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0; // binding index 
+        bindingDescription.stride = sizeof(VertexPacked);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    using VertexInputAttributDescriptions = std::array<VkVertexInputAttributeDescription, 3>;
+    static VertexInputAttributDescriptions getAttributeDescriptions()
+    {
+        VertexInputAttributDescriptions attributeDescriptions{};
+
+        // inPosition
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM; // = vec4 in [0, 1], w is the tangent
+        attributeDescriptions[0].offset = offsetof(VertexPacked, pos);
+
+        // inNormal
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM; // = vec2 in [-1, 1]
+        attributeDescriptions[1].offset = offsetof(VertexPacked, normal);
+
+        // inTexCoords
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT; // = vec2
+        attributeDescriptions[2].offset = offsetof(VertexPacked, texCoords);
+
+        return attributeDescriptions;
+    }
+
+    // Octahedron projection folded on the z < 0 half, a zero normal maps to (0, 0, 1)
+    static glm::vec2 encodeOctahedral(const glm::vec3& _normal)
+    {
+        float length = glm::abs(_normal.x) + glm::abs(_normal.y) + glm::abs(_normal.z);
+        if (length == 0.0f)
+            return glm::vec2(0.0f);
+
+        glm::vec3 n = _normal / length;
+        glm::vec2 encoded(n.x, n.y);
+        if (n.z < 0.0f)
+        {
+            glm::vec2 signs(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+            encoded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * signs;
+        }
+        return encoded;
+    }
+
+    // Same as decodeOctahedral in offscreen_gbuffer.glsl
+    static glm::vec3 decodeOctahedral(const glm::vec2& _encoded)
+    {
+        glm::vec3 n(_encoded, 1.0f - glm::abs(_encoded.x) - glm::abs(_encoded.y));
+        float t = glm::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
+    // Orthonormal basis around a unit normal, continuous but for z = -1 (Duff et al. 2017)
+    static void tangentBasis(const glm::vec3& _normal, glm::vec3& _b1, glm::vec3& _b2)
+    {
+        float sign = _normal.z >= 0.0f ? 1.0f : -1.0f;
+        float a = -1.0f / (sign + _normal.z);
+        float b = _normal.x * _normal.y * a;
+        _b1 = glm::vec3(1.0f + sign * _normal.x * _normal.x * a, sign * b, -sign * _normal.x);
+        _b2 = glm::vec3(b, sign + _normal.y * _normal.y * a, -_normal.y);
+    }
+
+    // Tangent angle in the basis of _normal over the low 15 bits, bitangent sign in the top bit.
+    // _normal is the decoded one, the shader rebuilds the same basis.
+    static u16 encodeTangent(const glm::vec3& _normal, const glm::vec4& _tangent)
+    {
+        glm::vec3 b1, b2;
+        tangentBasis(_normal, b1, b2);
+        glm::vec3 tangent(_tangent);
+        float angle = std::atan2(glm::dot(tangent, b2), glm::dot(tangent, b1)); // [-pi, pi]
+        u16 bits = (u16)((angle + glm::pi<float>()) / glm::two_pi<float>() * 32767.0f + 0.5f);
+        return (u16)(bits | (_tangent.w < 0.0f ? 0x8000 : 0));
+    }
+
+    // _positionScale/_positionOffset map [0, 1] back to the mesh bounds: pos = packed * scale + offset
+    static VertexPacked pack(const Vertex& _vertex, const glm::vec3& _positionScale, const glm::vec3& _positionOffset)
+    {
+        VertexPacked packed{};
+
+        glm::vec3 position = glm::clamp((_vertex.pos - _positionOffset) / _positionScale, 0.0f, 1.0f);
+        glm::u64 position16 = glm::packUnorm4x16(glm::vec4(position, 0.0f));
+        memcpy(packed.pos, &position16, sizeof(packed.pos));
+
+        glm::uint normal16 = glm::packSnorm2x16(encodeOctahedral(_vertex.normal));
+        memcpy(packed.normal, &normal16, sizeof(packed.normal));
+        packed.pos[3] = encodeTangent(decodeOctahedral(glm::unpackSnorm2x16(normal16)), _vertex.tangent);
+
+        glm::uint texCoords16 = glm::packHalf2x16(_vertex.texCoords);
+        memcpy(packed.texCoords, &texCoords16, sizeof(packed.texCoords));
+
+        return packed;
     }
 };
+static_assert(sizeof(Vertex) == 48, "Vertex is uploaded as is");
+static_assert(sizeof(VertexPacked) == 16, "VertexPacked must stay 16 bytes");
 
 namespace std {
     template<> struct hash<Vertex> {
@@ -0,0 +1,173 @@
+#include "VertexWelder.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr u32 EmptySlot = ~0u;
+    constexpr u32 HashChunkSize = 64 * 1024;
+
+    inline u32 mix32(u64 _x)
+    {
+        _x ^= _x >> 33;
+        _x *= 0xFF51AFD7ED558CCDull;
+        _x ^= _x >> 33;
+        _x *= 0xC4CEB9FE1A85EC53ull;
+        _x ^= _x >> 33;
+        return (u32)_x;
+    }
+
+    inline u32 nextPowerOfTwo(u32 _x)
+    {
+        u32 result = 1;
+        while (result < _x)
+            result <<= 1;
+        return result;
+    }
+
+    void parallelRun(JobSystem* _jobSystem, u32 _count, const std::function<void(u32)>& _job)
+    {
+        if (_jobSystem)
+        {
+            _jobSystem->parallelFor(_count, _job);
+            return;
+        }
+        for (u32 i = 0; i < _count; ++i)
+            _job(i);
+    }
+
+    // _first[i] = smallest j such that element j equals element i
+    template<typename HashFn, typename EqualFn>
+    void findFirstOccurrences(u32 _count, HashFn _hash, EqualFn _equal, std::vector<u32>& _first, JobSystem* _jobSystem)
+    {
+        _first.resize(_count);
+        if (_count == 0)
+            return;
+
+        std::vector<u32> hashes(_count);
+        u32 chunkCount = (_count + HashChunkSize - 1) / HashChunkSize;
+        parallelRun(_jobSystem, chunkCount, [&](u32 _chunk) {
+            u32 end = std::min(_count, (_chunk + 1) * HashChunkSize);
+            for (u32 i = _chunk * HashChunkSize; i < end; ++i)
+                hashes[i] = _hash(i);
+        });
+
+        // a few shards per thread to balance uneven hash distributions, the top hash bits pick the shard
+        u32 threadCount = _jobSystem ? _jobSystem->getThreadCount() : 1;
+        u32 shardCount = threadCount > 1 ? std::min(nextPowerOfTwo(threadCount * 4), nextPowerOfTwo(chunkCount)) : 1;
+        u32 shardBits = 0;
+        while ((1u << shardBits) < shardCount)
+            ++shardBits;
+        auto shardOf = [&](u32 _hash) { return shardBits ? _hash >> (32 - shardBits) : 0u; };
+
+        // counting sort by shard, keeps increasing element order inside every shard
+        std::vector<u32> shardOffsets(shardCount + 1, 0);
+        for (u32 i = 0; i < _count; ++i)
+            ++shardOffsets[shardOf(hashes[i]) + 1];
+        for (u32 s = 0; s < shardCount; ++s)
+            shardOffsets[s + 1] += shardOffsets[s];
+
+        std::vector<u32> shardElements(_count);
+        std::vector<u32> cursors(shardOffsets.begin(), shardOffsets.end() - 1);
+        for (u32 i = 0; i < _count; ++i)
+            shardElements[cursors[shardOf(hashes[i])]++] = i;
+
+        parallelRun(_jobSystem, shardCount, [&](u32 _shard) {
+            u32 begin = shardOffsets[_shard];
+            u32 end = shardOffsets[_shard + 1];
+            if (begin == end)
+                return;
+
+            u32 capacity = nextPowerOfTwo(std::max(16u, (end - begin) * 2));
+            u32 mask = capacity - 1;
+            std::vector<u32> table(capacity, EmptySlot);
+
+            for (u32 e = begin; e < end; ++e)
+            {
+                u32 element = shardElements[e];
+                u32 hash = hashes[element];
+                u32 slot = hash & mask;
+                for (;;)
+                {
+                    u32 other = table[slot];
+                    if (other == EmptySlot)
+                    {
+                        table[slot] = element;
+                        _first[element] = element;
+                        break;
+                    }
+                    if (hashes[other] == hash && _equal(other, element))
+                    {
+                        _first[element] = other;
+                        break;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+            }
+        });
+    }
+}
+
+u32 VertexWelder::weld(const Key* _keys, u32 _count, std::vector<u32>& _remap, std::vector<u32>& _firstCorners, JobSystem* _jobSystem)
+{
+    std::vector<u32> first;
+    findFirstOccurrences(
+        _count,
+        [&](u32 _i) {
+            const Key& key = _keys[_i];
+            u64 h = (u64)(u32)key.position * 0x9E3779B185EBCA87ull;
+            h ^= (u64)(u32)key.normal * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+            h ^= (u64)(u32)key.uv * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+            return mix32(h);
+        },
+        [&](u32 _a, u32 _b) {
+            return _keys[_a].position == _keys[_b].position && _keys[_a].normal == _keys[_b].normal && _keys[_a].uv == _keys[_b].uv;
+        },
+        first,
+        _jobSystem);
+
+    // compact in first occurrence order, a corner always comes after the corner it is welded to
+    _remap.resize(_count);
+    _firstCorners.clear();
+    for (u32 i = 0; i < _count; ++i)
+    {
+        if (first[i] == i)
+        {
+            _remap[i] = (u32)_firstCorners.size();
+            _firstCorners.push_back(i);
+        }
+        else
+        {
+            _remap[i] = _remap[first[i]];
+        }
+    }
+    return (u32)_firstCorners.size();
+}
+
+void VertexWelder::indexValues(const float* _values, u32 _components, u32 _count, std::vector<i32>& _ids, JobSystem* _jobSystem)
+{
+    const size_t valueSize = sizeof(float) * _components;
+
+    std::vector<u32> first;
+    findFirstOccurrences(
+        _count,
+        [&](u32 _i) {
+            // bit patterns, -0.0f and 0.0f are kept apart which is harmless
+            const u32* bits = (const u32*)(_values + (size_t)_i * _components);
+            u64 h = 0;
+            for (u32 c = 0; c < _components; ++c)
+                h = (h ^ bits[c]) * 0x9E3779B185EBCA87ull;
+            return mix32(h);
+        },
+        [&](u32 _a, u32 _b) {
+            return memcmp(_values + (size_t)_a * _components, _values + (size_t)_b * _components, valueSize) == 0;
+        },
+        first,
+        _jobSystem);
+
+    _ids.resize(_count);
+    for (u32 i = 0; i < _count; ++i)
+        _ids[i] = (i32)first[i];
+}
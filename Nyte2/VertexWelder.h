@@ -0,0 +1,31 @@
+#pragma once
+
+// stl
+#include <vector>
+
+#include "Common.h"
+
+class JobSystem;
+
+// Merges identical polygon corners into shared vertices.
+// Corners are hashed into shards, every shard is welded on its own thread with an open addressing table.
+// Vertex order follows the first occurrence of each corner so the result is deterministic.
+class VertexWelder
+{
+public:
+    // Attribute indices of a corner, -1 when the attribute is missing
+    struct Key
+    {
+        i32 position;
+        i32 normal;
+        i32 uv;
+    };
+
+    // _remap[corner] = welded vertex index, _firstCorners[vertex] = corner the vertex is built from.
+    // Returns the welded vertex count.
+    static u32 weld(const Key* _keys, u32 _count, std::vector<u32>& _remap, std::vector<u32>& _firstCorners, JobSystem* _jobSystem = nullptr);
+
+    // Value hash fallback for attributes without an index array:
+    // _ids[i] = index of the first element holding the same _components floats as element i.
+    static void indexValues(const float* _values, u32 _components, u32 _count, std::vector<i32>& _ids, JobSystem* _jobSystem = nullptr);
+};
@@ -0,0 +1,181 @@
+// NyteCook: offline asset cooker.
+// Run from the engine working directory so asset names match the paths the engine loads:
+//
+//  NyteCook <source directory> [archive] [thread count] [--force] [--watch]
+//
+// Every FBX, OBJ and texture under the source directory is imported, converted and packed into one asset archive
+// (Resources/Assets.nytepak by default). The engine maps it at startup and only uploads.
+// Textures are block compressed (BC1/BC4/BC5/BC7 picked from the file name) and stored as KTX2.
+//
+// Cooking is incremental: assets of the previous archive are copied over as long as their source content hash
+// and processor version still match (see AssetDependencyGraph), --force cooks everything again.
+// --watch keeps running and cooks again whenever a source changes.
+
+// stl
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+
+#include "Common.h"
+#include "FileHelper.h"
+#include "AssetArchive.h"
+#include "AssetCooker.h"
+#include "FileWatcher.h"
+#include "JobSystem.h"
+
+namespace
+{
+    const std::string DEFAULT_ARCHIVE_PATH = "Resources/Assets.nytepak"; // ASSET_ARCHIVE_PATH in Engine.h
+
+    struct Source
+    {
+        std::string path;
+        AssetArchiveFormat::AssetType type;
+    };
+
+    // Sources are named after their path as found from the working directory
+    std::vector<Source> findSources(const std::string& _sourceDirectory)
+    {
+        std::vector<Source> sources;
+        for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(_sourceDirectory))
+        {
+            if (!entry.is_regular_file())
+                continue;
+
+            Source source{ entry.path().generic_string() };
+            if (AssetCooker::sourceType(source.path, source.type))
+                sources.push_back(source);
+        }
+        // archive order does not depend on the directory iteration order
+        std::sort(sources.begin(), sources.end(), [](const Source& _a, const Source& _b) { return _a.path < _b.path; });
+        return sources;
+    }
+
+    // Returns false when a source failed or the archive couldn't be written
+    bool cookArchive(const std::string& _sourceDirectory, const std::string& _archivePath, bool _force, JobSystem& _jobSystem)
+    {
+        std::vector<Source> sources = findSources(_sourceDirectory);
+
+        // the previous archive stays mapped while its up to date blobs are copied into the new one
+        AssetArchiveView previous;
+        AssetDependencyGraph dependencies;
+        if (!_force && AssetArchive::open(previous, _archivePath))
+            dependencies.build(previous);
+
+        AssetArchiveWriter archive;
+        archive.open(_archivePath);
+
+        // One job per source, imports and mip chains run their own nested jobs
+        std::mutex logMutex;
+        std::vector<std::string> failures;
+        std::atomic<u32> upToDate{ 0 };
+        auto startTime = std::chrono::high_resolution_clock::now();
+        _jobSystem.parallelFor((u32)sources.size(), [&](u32 _source) {
+            const Source& source = sources[_source];
+            auto sourceStartTime = std::chrono::high_resolution_clock::now();
+            std::vector<std::string> names = AssetCooker::assetNames(source.path, source.type);
+            u32 processorVersion = AssetCooker::processorVersion(source.type);
+            try
+            {
+                u64 sourceHash = FileHelper::hashFile(source.path);
+
+                std::vector<const AssetArchiveFormat::Entry*> entries;
+                if (dependencies.upToDate(source.path, source.type, sourceHash, entries))
+                {
+                    for (size_t a = 0; a < entries.size(); ++a)
+                        archive.add(names[a], source.type, source.path, sourceHash, processorVersion, previous.blob(*entries[a]), (size_t)entries[a]->size);
+                    ++upToDate;
+                    return;
+                }
+
+                std::vector<std::vector<u8>> blobs;
+                AssetCooker::cook(source.path, source.type, sourceHash, &_jobSystem, blobs);
+                for (size_t a = 0; a < blobs.size(); ++a)
+                    archive.add(names[a], source.type, source.path, sourceHash, processorVersion, blobs[a].data(), blobs[a].size());
+            }
+            catch (const std::exception& _exception)
+            {
+                std::lock_guard<std::mutex> lock(logMutex);
+                failures.push_back(source.path + ": " + _exception.what());
+                return;
+            }
+            float sourceTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - sourceStartTime).count();
+
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cout << "\t cooked " << source.path << " " << sourceTime << "ms\n";
+        });
+
+        // unmapped before the new archive replaces it
+        previous = AssetArchiveView{};
+        if (!archive.finish())
+        {
+            std::cout << "Failed to write " << _archivePath << "\n";
+            return false;
+        }
+        float cookTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+        std::cout << (sources.size() - failures.size() - upToDate) << " assets cooked, " << upToDate << " up to date, into " << _archivePath << " in " << cookTime << "ms, "
+            << archive.m_blobBytes / (1024.0f * 1024.0f) << "MB (" << archive.m_sharedBytes / (1024.0f * 1024.0f) << "MB shared)\n";
+        for (const std::string& failure : failures)
+            std::cout << "\t failed " << failure << "\n";
+        return failures.empty();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> arguments;
+    bool force = false;
+    bool watch = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--force") == 0)
+            force = true;
+        else if (strcmp(argv[i], "--watch") == 0)
+            watch = true;
+        else
+            arguments.push_back(argv[i]);
+    }
+    if (arguments.empty())
+    {
+        std::cout << "usage: NyteCook <source directory> [archive] [thread count] [--force] [--watch]\n";
+        return EXIT_FAILURE;
+    }
+    std::string sourceDirectory = arguments[0];
+    std::string archivePath = arguments.size() > 1 ? arguments[1] : DEFAULT_ARCHIVE_PATH;
+
+    JobSystem jobSystem;
+    jobSystem.init(arguments.size() > 2 ? (u32)std::atoi(arguments[2].c_str()) : 0);
+    std::cout << "Job system: " << jobSystem.getThreadCount() << " threads\n";
+
+    bool cooked = cookArchive(sourceDirectory, archivePath, force, jobSystem);
+    if (!watch)
+        return cooked ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    // Every change cooks the archive again, the unchanged sources are only hashed and copied over
+    FileWatcher watcher;
+    watcher.start(sourceDirectory);
+    std::cout << "Watching " << sourceDirectory << "\n";
+    for (;;)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        AssetArchiveFormat::AssetType type;
+        std::vector<std::string> changes = watcher.poll();
+        changes.erase(std::remove_if(changes.begin(), changes.end(), [&](const std::string& _path) { return !AssetCooker::sourceType(_path, type); }), changes.end());
+        if (changes.empty())
+            continue;
+
+        for (const std::string& change : changes)
+            std::cout << "\t changed " << change << "\n";
+        cookArchive(sourceDirectory, archivePath, false, jobSystem);
+    }
+}
@@ -0,0 +1,151 @@
+// NyteTests: importer regression tests, no GPU needed.
+//
+//  NyteTests [test name]
+//
+// Every test writes its source file to the temp directory, imports it and checks the result.
+// Without argument every test runs. The exit code is the number of failed tests.
+
+// stl
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <cmath>
+#include <cstring>
+
+#include "Common.h"
+#include "FBXHelper.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+    struct Test
+    {
+        const char* name;
+        std::function<void()> run;
+    };
+
+    // Failed checks throw, the test stops at the first one
+    void check(bool _condition, const std::string& _what)
+    {
+        if (!_condition)
+            throw std::runtime_error(_what);
+    }
+
+    std::string writeSource(const std::string& _fileName, const std::string& _content)
+    {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / _fileName;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << _content;
+        if (!file.good())
+            throw std::runtime_error("Failed to write " + path.generic_string());
+        return path.generic_string();
+    }
+
+    FBXScene importScene(const std::string& _path)
+    {
+        FBXScene scene;
+        scene.filePath = _path;
+        FBXHelper::loadScene(scene);
+        return scene;
+    }
+
+    // ASCII FBX of one mesh node, _polygons is the PolygonVertexIndex array
+    std::string asciiFbx(const std::vector<float>& _positions, const std::vector<int>& _polygons)
+    {
+        auto join = [](const auto& _values) {
+            std::string text;
+            for (size_t i = 0; i < _values.size(); ++i)
+                text += (i ? "," : "") + std::to_string(_values[i]);
+            return text;
+        };
+        return "; FBX 7.4.0 project file\nFBXHeaderExtension:  {\n\tFBXHeaderVersion: 1003\n\tFBXVersion: 7400\n}\nObjects:  {\n"
+            "\tGeometry: 1000, \"Geometry::Test\", \"Mesh\" {\n"
+            "\t\tVertices: *" + std::to_string(_positions.size()) + " {\n\t\t\ta: " + join(_positions) + "\n\t\t} \n"
+            "\t\tPolygonVertexIndex: *" + std::to_string(_polygons.size()) + " {\n\t\t\ta: " + join(_polygons) + "\n\t\t} \n"
+            "\t\tGeometryVersion: 124\n\t}\n"
+            "\tModel: 2000, \"Model::Test\", \"Mesh\" {\n\t\tVersion: 232\n\t}\n}\n"
+            "Connections:  {\n\tC: \"OO\",2000,0\n\tC: \"OO\",1000,2000\n}\n";
+    }
+
+    // openFBX skips point and line polygons and leaves their last index encoded as -index - 1,
+    // only the triangle corners may be welded
+    void fbxLineAndPointPolygons()
+    {
+        std::vector<float> positions = {
+            0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f, // triangle
+            5.0f, 5.0f, 5.0f,  6.0f, 5.0f, 5.0f, // line
+            9.0f, 9.0f, 9.0f, // point
+        };
+        std::string source = asciiFbx(positions, { 0, 1, -3, 3, -5, -6 });
+
+        ofbx::IScene* fbxScene = ofbx::load((const ofbx::u8*)source.data(), (ofbx::usize)source.size(), (ofbx::u16)ofbx::LoadFlags::NONE);
+        check(fbxScene != nullptr && fbxScene->getMeshCount() == 1, "one mesh node");
+        FBXMesh welded;
+        std::vector<u32> cornerToVertex;
+        FBXHelper::weldCorners(welded, cornerToVertex, fbxScene->getMesh(0)->getGeometryData(), nullptr);
+        fbxScene->destroy();
+
+        check(welded.m_vertices.size() == 3, "only the triangle corners are welded, got " + std::to_string(welded.m_vertices.size()) + " vertices");
+        for (u32 c = 0; c < 3; ++c)
+            check(welded.m_vertices[cornerToVertex[c]].pos == glm::make_vec3(&positions[c * 3]), "triangle corner " + std::to_string(c));
+
+        FBXScene scene = importScene(writeSource("NyteTests_lines.fbx", source));
+        check(scene.meshes.size() == 1, "one mesh");
+        const FBXMesh& mesh = scene.meshes[0];
+        check(mesh.m_vertices.size() == 3, "three vertices");
+        check(mesh.m_subMeshes.size() == 1 && mesh.m_subMeshes[0].lods[0].indexCount == 3, "one triangle");
+    }
+
+    // Scan exports often have no "vn", the normals are generated from the faces before the tangents
+    void objWithoutNormals()
+    {
+        std::string source =
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+            "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+            "f 1/1 2/2 3/3 4/4\n";
+        FBXScene scene = importScene(writeSource("NyteTests_no_normals.obj", source));
+
+        check(scene.meshes.size() == 1, "one mesh");
+        const FBXMesh& mesh = scene.meshes[0];
+        check(mesh.m_vertices.size() == 4, "four vertices");
+        for (const FBXVertex& vertex : mesh.m_vertices)
+        {
+            check(std::isfinite(glm::dot(vertex.normal, vertex.normal) + glm::dot(vertex.tangent, vertex.tangent)), "finite normal and tangent");
+            check(glm::length(vertex.normal - glm::vec3(0.0f, 0.0f, 1.0f)) < 1e-5f, "counter clockwise face normal is +z");
+            check(std::abs(glm::length(glm::vec3(vertex.tangent)) - 1.0f) < 1e-5f && std::abs(glm::dot(vertex.normal, glm::vec3(vertex.tangent))) < 1e-5f, "unit tangent on the normal plane");
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::vector<Test> tests = {
+        { "fbxLineAndPointPolygons", fbxLineAndPointPolygons },
+        { "objWithoutNormals", objWithoutNormals },
+    };
+
+    int failed = 0;
+    for (const Test& test : tests)
+    {
+        if (argc > 1 && strcmp(argv[1], test.name) != 0)
+            continue;
+
+        std::cout << test.name << "\n";
+        try
+        {
+            test.run();
+            std::cout << "\t passed\n";
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "\t FAILED: " << e.what() << "\n";
+            ++failed;
+        }
+    }
+    return failed;
+}